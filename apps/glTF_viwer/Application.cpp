@@ -1,10 +1,19 @@
 #include "Application.hpp"
 #include <iostream>
 #include <unordered_set>
+#include <unordered_map>
 #include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <future>
 #include <imgui.h>
+#include <glmlv/imgui_memory_panel.hpp>
 #include <glmlv/Image2DRGBA.hpp>
+#include <glmlv/GLTexture2D.hpp>
 #include <glmlv/scene_loading.hpp>
+#include <glmlv/gltf_loading.hpp>
+#include <glmlv/animation.hpp>
+#include <glmlv/parallel.hpp>
 #include <glm/gtx/io.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
@@ -14,10 +23,13 @@ int Application::run()
 {
     float clearColor[3] = {0.2f, 0.3f, 0.3f};
     // Put here code to run before rendering loop
+    auto previousSeconds = glfwGetTime();
     // Loop until the user closes the window
     for (auto iterationCount = 0u; !m_GLFWHandle.shouldClose(); ++iterationCount)
     {
         const auto seconds = glfwGetTime();
+        updateAnimation(float(seconds - previousSeconds));
+        previousSeconds = seconds;
         // Put here rendering code
         const auto viewportSize = m_GLFWHandle.framebufferSize();
         glViewport(0, 0, viewportSize.x, viewportSize.y);
@@ -34,8 +46,10 @@ int Application::run()
         // 将uniform与位置0绑定
         glUniform1i(m_uKdSamplerLocation, 0);
         // 设置采样模式
-        glBindSampler(0, m_uKdSamplerLocation);
-        drawModel(m_model);
+        glBindSampler(0, m_textureSampler);
+        updateWorldTransforms();
+        updateMorphTargets();
+        drawScene();
         // 解绑采样器
         glBindSampler(0, 0);
         // GUI code:
@@ -43,6 +57,22 @@ int Application::run()
         {
             ImGui::Begin("GUI");
             ImGui::Text("Application average %.3f ms/frame (%.1f FPS)", 1000.0f / ImGui::GetIO().Framerate, ImGui::GetIO().Framerate);
+            ImGui::Text("%zu draws, %zu instances, %zu nodes", m_draws.size(), m_instances.size(), m_transforms.size());
+            if (!m_animations.empty() && ImGui::CollapsingHeader("Animation", ImGuiTreeNodeFlags_DefaultOpen))
+            {
+                ImGui::Text("%zu skinned instances, %zu joints", m_skinInstances.size(), m_jointMatrices.size());
+                ImGui::RadioButton("Bind pose", &m_currentAnimation, -1);
+                for (size_t i = 0; i < m_animations.size(); ++i)
+                {
+                    ImGui::RadioButton(m_animations[i].name.c_str(), &m_currentAnimation, int(i));
+                }
+                ImGui::Checkbox("Play", &m_playAnimation);
+                ImGui::DragFloat("Speed", &m_animationSpeed, 0.05f, 0.0f, 10.0f);
+                if (m_currentAnimation >= 0)
+                {
+                    ImGui::SliderFloat("Time", &m_animationTime, 0.0f, m_animations[m_currentAnimation].duration());
+                }
+            }
             if (ImGui::ColorEdit3("clearColor", clearColor))
             {
                 glClearColor(clearColor[0], clearColor[1], clearColor[2], 1.0f);
@@ -63,6 +93,7 @@ int Application::run()
                 ImGui::DragFloat("SpecularLightingIntensity", &m_PointLightIntensity, 0.1f, 0.0f, 15000.0f);
                 ImGui::InputFloat3("Position", glm::value_ptr(m_PointLightPosition));
             }
+            glmlv::imguiMemoryPanel(m_AppName + ".memory.json");
             ImGui::End();
         }
         glmlv::imguiRenderFrame();
@@ -92,14 +123,29 @@ Application::Application(int argc, char **argv) : m_AppPath{glmlv::fs::path{argv
         exit(-1);
     }
     path = argv[1];
+    for (int i = 2; i < argc; ++i)
+    {
+        if (std::string(argv[i]) == "--no-texture-compression")
+        {
+            m_compressTextures = false;
+        }
+        else if (std::string(argv[i]) == "--no-mmap")
+        {
+            m_mapBuffers = false;
+        }
+    }
     ImGui::GetIO().IniFilename = m_ImGuiIniFilename.c_str(); // At exit, ImGUI will store its windows positions in this file
     // Put here initialization code
     const GLint positionAttrLocation = 0;
     const GLint normalAttrLocation = 1;
     const GLint texCoordsAttrLocation = 2;
+    const GLint jointsAttrLocation = 12; // 3到11为实例属性
+    const GLint weightsAttrLocation = 13;
     m_attribs["POSITION"] = positionAttrLocation;
     m_attribs["NORMAL"] = normalAttrLocation;
     m_attribs["TEXCOORD_0"] = texCoordsAttrLocation;
+    m_attribs["JOINTS_0"] = jointsAttrLocation;
+    m_attribs["WEIGHTS_0"] = weightsAttrLocation;
 
     glEnable(GL_DEPTH_TEST);
     glEnable(GL_MULTISAMPLE);
@@ -107,244 +153,933 @@ Application::Application(int argc, char **argv) : m_AppPath{glmlv::fs::path{argv
 
     m_program = glmlv::compileProgram({m_ShadersRootPath / m_AppName / "forward.vs.glsl", m_ShadersRootPath / m_AppName / "forward.fs.glsl"});
     m_program.use();
-    m_uModelViewProjMatrixLocation = glGetUniformLocation(m_program.glId(), "uModelViewProjMatrix");
-    m_uModelViewMatrixLocation = glGetUniformLocation(m_program.glId(), "uModelViewMatrix");
-    m_uNormalMatrixLocation = glGetUniformLocation(m_program.glId(), "uNormalMatrix");
+    m_uViewProjMatrixLocation = glGetUniformLocation(m_program.glId(), "uViewProjMatrix");
+    m_uViewMatrixLocation = glGetUniformLocation(m_program.glId(), "uViewMatrix");
     m_uDirectionalLightDirLocation = glGetUniformLocation(m_program.glId(), "uDirectionalLightDir");
     m_uDirectionalLightIntensityLocation = glGetUniformLocation(m_program.glId(), "uDirectionalLightIntensity");
     m_uPointLightPositionLocation = glGetUniformLocation(m_program.glId(), "uPointLightPosition");
     m_uPointLightIntensityLocation = glGetUniformLocation(m_program.glId(), "uPointLightIntensity");
     m_uKdLocation = glGetUniformLocation(m_program.glId(), "uKd");
     m_uKdSamplerLocation = glGetUniformLocation(m_program.glId(), "uKdSampler");
+    m_morphProgram = glmlv::compileProgram({m_ShadersRootPath / m_AppName / "morph.cs.glsl"});
+    m_uMorphVertexCountLocation = glGetUniformLocation(m_morphProgram.glId(), "uVertexCount");
+    m_uMorphTargetCountLocation = glGetUniformLocation(m_morphProgram.glId(), "uTargetCount");
+    m_uMorphWeightOffsetLocation = glGetUniformLocation(m_morphProgram.glId(), "uWeightOffset");
     m_viewController.setViewMatrix(glm::lookAt(glm::vec3(0, 0, -3), glm::vec3(0, 0, 0), glm::vec3(0, 1, 0)));
     m_viewController.setSpeed(8.0f);
     glActiveTexture(GL_TEXTURE0);
     loadModel();
+    m_memorySource = glmlv::MemorySource(m_AppName, [this]() { return getMemoryUsage(); });
 }
 
-void Application::loadModel()
+// 将glTF图像转换为RGBA图像 (1到4个分量)
+static glmlv::Image2DRGBA toImage2DRGBA(const tinygltf::Image &image)
+{
+    glmlv::Image2DRGBA rgbaImage(image.width, image.height, 0, 0, 0, 255);
+    const size_t componentCount = image.component;
+    for (size_t i = 0; i < rgbaImage.size(); ++i)
+    {
+        for (size_t c = 0; c < componentCount; ++c)
+        {
+            rgbaImage.data()[i * 4 + c] = image.image[i * componentCount + c];
+        }
+        if (componentCount <= 2)
+        {
+            // 灰度图扩展为灰色RGB, 第二个分量为透明度
+            rgbaImage.data()[i * 4 + 3] = componentCount == 2 ? rgbaImage.data()[i * 4 + 1] : 255;
+            rgbaImage.data()[i * 4 + 1] = rgbaImage.data()[i * 4 + 2] = rgbaImage.data()[i * 4];
+        }
+    }
+    return rgbaImage;
+}
+
+// glTF顶点属性允许的组件类型: 浮点数, 以及KHR_mesh_quantization的8位与16位整数
+static bool isVertexComponentType(int componentType)
+{
+    return componentType == TINYGLTF_COMPONENT_TYPE_FLOAT || componentType == TINYGLTF_COMPONENT_TYPE_BYTE ||
+           componentType == TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE || componentType == TINYGLTF_COMPONENT_TYPE_SHORT ||
+           componentType == TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT;
+}
+
+int Application::getBaseColorImage(const tinygltf::Primitive &prim) const
 {
-    tinygltf::TinyGLTF loader;
-    std::string err;
-    std::string warn;
-    bool ret = loader.LoadASCIIFromFile(&m_model, &err, &warn, path);
-    if (!warn.empty())
+    if (prim.material < 0)
     {
-        printf("Warning: %s\n", warn.c_str());
+        return -1;
     }
-    if (!err.empty())
+    const auto &values = m_document.model.materials[prim.material].values;
+    const auto it = values.find("baseColorTexture");
+    if (it == end(values) || it->second.TextureIndex() < 0)
     {
-        printf("Oops! Error occurs: %s\n", err.c_str());
+        return -1;
     }
-    if (!ret)
+    const auto source = m_document.model.textures[it->second.TextureIndex()].source;
+    return source < int(m_document.model.images.size()) ? source : -1;
+}
+
+void Application::loadModel()
+{
+    try
+    {
+        // 图像延迟解码: 只解码被使用的图像, 且在线程池中进行
+        m_document = glmlv::loadGltf(path, m_mapBuffers ? glmlv::GltfBufferMode::Map : glmlv::GltfBufferMode::Copy, glmlv::GltfImageMode::Defer);
+    }
+    catch (const std::exception &)
     {
         printf("Failed to resolve glTF\n");
         return;
     }
+    for (const auto &extension : m_document.model.extensionsRequired)
+    {
+        if (extension != "KHR_mesh_quantization" && extension != "EXT_meshopt_compression")
+        {
+            std::clog << "Warning: required extension " << extension << " is not supported" << std::endl;
+        }
+    }
     std::cout << "Property of current glTF:\n"
-              << m_model.accessors.size() << " accessors\n"
-              << m_model.animations.size() << " animations\n"
-              << m_model.buffers.size() << " buffers\n"
-              << m_model.bufferViews.size() << " bufferViews\n"
-              << m_model.materials.size() << " materials\n"
-              << m_model.meshes.size() << " meshes\n"
-              << m_model.nodes.size() << " nodes\n"
-              << m_model.textures.size() << " textures\n"
-              << m_model.images.size() << " images\n"
-              << m_model.skins.size() << " skins\n"
-              << m_model.samplers.size() << " samplers\n"
-              << m_model.cameras.size() << " cameras\n"
-              << m_model.scenes.size() << " scenes\n"
-              << m_model.lights.size() << " lights\n";
-    // init and generate a vector containing all buffers
-    std::vector<GLuint> scene_buffers(m_model.buffers.size());
-    glGenBuffers(scene_buffers.size(), scene_buffers.data());
-    // 加载VAO和VBO
-    for (size_t i = 0; i < scene_buffers.size(); ++i)
-    {
-        const tinygltf::BufferView &bufferView = m_model.bufferViews[i];
-        glBindBuffer(bufferView.target, scene_buffers[i]);
-        glBufferStorage(bufferView.target, m_model.buffers[i].data.size(), m_model.buffers[i].data.data(), 0);
-        glBindBuffer(bufferView.target, 0);
-    }
-    // 加载网格
-    for (size_t i = 0; i < m_model.meshes.size(); ++i)
+              << m_document.model.accessors.size() << " accessors\n"
+              << m_document.model.animations.size() << " animations\n"
+              << m_document.model.buffers.size() << " buffers\n"
+              << m_document.model.bufferViews.size() << " bufferViews\n"
+              << m_document.model.materials.size() << " materials\n"
+              << m_document.model.meshes.size() << " meshes\n"
+              << m_document.model.nodes.size() << " nodes\n"
+              << m_document.model.textures.size() << " textures\n"
+              << m_document.model.images.size() << " images\n"
+              << m_document.model.skins.size() << " skins\n"
+              << m_document.model.samplers.size() << " samplers\n"
+              << m_document.model.cameras.size() << " cameras\n"
+              << m_document.model.scenes.size() << " scenes\n"
+              << m_document.model.lights.size() << " lights\n";
+    // 只解码图元材质引用的baseColor图像. 解码 (以及块压缩) 在线程池中进行, 与下面的缓冲区上传重叠
+    const auto useS3TC = glmlv::isS3TCSupported();
+    const auto textureCacheDirectory = glmlv::fs::path{path}.parent_path() / ".texture_cache";
+    std::vector<int> usedImages;
+    for (const auto &mesh : m_document.model.meshes)
+    {
+        for (const auto &prim : mesh.primitives)
+        {
+            const auto image = getBaseColorImage(prim);
+            if (image >= 0 && std::find(begin(usedImages), end(usedImages), image) == end(usedImages))
+            {
+                usedImages.push_back(image);
+            }
+        }
+    }
+    const auto decodingStart = std::chrono::steady_clock::now();
+    std::vector<std::future<DecodedTexture>> decodedTextures;
+    for (const auto image : usedImages)
+    {
+        const auto compressTextures = m_compressTextures;
+        decodedTextures.emplace_back(m_workerPool.submit([this, image, compressTextures, useS3TC, textureCacheDirectory]()
+        {
+            const auto start = std::chrono::steady_clock::now();
+            DecodedTexture texture;
+            m_document.decodeImage(image);
+            if (compressTextures)
+            {
+                // 块压缩的mip链缓存在模型旁边, 之后的载入直接上传压缩数据. baseColor纹理使用sRGB编码
+                const auto rgbaImage = toImage2DRGBA(m_document.model.images[image]);
+                const auto compressedFormat = glmlv::chooseCompressedFormat(rgbaImage, glmlv::ColorSpace::sRGB, 4, useS3TC);
+                texture.compressedImage = glmlv::loadOrCompressImage(rgbaImage, glmlv::ColorSpace::sRGB, compressedFormat, textureCacheDirectory);
+            }
+            texture.milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            return texture;
+        }));
+    }
+    // 只上传图元访问器实际引用的字节范围, 紧凑地放在同一个GL缓冲区中, 顶点与索引共用.
+    // 映射模式下数据直接从映射的文件复制到GL, 未引用的部分 (动画, 图像...) 不会被读取
+    const size_t rangeAlignment = 16;
+    std::vector<glmlv::GltfByteRange> referencedRanges;
+    for (const auto &mesh : m_document.model.meshes)
+    {
+        for (const auto &prim : mesh.primitives)
+        {
+            if (prim.indices >= 0)
+            {
+                referencedRanges.push_back(glmlv::getAccessorByteRange(m_document.model, prim.indices));
+            }
+            for (const auto &attribute : prim.attributes)
+            {
+                if (m_attribs.count(attribute.first))
+                {
+                    referencedRanges.push_back(glmlv::getAccessorByteRange(m_document.model, attribute.second));
+                }
+            }
+        }
+    }
+    const auto uploadedRanges = glmlv::mergeByteRanges(referencedRanges, rangeAlignment);
+    std::vector<size_t> uploadedRangeOffsets;
+    size_t uploadedByteSize = 0;
+    for (const auto &range : uploadedRanges)
+    {
+        uploadedRangeOffsets.push_back(uploadedByteSize);
+        uploadedByteSize += (range.end - range.begin + rangeAlignment - 1) / rangeAlignment * rangeAlignment;
+    }
+    glGenBuffers(1, &m_buffer);
+    glBindBuffer(GL_ARRAY_BUFFER, m_buffer);
+    glBufferStorage(GL_ARRAY_BUFFER, std::max(uploadedByteSize, size_t(1)), nullptr, GL_DYNAMIC_STORAGE_BIT);
+    m_bufferByteSize = uploadedByteSize;
+    for (size_t i = 0; i < uploadedRanges.size(); ++i)
+    {
+        const auto &range = uploadedRanges[i];
+        glBufferSubData(GL_ARRAY_BUFFER, uploadedRangeOffsets[i], range.end - range.begin, m_document.bufferData(range.buffer) + range.begin);
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    // glTF缓冲区中的偏移 -> GL缓冲区中的偏移
+    const auto getUploadedOffset = [&](size_t buffer, size_t byteOffset)
+    {
+        const auto it = std::upper_bound(begin(uploadedRanges), end(uploadedRanges), std::make_pair(buffer, byteOffset), [](const std::pair<size_t, size_t> &value, const glmlv::GltfByteRange &range)
+        {
+            return value.first < range.buffer || (value.first == range.buffer && value.second < range.begin);
+        }) - 1;
+        return uploadedRangeOffsets[it - begin(uploadedRanges)] + byteOffset - (*it).begin;
+    };
+    size_t bufferByteSize = 0;
+    for (size_t i = 0; i < m_document.bufferCount(); ++i)
+    {
+        bufferByteSize += m_document.bufferByteSize(i);
+    }
+    std::cout << uploadedByteSize / (1024. * 1024.) << " MB of geometry uploaded from " << bufferByteSize / (1024. * 1024.) << " MB of buffers\n";
+    // 实例缓冲区在buildDrawList中分配, 所有VAO从中读取每个实例的矩阵 (两个mat4, 每列一个属性)
+    const GLuint instanceBinding = 15;
+    const GLuint instanceModelMatrixLocation = 3;
+    const GLuint instanceNormalMatrixLocation = 7;
+    const GLuint instanceJointOffsetLocation = 11;
+    glGenBuffers(1, &m_instanceBuffer);
+    glGenBuffers(1, &m_jointBuffer);
+    // 加载网格, 每个图元的绘制参数只解析一次
+    m_primitiveOffsetPerMesh.assign(1, 0);
+    std::vector<int> primitiveImages; // 每个图元的baseColor图像, 纹理创建后再设置
+    for (size_t i = 0; i < m_document.model.meshes.size(); ++i)
     {
         // 加载当前网格
-        const tinygltf::Mesh &mesh = m_model.meshes[i];
-        for (int j = 0; j < mesh.primitives.size(); ++j)
+        const tinygltf::Mesh &mesh = m_document.model.meshes[i];
+        std::vector<GLuint> morphVertexOffsets;
+        int morphMesh = -1;
+        try
+        {
+            morphMesh = createMorphMesh(mesh, morphVertexOffsets);
+        }
+        catch (const std::exception &e)
+        {
+            std::cerr << "Ignoring morph targets of mesh " << i << ": " << e.what() << std::endl;
+        }
+        m_morphMeshPerMesh.push_back(morphMesh);
+        for (size_t j = 0; j < mesh.primitives.size(); ++j)
         {
             const tinygltf::Primitive &prim = mesh.primitives[j];
-            GLuint vao_primitive = 0;
-            glGenVertexArrays(1, &vao_primitive);
-            glBindVertexArray(vao_primitive);
+            PrimitiveDraw draw;
+            draw.mode = getglTFMode(prim.mode);
+            glGenVertexArrays(1, &draw.vao);
+            glBindVertexArray(draw.vao);
             // 初始化绑定IBO
-            tinygltf::Accessor &indexAccessor = m_model.accessors[prim.indices];
-            tinygltf::BufferView &bufferView = m_model.bufferViews[indexAccessor.bufferView];
-            int &bufferId = bufferView.buffer;
-            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, scene_buffers[bufferId]);
-            std::map<std::string, int>::const_iterator it(prim.attributes.begin());
-            std::map<std::string, int>::const_iterator itEnd(prim.attributes.end());
-            for (; it != itEnd; it++)
+            if (prim.indices >= 0)
+            {
+                const tinygltf::Accessor &indexAccessor = m_document.model.accessors[prim.indices];
+                const tinygltf::BufferView &indexBufferView = m_document.model.bufferViews[indexAccessor.bufferView];
+                glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_buffer);
+                draw.count = GLsizei(indexAccessor.count);
+                draw.indexType = GLenum(indexAccessor.componentType);
+                draw.indexByteOffset = getUploadedOffset(indexBufferView.buffer, indexBufferView.byteOffset + indexAccessor.byteOffset);
+            }
+            for (const auto &attribute : prim.attributes)
             {
-                tinygltf::Accessor &accessor = m_model.accessors[it->second];
-                bufferView = m_model.bufferViews[accessor.bufferView];
-                bufferId = bufferView.buffer;
-                glBindBuffer(GL_ARRAY_BUFFER, scene_buffers[bufferId]);
-                // 初始化组建数量 默认为1
-                int size = 1;
-                if (accessor.type == TINYGLTF_TYPE_SCALAR)
+                const tinygltf::Accessor &accessor = m_document.model.accessors[attribute.second];
+                if (attribute.first == "POSITION" && prim.indices < 0)
                 {
-                    size = 1;
+                    draw.count = GLsizei(accessor.count);
                 }
-                else if (accessor.type == TINYGLTF_TYPE_VEC2)
+                const auto attribIt = m_attribs.find(attribute.first);
+                if (attribIt == end(m_attribs) || accessor.bufferView < 0)
                 {
-                    size = 2;
+                    continue;
                 }
-                else if (accessor.type == TINYGLTF_TYPE_VEC3)
+                // 组件数量与类型直接作为VAO的顶点格式, 量化的属性 (KHR_mesh_quantization) 由GL转换为浮点数:
+                // 归一化的整数映射到[0, 1]或[-1, 1], 非归一化的位置由节点变换反量化
+                const tinygltf::BufferView &bufferView = m_document.model.bufferViews[accessor.bufferView];
+                const bool isVector = accessor.type == TINYGLTF_TYPE_SCALAR || accessor.type == TINYGLTF_TYPE_VEC2 ||
+                                      accessor.type == TINYGLTF_TYPE_VEC3 || accessor.type == TINYGLTF_TYPE_VEC4;
+                const int size = tinygltf::GetTypeSizeInBytes(uint32_t(accessor.type));
+                const int byteStride = accessor.ByteStride(bufferView);
+                if (!isVector || !isVertexComponentType(accessor.componentType) || byteStride <= 0)
                 {
-                    size = 3;
+                    std::clog << "Skipping attribute " << attribute.first << " of mesh " << i << ": unsupported format" << std::endl;
+                    continue;
                 }
-                else if (accessor.type == TINYGLTF_TYPE_VEC4)
+                glEnableVertexAttribArray(attribIt->second);
+                if (attribute.first == "JOINTS_0")
                 {
-                    size = 4;
+                    // 关节索引是整数属性, 不转换为浮点数
+                    glVertexAttribIFormat(attribIt->second, size, GLenum(accessor.componentType), 0);
                 }
                 else
                 {
-                    fprintf(stderr, "Wrong tinygltf type.");
-                    exit(EXIT_FAILURE);
+                    glVertexAttribFormat(attribIt->second, size, GLenum(accessor.componentType), accessor.normalized ? GL_TRUE : GL_FALSE, 0);
                 }
-                if ((it->first.compare("POSITION") == 0) || (it->first.compare("NORMAL") == 0) || (it->first.compare("TEXCOORD_0") == 0))
+                glVertexAttribBinding(attribIt->second, attribIt->second);
+                glBindVertexBuffer(attribIt->second, m_buffer, GLintptr(getUploadedOffset(bufferView.buffer, bufferView.byteOffset + accessor.byteOffset)), byteStride);
+            }
+            for (GLuint column = 0; column < 4; ++column)
+            {
+                for (const auto location : {instanceModelMatrixLocation + column, instanceNormalMatrixLocation + column})
+                {
+                    const auto matrixOffset = location < instanceNormalMatrixLocation ? offsetof(InstanceData, modelMatrix) : offsetof(InstanceData, normalMatrix);
+                    glEnableVertexAttribArray(location);
+                    glVertexAttribFormat(location, 4, GL_FLOAT, GL_FALSE, GLuint(matrixOffset + column * sizeof(glm::vec4)));
+                    glVertexAttribBinding(location, instanceBinding);
+                }
+            }
+            if (morphMesh >= 0)
+            {
+                // 位置与法线从计算着色器混合后的顶点读取
+                const auto vertexOffset = GLintptr(morphVertexOffsets[j]) * 2 * sizeof(glm::vec4);
+                for (const auto &attribute : {std::make_pair("POSITION", 0), std::make_pair("NORMAL", 1)})
                 {
-                    if (m_attribs[it->first] >= 0)
+                    if (!prim.attributes.count(attribute.first))
                     {
-                        int byteStride = accessor.ByteStride(m_model.bufferViews[accessor.bufferView]);
-                        if (byteStride == -1)
-                        {
-                            fprintf(stderr, "\n");
-                            exit(EXIT_FAILURE);
-                        }
-                        glEnableVertexAttribArray(m_attribs[it->first]);
-                        glVertexAttribPointer(m_attribs[it->first], size, accessor.componentType, accessor.normalized ? GL_TRUE : GL_FALSE, byteStride, (const GLvoid *)(bufferView.byteOffset + accessor.byteOffset));
+                        continue;
                     }
+                    const auto location = m_attribs[attribute.first];
+                    glEnableVertexAttribArray(location);
+                    glVertexAttribFormat(location, 3, GL_FLOAT, GL_FALSE, 0);
+                    glVertexAttribBinding(location, location);
+                    glBindVertexBuffer(location, m_morphMeshes[morphMesh].vertexBuffer, vertexOffset + attribute.second * sizeof(glm::vec4), 2 * sizeof(glm::vec4));
                 }
-
-                glBindBuffer(GL_ARRAY_BUFFER, 0);
             }
+            glEnableVertexAttribArray(instanceJointOffsetLocation);
+            glVertexAttribIFormat(instanceJointOffsetLocation, 1, GL_INT, GLuint(offsetof(InstanceData, jointOffset)));
+            glVertexAttribBinding(instanceJointOffsetLocation, instanceBinding);
+            glBindVertexBuffer(instanceBinding, m_instanceBuffer, 0, sizeof(InstanceData));
+            glVertexBindingDivisor(instanceBinding, 1);
+            glBindVertexArray(0);
+            glBindBuffer(GL_ARRAY_BUFFER, 0);
+            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
             // 将缓存加入向量中
-            m_vaos.push_back(vao_primitive);
-            m_primitives.push_back(prim);
+            m_vaos.push_back(draw.vao);
+            m_primitives.push_back(draw);
+            primitiveImages.push_back(-1);
             // 初始化并载入纹理
-            glBindVertexArray(0);
-            // 初始化漫反射纹理缓存
-            m_diffuseTex.push_back(0);
             if (prim.material < 0)
             {
                 continue;
             }
-            tinygltf::Material &mat = m_model.materials[prim.material];
-            const auto &parameter = mat.values["baseColorTexture"];
-            tinygltf::Texture &tex = m_model.textures[parameter.TextureIndex()];
-            if (tex.source > -1 && tex.source < m_model.images.size())
+            tinygltf::Material &mat = m_document.model.materials[prim.material];
+            const auto colorFactorIt = mat.values.find("baseColorFactor");
+            if (colorFactorIt != end(mat.values))
             {
-                tinygltf::Image &image = m_model.images[tex.source];
-                GLuint texId;
-                glGenTextures(1, &texId);
-                glBindTexture(GL_TEXTURE_2D, texId);
-                GLenum format = GL_RGBA;
-                if (image.component == 1)
-                {
-                    format = GL_RED;
-                }
-                else if (image.component == 2)
-                {
-                    format = GL_RG;
-                }
-                else if (image.component == 3)
-                {
-                    format = GL_RGB;
-                }
-                else
-                {
-                    pass;
-                }
-                glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
-                glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-                glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-                glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGB32F, image.width, image.height);
-                glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, image.width, image.height, GL_RGBA, GL_UNSIGNED_BYTE, &image.image[0]);
-                glBindTexture(GL_TEXTURE_2D, 0);
-                m_diffuseTex.back() = texId;
+                const auto color = colorFactorIt->second.ColorFactor();
+                m_primitives.back().diffuseColor = glm::vec3(color[0], color[1], color[2]);
+            }
+            primitiveImages.back() = getBaseColorImage(prim);
+        }
+        m_primitiveOffsetPerMesh.push_back(m_primitives.size());
+    }
+    glGenBuffers(1, &m_morphWeightBuffer);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_morphWeightBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, std::max(m_morphWeights.size(), size_t(1)) * sizeof(float), nullptr, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    std::cout << m_morphMeshes.size() << " meshes with morph targets\n";
+    // 在主线程中创建纹理, 按提交顺序等待解码结果
+    const auto waitingStart = std::chrono::steady_clock::now();
+    std::unordered_map<int, GLuint> texturePerImage;
+    double decodingMilliseconds = 0;
+    for (size_t i = 0; i < usedImages.size(); ++i)
+    {
+        DecodedTexture texture;
+        try
+        {
+            texture = decodedTextures[i].get();
+        }
+        catch (const std::exception &e)
+        {
+            std::cerr << "Skipping texture of image " << usedImages[i] << ": " << e.what() << std::endl;
+            continue;
+        }
+        decodingMilliseconds += texture.milliseconds;
+        if (texture.compressedImage.levelCount())
+        {
+            m_textures.emplace_back(texture.compressedImage);
+        }
+        else
+        {
+            const tinygltf::Image &image = m_document.model.images[usedImages[i]];
+            GLenum format = GL_RGBA;
+            if (image.component == 1)
+            {
+                format = GL_RED;
             }
+            else if (image.component == 2)
+            {
+                format = GL_RG;
+            }
+            else if (image.component == 3)
+            {
+                format = GL_RGB;
+            }
+            m_textures.emplace_back(image.width, image.height, format, image.image.data(), true);
         }
+        texturePerImage[usedImages[i]] = m_textures.back().glId();
     }
+    for (size_t i = 0; i < m_primitives.size(); ++i)
+    {
+        if (primitiveImages[i] >= 0 && texturePerImage.count(primitiveImages[i]))
+        {
+            m_primitives[i].diffuseTexture = texturePerImage[primitiveImages[i]];
+        }
+    }
+    const auto decodingEnd = std::chrono::steady_clock::now();
+    const auto waitingMilliseconds = std::chrono::duration<double, std::milli>(decodingEnd - waitingStart).count();
+    std::cout << usedImages.size() << " of " << m_document.model.images.size() << " images decoded on " << std::min(m_workerPool.threadCount(), usedImages.size()) << " threads in "
+              << std::chrono::duration<double, std::milli>(decodingEnd - decodingStart).count() << " ms (" << decodingMilliseconds << " ms of decoding, "
+              << waitingMilliseconds << " ms waited after geometry upload, " << std::max(0., decodingMilliseconds - waitingMilliseconds) << " ms saved)\n";
+
     glGenSamplers(1, &m_textureSampler);
-    glSamplerParameteri(m_textureSampler, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glSamplerParameteri(m_textureSampler, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
     glSamplerParameteri(m_textureSampler, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glSamplerParameteri(m_textureSampler, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glSamplerParameteri(m_textureSampler, GL_TEXTURE_WRAP_T, GL_REPEAT);
+
+    size_t textureByteSize = 0;
+    for (const auto &texture : m_textures)
+    {
+        textureByteSize += texture.byteSize();
+    }
+    std::cout << m_textures.size() << " textures uploaded, " << textureByteSize / (1024. * 1024.) << " MB of video memory\n";
+
+    try
+    {
+        m_animations = glmlv::loadGltfAnimations(m_document);
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "Ignoring animations: " << e.what() << std::endl;
+    }
+    size_t animationOutputSize = 0;
+    for (const auto &animation : m_animations)
+    {
+        animationOutputSize = std::max(animationOutputSize, animation.outputSize());
+    }
+    m_animationOutput.resize(animationOutputSize);
+    std::cout << m_animations.size() << " animations, " << m_document.model.skins.size() << " skins\n";
+
+    buildDrawList(m_document.model.defaultScene > -1 ? m_document.model.defaultScene : 0);
+    for (const auto &transform : m_transforms)
+    {
+        m_bindPose.push_back({transform.localMatrix, transform.translation, transform.rotation, transform.scale});
+    }
+    m_bindMorphWeights = m_morphWeights;
+    std::cout << m_draws.size() << " draws of " << m_instances.size() << " mesh instances, " << m_transforms.size() << " node instances\n";
 }
 
-void Application::DrawNode(tinygltf::Model &model, const tinygltf::Node &node, glm::mat4 m)
+glm::mat4 Application::getLocalMatrix(const tinygltf::Node &node)
 {
-    glm::mat4 modelMatrix = glm::mat4(1);
     if (node.matrix.size() == 16)
     {
-        modelMatrix = glm::make_mat4(node.matrix.data());
+        return glm::mat4(glm::make_mat4(node.matrix.data()));
     }
-    else
+    // glTF的局部矩阵为 T * R * S, 旋转为四元数 (x, y, z, w)
+    glm::mat4 modelMatrix = glm::mat4(1);
+    if (node.translation.size() == 3)
+    {
+        modelMatrix = glm::translate(modelMatrix, glm::vec3(glm::make_vec3(node.translation.data())));
+    }
+    if (node.rotation.size() == 4)
+    {
+        const glm::quat rotation(float(node.rotation[3]), float(node.rotation[0]), float(node.rotation[1]), float(node.rotation[2]));
+        modelMatrix = modelMatrix * glm::mat4_cast(rotation);
+    }
+    if (node.scale.size() == 3)
+    {
+        modelMatrix = glm::scale(modelMatrix, glm::vec3(glm::make_vec3(node.scale.data())));
+    }
+    return modelMatrix;
+}
+
+std::vector<glm::mat4> Application::getInstanceMatrices(const tinygltf::Node &node) const
+{
+    std::vector<glm::mat4> matrices;
+    const auto extensionIt = node.extensions.find("EXT_mesh_gpu_instancing");
+    if (extensionIt == end(node.extensions) || !extensionIt->second.Has("attributes"))
+    {
+        return matrices;
+    }
+    // 每个实例的TRS, 缺少的属性为单位变换. 旋转可以是归一化的整数 (与KHR_mesh_quantization一致)
+    const auto &attributes = extensionIt->second.Get("attributes");
+    const auto readAttribute = [&](const char *name, size_t componentCount, std::vector<float> &values)
+    {
+        const auto &accessor = attributes.Get(name);
+        if (!accessor.IsInt() || accessor.Get<int>() < 0 || accessor.Get<int>() >= int(m_document.model.accessors.size()))
+        {
+            return size_t(0);
+        }
+        values = glmlv::readAccessorAsFloats(m_document, accessor.Get<int>());
+        return values.size() / componentCount;
+    };
+    std::vector<float> translations, rotations, scales;
+    const auto count = std::max({readAttribute("TRANSLATION", 3, translations), readAttribute("ROTATION", 4, rotations), readAttribute("SCALE", 3, scales)});
+    for (size_t i = 0; i < count; ++i)
+    {
+        glm::mat4 matrix = glm::mat4(1);
+        if (i * 3 < translations.size())
+        {
+            matrix = glm::translate(matrix, glm::make_vec3(&translations[i * 3]));
+        }
+        if (i * 4 < rotations.size())
+        {
+            matrix = matrix * glm::mat4_cast(glm::quat(rotations[i * 4 + 3], rotations[i * 4], rotations[i * 4 + 1], rotations[i * 4 + 2]));
+        }
+        if (i * 3 < scales.size())
+        {
+            matrix = glm::scale(matrix, glm::make_vec3(&scales[i * 3]));
+        }
+        matrices.push_back(matrix);
+    }
+    return matrices;
+}
+
+void Application::buildDrawList(int sceneIndex)
+{
+    m_transforms.clear();
+    m_instances.clear();
+    m_draws.clear();
+    m_skinInstances.clear();
+    m_transformPerNode.assign(m_document.model.nodes.size(), -1);
+    if (sceneIndex >= int(m_document.model.scenes.size()))
+    {
+        std::cerr << "Scene " << sceneIndex << " does not exist" << std::endl;
+        return;
+    }
+    // 深度优先遍历, 父节点在子节点之前加入, 因此m_transforms是拓扑有序的
+    std::vector<std::vector<InstanceRecord>> instancesPerMesh(m_document.model.meshes.size());
+    std::vector<int> skinPerSkinInstance; // 关节节点在遍历结束后才全部可用
+    std::vector<std::pair<int, int>> stack; // (glTF节点, 父节点在m_transforms中的索引)
+    const auto &rootNodes = m_document.model.scenes[sceneIndex].nodes;
+    for (auto it = rootNodes.rbegin(); it != rootNodes.rend(); ++it)
     {
+        stack.emplace_back(*it, -1);
+    }
+    while (!stack.empty())
+    {
+        const auto nodeIndex = stack.back().first;
+        const auto parent = stack.back().second;
+        stack.pop_back();
+
+        const tinygltf::Node &node = m_document.model.nodes[nodeIndex];
+        const auto transformIndex = m_transforms.size();
+        TransformNode transform;
+        transform.parent = parent;
+        transform.gltfNode = nodeIndex;
+        transform.localMatrix = getLocalMatrix(node);
         if (node.translation.size() == 3)
         {
-            glm::vec3 translate = glm::make_vec3(node.translation.data());
-            modelMatrix = glm::translate(modelMatrix, translate);
+            transform.translation = glm::make_vec3(node.translation.data());
         }
         if (node.rotation.size() == 4)
         {
-            glm::vec3 rotate(node.rotation[0], node.rotation[1], node.rotation[2]);
-            modelMatrix = glm::rotate(modelMatrix, (float)node.rotation[3], rotate);
+            transform.rotation = glm::quat(float(node.rotation[3]), float(node.rotation[0]), float(node.rotation[1]), float(node.rotation[2]));
         }
         if (node.scale.size() == 3)
         {
-            glm::vec3 scale = glm::make_vec3(node.scale.data());
-            modelMatrix = glm::scale(modelMatrix, scale);
+            transform.scale = glm::make_vec3(node.scale.data());
+        }
+        m_transforms.push_back(transform);
+        if (m_transformPerNode[nodeIndex] < 0)
+        {
+            m_transformPerNode[nodeIndex] = int(transformIndex);
+        }
+
+        if (node.mesh > -1)
+        {
+            if (!node.weights.empty())
+            {
+                const std::vector<float> weights(begin(node.weights), end(node.weights));
+                setMorphWeights(node.mesh, weights.data(), weights.size());
+            }
+            InstanceRecord instance;
+            instance.transformIndex = transformIndex;
+            if (node.skin >= 0 && node.skin < int(m_document.model.skins.size()))
+            {
+                instance.skinInstance = int(skinPerSkinInstance.size());
+                skinPerSkinInstance.push_back(node.skin);
+            }
+            std::vector<glm::mat4> instanceMatrices;
+            try
+            {
+                instanceMatrices = getInstanceMatrices(node);
+            }
+            catch (const std::exception &e)
+            {
+                std::cerr << "Ignoring EXT_mesh_gpu_instancing of node " << nodeIndex << ": " << e.what() << std::endl;
+            }
+            if (instanceMatrices.empty())
+            {
+                instancesPerMesh[node.mesh].push_back(instance);
+            }
+            for (const auto &matrix : instanceMatrices)
+            {
+                instance.localMatrix = matrix;
+                instancesPerMesh[node.mesh].push_back(instance);
+            }
+        }
+        for (auto it = node.children.rbegin(); it != node.children.rend(); ++it)
+        {
+            stack.emplace_back(*it, int(transformIndex));
         }
     }
-    modelMatrix = modelMatrix * m;
-    if (node.mesh > -1)
+    // 蒙皮实例的关节矩阵连续存放, 只有在场景中的关节节点才有效
+    size_t jointCount = 0;
+    for (const auto skinIndex : skinPerSkinInstance)
     {
-        DrawMesh(node.mesh, modelMatrix);
+        const tinygltf::Skin &skin = m_document.model.skins[skinIndex];
+        SkinInstance skinInstance;
+        skinInstance.jointOffset = jointCount;
+        std::vector<float> inverseBindMatrices;
+        if (skin.inverseBindMatrices >= 0)
+        {
+            inverseBindMatrices = glmlv::readAccessorAsFloats(m_document, skin.inverseBindMatrices);
+        }
+        for (size_t j = 0; j < skin.joints.size(); ++j)
+        {
+            const auto joint = skin.joints[j];
+            const auto jointTransform = joint >= 0 && joint < int(m_transformPerNode.size()) ? m_transformPerNode[joint] : -1;
+            skinInstance.jointTransforms.push_back(jointTransform >= 0 ? size_t(jointTransform) : 0);
+            skinInstance.inverseBindMatrices.push_back((j + 1) * 16 <= inverseBindMatrices.size() ? glm::make_mat4(&inverseBindMatrices[j * 16]) : glm::mat4(1));
+        }
+        jointCount += skin.joints.size();
+        m_skinInstances.push_back(std::move(skinInstance));
     }
-    // 绘制子节点
-    for (size_t i = 0; i < node.children.size(); ++i)
+    m_jointMatrices.assign(jointCount, glm::mat4(1));
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_jointBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, std::max(jointCount, size_t(1)) * sizeof(glm::mat4), nullptr, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    // 同一网格的实例连续存放, 网格的每个图元只需一次实例化绘制
+    for (size_t mesh = 0; mesh < instancesPerMesh.size(); ++mesh)
     {
-        DrawNode(model, model.nodes[node.children[i]], modelMatrix);
+        if (instancesPerMesh[mesh].empty())
+        {
+            continue;
+        }
+        for (auto i = m_primitiveOffsetPerMesh[mesh]; i < m_primitiveOffsetPerMesh[mesh + 1]; ++i)
+        {
+            DrawRecord draw;
+            draw.primitive = m_primitives[i];
+            draw.firstInstance = m_instances.size();
+            draw.instanceCount = GLsizei(instancesPerMesh[mesh].size());
+            m_draws.push_back(draw);
+        }
+        m_instances.insert(end(m_instances), begin(instancesPerMesh[mesh]), end(instancesPerMesh[mesh]));
     }
+    m_instanceData.resize(m_instances.size());
+    glBindBuffer(GL_ARRAY_BUFFER, m_instanceBuffer);
+    glBufferData(GL_ARRAY_BUFFER, std::max(m_instanceData.size(), size_t(1)) * sizeof(InstanceData), nullptr, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    m_bTransformsDirty = true;
 }
 
-void Application::DrawMesh(int meshId, glm::mat4 modelMatrix)
+void Application::updateAnimation(float elapsedSeconds)
 {
-    const auto mvMatrix = m_viewMatrix * modelMatrix;
-    const auto mvpMatrix = m_projMatrix * mvMatrix;
-    const auto normalMatrix = glm::transpose(glm::inverse(mvMatrix));
-    glUniformMatrix4fv(m_uModelViewProjMatrixLocation, 1, GL_FALSE, glm::value_ptr(mvpMatrix));
-    glUniformMatrix4fv(m_uModelViewMatrixLocation, 1, GL_FALSE, glm::value_ptr(mvMatrix));
-    glUniformMatrix4fv(m_uNormalMatrixLocation, 1, GL_FALSE, glm::value_ptr(normalMatrix));
-    // 仅漫反射颜色
-    glUniform3fv(m_uKdLocation, 1, glm::value_ptr(glm::vec3(1, 1, 1)));
-    glBindTexture(GL_TEXTURE_2D, m_diffuseTex[meshId]);
-    const tinygltf::Accessor &indexAccessor = m_model.accessors[m_primitives[meshId].indices];
-    glBindVertexArray(m_vaos[meshId]);
-    glDrawElements(getglTFMode(m_primitives[meshId].mode), indexAccessor.count, indexAccessor.componentType, (const GLvoid *)indexAccessor.byteOffset);
-    glBindVertexArray(0);
+    // 切换动画或回到绑定姿势: 只被上一个动画修改的节点不能停在其最后的姿势
+    if (m_currentAnimation != m_appliedAnimation)
+    {
+        restoreBindPose();
+        m_appliedAnimation = m_currentAnimation;
+    }
+    if (m_currentAnimation < 0 || m_currentAnimation >= int(m_animations.size()))
+    {
+        return;
+    }
+    const auto &animation = m_animations[m_currentAnimation];
+    if (m_playAnimation && animation.duration() > 0.f)
+    {
+        m_animationTime = std::fmod(m_animationTime + elapsedSeconds * m_animationSpeed, animation.duration());
+    }
+    animation.sample(m_animationTime, m_animationOutput.data());
+    for (size_t i = 0; i < animation.channelCount(); ++i)
+    {
+        const auto transformIndex = m_transformPerNode[animation.channelNode(i)];
+        if (transformIndex < 0)
+        {
+            continue;
+        }
+        auto &transform = m_transforms[transformIndex];
+        const auto value = m_animationOutput.data() + animation.channelOutputOffset(i);
+        switch (animation.channelPath(i))
+        {
+        case glmlv::AnimationPath::Translation:
+            transform.translation = glm::make_vec3(value);
+            break;
+        case glmlv::AnimationPath::Rotation:
+            transform.rotation = glm::quat(value[3], value[0], value[1], value[2]);
+            break;
+        case glmlv::AnimationPath::Scale:
+            transform.scale = glm::make_vec3(value);
+            break;
+        case glmlv::AnimationPath::Weights:
+            setMorphWeights(m_document.model.nodes[animation.channelNode(i)].mesh, value, animation.channelComponentCount(i));
+            continue;
+        }
+        setLocalMatrix(size_t(transformIndex), glm::translate(glm::mat4(1), transform.translation) * glm::mat4_cast(transform.rotation) * glm::scale(glm::mat4(1), transform.scale));
+    }
+}
+
+void Application::restoreBindPose()
+{
+    for (size_t i = 0; i < m_bindPose.size(); ++i)
+    {
+        const auto &pose = m_bindPose[i];
+        auto &transform = m_transforms[i];
+        transform.translation = pose.translation;
+        transform.rotation = pose.rotation;
+        transform.scale = pose.scale;
+        if (transform.localMatrix != pose.localMatrix)
+        {
+            setLocalMatrix(i, pose.localMatrix);
+        }
+    }
+    for (auto &morph : m_morphMeshes)
+    {
+        const auto weights = m_morphWeights.begin() + morph.weightOffset;
+        const auto bindWeights = m_bindMorphWeights.begin() + morph.weightOffset;
+        if (!std::equal(bindWeights, bindWeights + morph.targetCount, weights))
+        {
+            std::copy(bindWeights, bindWeights + morph.targetCount, weights);
+            morph.dirty = true;
+        }
+    }
+}
+
+int Application::createMorphMesh(const tinygltf::Mesh &mesh, std::vector<GLuint> &vertexOffsets)
+{
+    // glTF要求网格的所有图元有相同数量的目标
+    MorphMesh morph;
+    for (const auto &prim : mesh.primitives)
+    {
+        morph.targetCount = std::max(morph.targetCount, GLuint(prim.targets.size()));
+        vertexOffsets.push_back(morph.vertexCount);
+        const auto positionIt = prim.attributes.find("POSITION");
+        if (positionIt != end(prim.attributes))
+        {
+            morph.vertexCount += GLuint(m_document.model.accessors[positionIt->second].count);
+        }
+    }
+    if (!morph.targetCount || !morph.vertexCount)
+    {
+        return -1;
+    }
+    vertexOffsets.push_back(morph.vertexCount);
+
+    std::vector<glm::vec4> targets(size_t(2 + 2 * morph.targetCount) * morph.vertexCount, glm::vec4(0));
+    const auto readAttribute = [&](const std::map<std::string, int> &attributes, const char *name, size_t slot, size_t primitive)
+    {
+        const auto it = attributes.find(name);
+        if (it == end(attributes))
+        {
+            return;
+        }
+        const auto values = glmlv::readAccessorAsFloats(m_document, it->second);
+        const auto count = std::min(values.size() / 3, size_t(vertexOffsets[primitive + 1] - vertexOffsets[primitive]));
+        auto output = targets.data() + slot * morph.vertexCount + vertexOffsets[primitive];
+        for (size_t v = 0; v < count; ++v)
+        {
+            output[v] = glm::vec4(values[3 * v], values[3 * v + 1], values[3 * v + 2], 0);
+        }
+    };
+    for (size_t j = 0; j < mesh.primitives.size(); ++j)
+    {
+        const auto &prim = mesh.primitives[j];
+        readAttribute(prim.attributes, "POSITION", 0, j);
+        readAttribute(prim.attributes, "NORMAL", 1, j);
+        for (size_t t = 0; t < prim.targets.size(); ++t)
+        {
+            readAttribute(prim.targets[t], "POSITION", 2 + 2 * t, j);
+            readAttribute(prim.targets[t], "NORMAL", 3 + 2 * t, j);
+        }
+    }
+    vertexOffsets.pop_back();
+
+    // 增量只上传一次; 混合后的顶点只由GPU写入
+    glGenBuffers(1, &morph.targetBuffer);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, morph.targetBuffer);
+    glBufferStorage(GL_SHADER_STORAGE_BUFFER, targets.size() * sizeof(glm::vec4), targets.data(), 0);
+    glGenBuffers(1, &morph.vertexBuffer);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, morph.vertexBuffer);
+    glBufferStorage(GL_SHADER_STORAGE_BUFFER, size_t(2) * morph.vertexCount * sizeof(glm::vec4), nullptr, 0);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    morph.weightOffset = m_morphWeights.size();
+    m_morphWeights.resize(m_morphWeights.size() + morph.targetCount, 0.f);
+    for (size_t t = 0; t < std::min(mesh.weights.size(), size_t(morph.targetCount)); ++t)
+    {
+        m_morphWeights[morph.weightOffset + t] = float(mesh.weights[t]);
+    }
+    m_morphMeshes.push_back(morph);
+    return int(m_morphMeshes.size() - 1);
+}
+
+void Application::setMorphWeights(int mesh, const float *weights, size_t count)
+{
+    if (mesh < 0 || mesh >= int(m_morphMeshPerMesh.size()) || m_morphMeshPerMesh[mesh] < 0)
+    {
+        return;
+    }
+    auto &morph = m_morphMeshes[m_morphMeshPerMesh[mesh]];
+    const auto meshWeights = m_morphWeights.data() + morph.weightOffset;
+    count = std::min(count, size_t(morph.targetCount));
+    if (!std::equal(weights, weights + count, meshWeights))
+    {
+        std::copy(weights, weights + count, meshWeights);
+        morph.dirty = true;
+    }
+}
+
+void Application::updateMorphTargets()
+{
+    if (std::none_of(begin(m_morphMeshes), end(m_morphMeshes), [](const MorphMesh &morph) { return morph.dirty; }))
+    {
+        return;
+    }
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_morphWeightBuffer);
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, m_morphWeights.size() * sizeof(float), m_morphWeights.data());
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    m_morphProgram.use();
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, m_morphWeightBuffer);
+    for (auto &morph : m_morphMeshes)
+    {
+        if (!morph.dirty)
+        {
+            continue;
+        }
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, morph.targetBuffer);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, morph.vertexBuffer);
+        glUniform1ui(m_uMorphVertexCountLocation, morph.vertexCount);
+        glUniform1ui(m_uMorphTargetCountLocation, morph.targetCount);
+        glUniform1ui(m_uMorphWeightOffsetLocation, GLuint(morph.weightOffset));
+        glDispatchCompute((morph.vertexCount + 63) / 64, 1, 1);
+        morph.dirty = false;
+    }
+    // 混合后的顶点接下来作为顶点属性读取
+    glMemoryBarrier(GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT);
+    m_program.use();
+}
+
+void Application::setLocalMatrix(size_t transformIndex, const glm::mat4 &localMatrix)
+{
+    m_transforms[transformIndex].localMatrix = localMatrix;
+    m_transforms[transformIndex].dirty = true;
+    m_bTransformsDirty = true;
+}
+
+void Application::updateWorldTransforms()
+{
+    if (!m_bTransformsDirty)
+    {
+        return;
+    }
+    // 拓扑顺序保证父节点的世界矩阵已经是最新的; 父节点被修改时子节点也被标记
+    for (auto &transform : m_transforms)
+    {
+        if (transform.parent >= 0 && m_transforms[transform.parent].dirty)
+        {
+            transform.dirty = true;
+        }
+        if (!transform.dirty)
+        {
+            continue;
+        }
+        transform.worldMatrix = transform.parent >= 0 ? m_transforms[transform.parent].worldMatrix * transform.localMatrix : transform.localMatrix;
+        transform.worldNormalMatrix = glm::mat4(glm::transpose(glm::inverse(glm::mat3(transform.worldMatrix))));
+    }
+    for (size_t i = 0; i < m_instances.size(); ++i)
+    {
+        const auto &instance = m_instances[i];
+        const auto &transform = m_transforms[instance.transformIndex];
+        if (!transform.dirty)
+        {
+            continue;
+        }
+        if (instance.skinInstance >= 0)
+        {
+            // 蒙皮网格的顶点由关节矩阵变换到世界空间, 节点自身的变换被忽略
+            m_instanceData[i] = {glm::mat4(1), glm::mat4(1), GLint(m_skinInstances[instance.skinInstance].jointOffset)};
+        }
+        else if (instance.localMatrix == glm::mat4(1))
+        {
+            m_instanceData[i] = {transform.worldMatrix, transform.worldNormalMatrix};
+        }
+        else
+        {
+            const auto modelMatrix = transform.worldMatrix * instance.localMatrix;
+            m_instanceData[i] = {modelMatrix, glm::mat4(glm::transpose(glm::inverse(glm::mat3(modelMatrix))))};
+        }
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, m_instanceBuffer);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, m_instanceData.size() * sizeof(InstanceData), m_instanceData.data());
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    // 关节矩阵调色板, 角色之间相互独立, 并行计算
+    glmlv::parallelFor(m_workerPool, m_skinInstances.size(), 16, [&](size_t begin, size_t end)
+    {
+        for (auto i = begin; i < end; ++i)
+        {
+            const auto &skinInstance = m_skinInstances[i];
+            for (size_t j = 0; j < skinInstance.jointTransforms.size(); ++j)
+            {
+                const auto &joint = m_transforms[skinInstance.jointTransforms[j]];
+                if (joint.dirty)
+                {
+                    m_jointMatrices[skinInstance.jointOffset + j] = joint.worldMatrix * skinInstance.inverseBindMatrices[j];
+                }
+            }
+        }
+    });
+    if (!m_jointMatrices.empty())
+    {
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_jointBuffer);
+        glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, m_jointMatrices.size() * sizeof(glm::mat4), m_jointMatrices.data());
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    }
+    for (auto &transform : m_transforms)
+    {
+        transform.dirty = false;
+    }
+    m_bTransformsDirty = false;
+}
+
+void Application::drawScene()
+{
+    // 模型矩阵与法线矩阵是实例属性, 只有视图相关的矩阵是uniform
+    glUniformMatrix4fv(m_uViewProjMatrixLocation, 1, GL_FALSE, glm::value_ptr(m_projMatrix * m_viewMatrix));
+    glUniformMatrix4fv(m_uViewMatrixLocation, 1, GL_FALSE, glm::value_ptr(m_viewMatrix));
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, m_jointBuffer);
+    GLuint boundVao = 0;
+    GLuint boundTexture = 0;
     glBindTexture(GL_TEXTURE_2D, 0);
-    // 绘制网格
-    for (size_t i = 0; i < m_vaos.size(); ++i)
+    for (const auto &draw : m_draws)
     {
-        const tinygltf::Accessor &indexAccessor = m_model.accessors[m_primitives[i].indices];
-        glBindVertexArray(m_vaos[i]);
-        glDrawElements(getglTFMode(m_primitives[i].mode), indexAccessor.count, indexAccessor.componentType, (const GLvoid *)indexAccessor.byteOffset);
+        const auto &primitive = draw.primitive;
+        glUniform3fv(m_uKdLocation, 1, glm::value_ptr(primitive.diffuseColor));
+        if (primitive.diffuseTexture != boundTexture)
+        {
+            glBindTexture(GL_TEXTURE_2D, primitive.diffuseTexture);
+            boundTexture = primitive.diffuseTexture;
+        }
+        if (primitive.vao != boundVao)
+        {
+            glBindVertexArray(primitive.vao);
+            boundVao = primitive.vao;
+        }
+        if (primitive.indexType != GL_NONE)
+        {
+            glDrawElementsInstancedBaseInstance(primitive.mode, primitive.count, primitive.indexType, (const GLvoid *)primitive.indexByteOffset, draw.instanceCount, GLuint(draw.firstInstance));
+        }
+        else
+        {
+            glDrawArraysInstancedBaseInstance(primitive.mode, 0, primitive.count, draw.instanceCount, GLuint(draw.firstInstance));
+        }
     }
+    glBindVertexArray(0);
+    glBindTexture(GL_TEXTURE_2D, 0);
 }
 
 GLenum Application::getglTFMode(int mode)
@@ -380,17 +1115,30 @@ GLenum Application::getglTFMode(int mode)
     }
 }
 
-void Application::drawModel(tinygltf::Model &model)
+std::vector<glmlv::MemoryUsage> Application::getMemoryUsage() const
 {
-    if (model.scenes.size() < 0)
+    const auto makeUsage = [](glmlv::MemoryDomain domain, const char * category, size_t byteSize, size_t count)
     {
-        fprintf(stderr, "Scene has no model.");
-        exit(EXIT_FAILURE);
-    }
-    int scene_to_display = model.defaultScene > -1 ? model.defaultScene : 0;
-    const tinygltf::Scene &scene = model.scenes[scene_to_display];
-    for (size_t i = 0; i < scene.nodes.size(); ++i)
+        glmlv::MemoryUsage usage;
+        usage.domain = domain;
+        usage.category = category;
+        usage.byteSize = byteSize;
+        usage.count = count;
+        return usage;
+    };
+    size_t morphByteSize = 0;
+    for (const auto & morph : m_morphMeshes)
     {
-        DrawNode(model, model.nodes[scene.nodes[i]], glm::mat4(1));
+        morphByteSize += (size_t(2) + 2 * morph.targetCount) * morph.vertexCount * sizeof(glm::vec4); // 目标缓冲区
+        morphByteSize += size_t(2) * morph.vertexCount * sizeof(glm::vec4); // 混合后的顶点
     }
+    return {
+        makeUsage(glmlv::MemoryDomain::GPU, "geometry", m_bufferByteSize, 1),
+        makeUsage(glmlv::MemoryDomain::GPU, "instances", std::max(m_instanceData.size(), size_t(1)) * sizeof(InstanceData), m_instanceData.size()),
+        makeUsage(glmlv::MemoryDomain::GPU, "joints", std::max(m_jointMatrices.size(), size_t(1)) * sizeof(glm::mat4), m_jointMatrices.size()),
+        makeUsage(glmlv::MemoryDomain::GPU, "morphTargets", morphByteSize + std::max(m_morphWeights.size(), size_t(1)) * sizeof(float), m_morphMeshes.size()),
+        makeUsage(glmlv::MemoryDomain::CPU, "instances", m_instances.capacity() * sizeof(InstanceRecord) + m_instanceData.capacity() * sizeof(InstanceData), m_instances.size()),
+        makeUsage(glmlv::MemoryDomain::CPU, "transforms", m_transforms.capacity() * sizeof(TransformNode), m_transforms.size()),
+        makeUsage(glmlv::MemoryDomain::CPU, "draws", m_draws.capacity() * sizeof(DrawRecord), m_draws.size())
+    };
 }
@@ -5,7 +5,13 @@
 #include <glmlv/GLProgram.hpp>
 #include <glmlv/ViewController.hpp>
 #include <glmlv/simple_geometry.hpp>
+#include <glmlv/GLTexture2D.hpp>
+#include <glmlv/gltf_loading.hpp>
+#include <glmlv/animation.hpp>
+#include <glmlv/memory_registry.hpp>
+#include <glmlv/parallel.hpp>
 #include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
 #include <limits>
 #include <tiny_gltf.h>
 
@@ -37,11 +43,14 @@ private:
     GLuint m_textureSampler = 0;
 
     glmlv::GLProgram m_program;
+    glmlv::GLProgram m_morphProgram; // 计算变形目标混合后的顶点
+    GLint m_uMorphVertexCountLocation;
+    GLint m_uMorphTargetCountLocation;
+    GLint m_uMorphWeightOffsetLocation;
 
     glmlv::ViewController m_viewController{m_GLFWHandle.window(), 3.0f};
-    GLint m_uModelViewProjMatrixLocation;
-    GLint m_uModelViewMatrixLocation;
-    GLint m_uNormalMatrixLocation;
+    GLint m_uViewProjMatrixLocation;
+    GLint m_uViewMatrixLocation;
 
     GLint m_uDirectionalLightDirLocation;
     GLint m_uDirectionalLightIntensityLocation;
@@ -64,25 +73,180 @@ private:
 
 
     std::string path;
+    bool m_compressTextures = true; // 使用块压缩纹理 (--no-texture-compression 关闭)
+    bool m_mapBuffers = true; // 内存映射.glb/.bin文件而不是由tinygltf复制 (--no-mmap 关闭)
     glm::mat4 m_projMatrix;
     glm::mat4 m_viewMatrix;
 
     // 使用gluint映射tinyglTF缓冲区类型以应用于正确的缓冲区
     std::map<std::string, GLuint> m_attribs;
 
+    // 图元的绘制参数, 载入时从访问器解析一次
+    struct PrimitiveDraw
+    {
+        GLuint vao = 0;
+        GLenum mode = GL_TRIANGLES;
+        GLsizei count = 0; // 索引数量 (无索引时为顶点数量)
+        GLenum indexType = GL_NONE; // GL_NONE表示无索引, 使用glDrawArrays
+        size_t indexByteOffset = 0; // 在m_buffer中的偏移
+        GLuint diffuseTexture = 0; // 0表示无纹理
+        glm::vec3 diffuseColor = glm::vec3(1);
+    };
+
+    // 变换层次中的一个节点实例. 按拓扑顺序存储: 父节点总在子节点之前
+    struct TransformNode
+    {
+        int parent = -1; // m_transforms中的索引, 根节点为-1
+        int gltfNode = -1;
+        glm::mat4 localMatrix = glm::mat4(1);
+        glm::vec3 translation = glm::vec3(0); // 动画修改的TRS, 由节点的TRS初始化 (矩阵节点不能被动画化)
+        glm::quat rotation = glm::quat(1, 0, 0, 0);
+        glm::vec3 scale = glm::vec3(1);
+        glm::mat4 worldMatrix = glm::mat4(1);
+        glm::mat4 worldNormalMatrix = glm::mat4(1); // 世界矩阵3x3部分的逆转置, 不含平移
+        bool dirty = true;
+    };
+
+    // 网格的一个实例: 一个节点实例, 以及EXT_mesh_gpu_instancing在节点空间中的变换
+    struct InstanceRecord
+    {
+        size_t transformIndex = 0; // m_transforms中的索引
+        glm::mat4 localMatrix = glm::mat4(1);
+        int skinInstance = -1; // m_skinInstances中的索引, 蒙皮网格的实例
+    };
+
+    // 实例缓冲区的内容, 顶点着色器中每个实例的属性
+    struct InstanceData
+    {
+        glm::mat4 modelMatrix;
+        glm::mat4 normalMatrix; // 模型矩阵3x3部分的逆转置, 不含平移
+        GLint jointOffset = -1; // 关节矩阵在m_jointMatrices中的偏移, -1表示无蒙皮
+        GLint padding[3] = {0, 0, 0};
+    };
+
+    // 一个蒙皮节点的关节, 其关节矩阵连续存放在m_jointMatrices中
+    struct SkinInstance
+    {
+        size_t jointOffset = 0;
+        std::vector<size_t> jointTransforms; // 关节节点在m_transforms中的索引
+        std::vector<glm::mat4> inverseBindMatrices;
+    };
+
+    // 扁平绘制列表中的一项, 每帧只需线性遍历. 同一网格的所有实例在一次实例化绘制中完成
+    struct DrawRecord
+    {
+        PrimitiveDraw primitive;
+        size_t firstInstance = 0; // m_instances中的索引
+        GLsizei instanceCount = 0;
+    };
+
+    GLuint m_buffer = 0; // 所有图元的顶点与索引
+    size_t m_bufferByteSize = 0;
     std::vector<GLuint> m_vaos;
-    std::vector<tinygltf::Primitive> m_primitives;
-    std::vector<GLuint> m_diffuseTex;
+    std::vector<PrimitiveDraw> m_primitives; // 所有网格的图元
+    std::vector<size_t> m_primitiveOffsetPerMesh; // 网格i的图元为[m_primitiveOffsetPerMesh[i], m_primitiveOffsetPerMesh[i + 1])
+    std::vector<glmlv::GLTexture2D> m_textures;
+
+    std::vector<TransformNode> m_transforms;
 
-    tinygltf::Model m_model;
+    // 节点实例加载时的局部变换, 与m_transforms对应
+    struct BindPose
+    {
+        glm::mat4 localMatrix;
+        glm::vec3 translation;
+        glm::quat rotation;
+        glm::vec3 scale;
+    };
+    std::vector<BindPose> m_bindPose;
+    std::vector<InstanceRecord> m_instances; // 按网格连续存放
+    std::vector<InstanceData> m_instanceData;
+    GLuint m_instanceBuffer = 0;
+    std::vector<int> m_transformPerNode; // glTF节点的第一个实例在m_transforms中的索引, 不在场景中为-1
+    std::vector<SkinInstance> m_skinInstances;
+    std::vector<glm::mat4> m_jointMatrices; // 关节的世界矩阵乘以逆绑定矩阵, 上传到着色器存储缓冲区
+    GLuint m_jointBuffer = 0;
+
+    // 有变形目标的网格. 增量打包在一个着色器存储缓冲区中, 权重改变时由计算着色器混合到顶点缓冲区.
+    // 共享同一网格的节点共享其权重
+    struct MorphMesh
+    {
+        GLuint targetBuffer = 0; // 基础位置, 基础法线, 然后是每个目标的位置与法线增量, 每个顶点一个vec4
+        GLuint vertexBuffer = 0; // 每个顶点混合后的位置与法线, 作为顶点属性读取
+        GLuint vertexCount = 0; // 网格所有图元的顶点数之和
+        GLuint targetCount = 0;
+        size_t weightOffset = 0; // m_morphWeights中的偏移
+        bool dirty = true; // 权重改变, 需要重新混合
+    };
+
+    std::vector<int> m_morphMeshPerMesh; // m_morphMeshes中的索引, 没有变形目标为-1
+    std::vector<MorphMesh> m_morphMeshes;
+    std::vector<float> m_morphWeights;
+    std::vector<float> m_bindMorphWeights; // 加载时的权重, 与m_morphWeights对应
+    GLuint m_morphWeightBuffer = 0;
+
+    std::vector<glmlv::AnimationClip> m_animations;
+    std::vector<float> m_animationOutput;
+    int m_currentAnimation = 0; // -1表示绑定姿势
+    int m_appliedAnimation = -1; // 当前姿势来自的动画, 与m_currentAnimation不同时先恢复绑定姿势
+    bool m_playAnimation = true;
+    float m_animationSpeed = 1.f;
+    float m_animationTime = 0.f;
+    std::vector<DrawRecord> m_draws;
+    bool m_bTransformsDirty = true; // 至少一个节点的局部矩阵被修改
+
+    glmlv::GltfDocument m_document; // 模型与其缓冲区 (映射的文件或tinygltf的拷贝)
+
+    glmlv::ThreadPool m_workerPool; // 加载时解码纹理, 每帧计算关节矩阵, 避免每帧创建线程
+
+    // 在线程池中解码 (并压缩) 的纹理
+    struct DecodedTexture
+    {
+        glmlv::CompressedImage2D compressedImage; // 不压缩纹理时为空, 使用m_document中解码的图像
+        double milliseconds = 0; // 解码与压缩所用的时间
+    };
 
-    // 加载glTF 使用tinyglTF库
+    // 加载glTF或GLB 使用tinyglTF库
     void loadModel();
 
-    void DrawNode(tinygltf::Model &model, const tinygltf::Node &node, glm::mat4 m);
-    // 绘制场景网格
-    void DrawMesh(int meshIndex, glm::mat4 modelMatrix);
+    // 图元材质的baseColor纹理对应的图像, 没有则为-1
+    int getBaseColorImage(const tinygltf::Primitive & prim) const;
+
+    // 遍历场景图, 生成拓扑顺序的变换数组与扁平绘制列表. 共享同一网格的节点与EXT_mesh_gpu_instancing的实例合并为实例化绘制
+    void buildDrawList(int sceneIndex);
+
+    // 节点的EXT_mesh_gpu_instancing实例变换, 没有该扩展时为空
+    std::vector<glm::mat4> getInstanceMatrices(const tinygltf::Node & node) const;
+
+    // 修改一个节点实例的局部矩阵, 世界矩阵在下一次updateWorldTransforms时重新计算
+    void setLocalMatrix(size_t transformIndex, const glm::mat4 & localMatrix);
+
+    // 推进当前动画并写入被动画化节点的局部矩阵与变形目标权重
+    void updateAnimation(float elapsedSeconds);
+
+    // 恢复所有节点加载时的局部变换与变形目标权重, 只有被修改的节点被标记
+    void restoreBindPose();
+
+    // 打包网格的基础顶点与变形目标增量, 返回m_morphMeshes中的索引, 没有变形目标为-1. vertexOffsets为每个图元在网格顶点中的偏移
+    int createMorphMesh(const tinygltf::Mesh & mesh, std::vector<GLuint> & vertexOffsets);
+
+    // 修改网格的变形目标权重, 只有值改变时才标记为需要重新混合
+    void setMorphWeights(int mesh, const float * weights, size_t count);
+
+    // 为权重改变的网格调度计算着色器, 每个网格一次调度
+    void updateMorphTargets();
+
+    // 只重新计算被修改的节点及其子节点的世界矩阵, 以及它们的实例与关节矩阵, 静态场景不做任何计算
+    void updateWorldTransforms();
+
+    // 线性遍历绘制列表, 只在状态变化时重新绑定VAO与纹理
+    void drawScene();
+
+    static glm::mat4 getLocalMatrix(const tinygltf::Node & node);
 
     GLenum getglTFMode(int mode);
-    void drawModel(tinygltf::Model &model);
+
+    // 本程序直接创建的GL缓冲区与其CPU数据的大小, GLTexture2D自行统计
+    std::vector<glmlv::MemoryUsage> getMemoryUsage() const;
+
+    glmlv::MemorySource m_memorySource; // 最后声明, 最先析构: 报告函数读取上面的成员
 };
\ No newline at end of file
@@ -1,4 +1,4 @@
-#version 330
+#version 430
 
 in vec3 vViewSpacePosition;
 in vec3 vViewSpaceNormal;
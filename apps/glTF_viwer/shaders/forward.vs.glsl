@@ -1,20 +1,41 @@
-#version 330
+#version 430
 
 layout(location = 0) in vec3 aPosition;
 layout(location = 1) in vec3 aNormal;
 layout(location = 2) in vec2 aTexCoords;
+// Per instance (divisor 1)
+layout(location = 3) in mat4 aInstanceModelMatrix;
+layout(location = 7) in mat4 aInstanceNormalMatrix;
+layout(location = 11) in int aInstanceJointOffset; // -1 if the instance is not skinned
+// Skinning
+layout(location = 12) in uvec4 aJoints;
+layout(location = 13) in vec4 aWeights;
 
 out vec3 vViewSpacePosition;
 out vec3 vViewSpaceNormal;
 out vec2 vTexCoords;
 
-uniform mat4 uModelViewProjMatrix;
-uniform mat4 uModelViewMatrix;
-uniform mat4 uNormalMatrix;
+uniform mat4 uViewProjMatrix;
+uniform mat4 uViewMatrix; // Rigid transform, also used for normals
+
+// Joint matrices of all skinned instances: world matrix of the joint times its inverse bind matrix
+layout(std430, binding = 0) readonly buffer JointMatrices {
+    mat4 uJointMatrices[];
+};
 
 void main() {
-    vViewSpacePosition = vec3(uModelViewMatrix * vec4(aPosition, 1));
-	vViewSpaceNormal = vec3(uNormalMatrix * vec4(aNormal, 0));
+    mat4 modelMatrix = aInstanceModelMatrix;
+    mat4 normalMatrix = aInstanceNormalMatrix;
+    if (aInstanceJointOffset >= 0) {
+        ivec4 joints = aInstanceJointOffset + ivec4(aJoints);
+        modelMatrix = aWeights.x * uJointMatrices[joints.x] + aWeights.y * uJointMatrices[joints.y] +
+            aWeights.z * uJointMatrices[joints.z] + aWeights.w * uJointMatrices[joints.w];
+        // Exact for rotations and uniform scales, which is what joints use in practice
+        normalMatrix = modelMatrix;
+    }
+    vec4 worldPosition = modelMatrix * vec4(aPosition, 1);
+    vViewSpacePosition = vec3(uViewMatrix * worldPosition);
+	vViewSpaceNormal = normalize(vec3(uViewMatrix * (normalMatrix * vec4(aNormal, 0))));
 	vTexCoords = aTexCoords;
-    gl_Position =  uModelViewProjMatrix * vec4(aPosition, 1);
-}
\ No newline at end of file
+    gl_Position =  uViewProjMatrix * worldPosition;
+}
@@ -0,0 +1,40 @@
+#version 430
+
+layout(local_size_x = 64) in;
+
+// Base positions, base normals, then the position and normal deltas of each target, uVertexCount elements each
+layout(std430, binding = 1) readonly restrict buffer MorphTargets {
+    vec4 uTargets[];
+};
+
+layout(std430, binding = 2) readonly restrict buffer MorphWeights {
+    float uWeights[];
+};
+
+// Position and normal of each vertex, read as vertex attributes by the forward pass
+layout(std430, binding = 3) writeonly restrict buffer MorphedVertices {
+    vec4 uVertices[];
+};
+
+uniform uint uVertexCount;
+uniform uint uTargetCount;
+uniform uint uWeightOffset;
+
+void main() {
+    uint vertex = gl_GlobalInvocationID.x;
+    if (vertex >= uVertexCount)
+        return;
+
+    vec3 position = uTargets[vertex].xyz;
+    vec3 normal = uTargets[uVertexCount + vertex].xyz;
+    for (uint i = 0; i < uTargetCount; ++i) {
+        float weight = uWeights[uWeightOffset + i];
+        if (weight != 0) {
+            position += weight * uTargets[(2 + 2 * i) * uVertexCount + vertex].xyz;
+            normal += weight * uTargets[(3 + 2 * i) * uVertexCount + vertex].xyz;
+        }
+    }
+
+    uVertices[2 * vertex] = vec4(position, 1);
+    uVertices[2 * vertex + 1] = vec4(dot(normal, normal) > 0 ? normalize(normal) : normal, 0);
+}
@@ -0,0 +1,134 @@
+#include <glmlv/gltf_writing.hpp>
+#include <glmlv/index_packing.hpp>
+#include <glmlv/memory_registry.hpp>
+#include <glmlv/scene_loading.hpp>
+#include <glmlv/scene_optimization.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <string>
+
+// Convert a scene (.obj or .gltf/.glb) to a binary glTF file that loads without text parsing:
+// obj2glb input output.glb [--instancing] [--merge] [--merge-grid size] [--vertex-cache] [--overdraw] [--no-textures] [--memory-report report.json]
+int main(int argc, char** argv)
+{
+    if (argc < 3)
+    {
+        std::cerr << "usage: " << argv[0] << " input output.glb [--instancing] [--merge] [--merge-grid size] [--vertex-cache] [--overdraw] [--no-textures] [--memory-report report.json]" << std::endl;
+        std::cerr << "  --instancing    keep one copy of the shapes with the same geometry, the others become instances of it" << std::endl;
+        std::cerr << "  --merge         merge the shapes sharing a material, pre-transformed to world space" << std::endl;
+        std::cerr << "  --merge-grid    merge the shapes sharing a material within cells of the given size, implies --merge" << std::endl;
+        std::cerr << "  --vertex-cache  reorder the triangles of each shape for the post transform vertex cache" << std::endl;
+        std::cerr << "  --overdraw      then reorder clusters of triangles to reduce overdraw, implies --vertex-cache" << std::endl;
+        std::cerr << "  --no-textures   do not load nor write textures" << std::endl;
+        std::cerr << "  --memory-report write the memory used by the scene once optimized as JSON" << std::endl;
+        return -1;
+    }
+
+    const glmlv::fs::path inputPath = argv[1];
+    const glmlv::fs::path outputPath = argv[2];
+    bool detectInstances = false;
+    bool mergeShapes = false;
+    float mergeGridCellSize = 0.f;
+    bool optimizeVertexCache = false;
+    bool optimizeOverdraw = false;
+    bool loadTextures = true;
+    glmlv::fs::path memoryReportPath;
+    for (int i = 3; i < argc; ++i)
+    {
+        const std::string option = argv[i];
+        if (option == "--instancing") {
+            detectInstances = true;
+        }
+        else if (option == "--merge") {
+            mergeShapes = true;
+        }
+        else if (option == "--merge-grid" && i + 1 < argc) {
+            mergeShapes = true;
+            mergeGridCellSize = std::stof(argv[++i]);
+        }
+        else if (option == "--vertex-cache") {
+            optimizeVertexCache = true;
+        }
+        else if (option == "--overdraw") {
+            optimizeVertexCache = optimizeOverdraw = true;
+        }
+        else if (option == "--no-textures") {
+            loadTextures = false;
+        }
+        else if (option == "--memory-report" && i + 1 < argc) {
+            memoryReportPath = argv[++i];
+        }
+        else {
+            std::clog << "Warning: unknown option " << option << std::endl;
+        }
+    }
+
+    try
+    {
+        using clock = std::chrono::steady_clock;
+        const auto seconds = [](clock::time_point start) { return std::chrono::duration<double>(clock::now() - start).count(); };
+
+        auto start = clock::now();
+        glmlv::SceneData data;
+        glmlv::loadScene(inputPath, data, loadTextures);
+        std::clog << "Loaded " << inputPath << " in " << seconds(start) << " s: " << data.shapeCount << " shapes, "
+            << data.vertexBuffer.size() << " vertices, " << data.indexBuffer.size() / 3 << " triangles" << std::endl;
+
+        if (detectInstances)
+        {
+            start = clock::now();
+            glmlv::detectInstances(data);
+            std::clog << "Instances detected in " << seconds(start) << " s: " << data.shapeCount << " shapes, "
+                << data.instanceMatrices.size() << " additional instances, " << data.vertexBuffer.size() << " vertices" << std::endl;
+        }
+        if (mergeShapes)
+        {
+            start = clock::now();
+            const auto shapeCount = data.shapeCount;
+            glmlv::mergeShapesByMaterial(data, mergeGridCellSize);
+            std::clog << "Shapes merged in " << seconds(start) << " s: " << shapeCount << " -> " << data.shapeCount << " shapes, "
+                << data.vertexBuffer.size() << " vertices" << std::endl;
+        }
+
+        const auto overdrawRatio = optimizeOverdraw ? glmlv::computeOverdrawRatio(data) : 0.f;
+        if (optimizeVertexCache)
+        {
+            start = clock::now();
+            const auto missRatio = glmlv::computeAverageCacheMissRatio(data);
+            glmlv::optimizeVertexCache(data);
+            std::clog << "Vertex cache optimized in " << seconds(start) << " s, vertices per triangle: "
+                << missRatio << " -> " << glmlv::computeAverageCacheMissRatio(data) << std::endl;
+        }
+        if (optimizeOverdraw)
+        {
+            start = clock::now();
+            glmlv::optimizeOverdraw(data);
+            std::clog << "Overdraw optimized in " << seconds(start) << " s, vertices per triangle: " << glmlv::computeAverageCacheMissRatio(data)
+                << ", fragments per pixel: " << overdrawRatio << " -> " << glmlv::computeOverdrawRatio(data) << std::endl;
+        }
+
+        const auto packedIndices = glmlv::packIndexBuffer(data);
+        const auto shortShapeCount = std::count(begin(packedIndices.indexSizePerShape), end(packedIndices.indexSizePerShape), uint8_t(sizeof(uint16_t)));
+        std::clog << "Index buffer: " << data.indexBuffer.size() * sizeof(uint32_t) << " -> " << packedIndices.data.size() << " bytes, "
+            << shortShapeCount << " of " << data.shapeCount << " shapes with 16 bits indices" << std::endl;
+
+        if (!memoryReportPath.empty())
+        {
+            const glmlv::MemorySource sceneMemory("Scene", [&]() { return glmlv::computeSceneMemoryUsage(data); });
+            glmlv::writeMemoryReport(glmlv::collectMemoryUsage(), memoryReportPath);
+        }
+
+        start = clock::now();
+        glmlv::writeGlbScene(data, outputPath);
+        std::clog << "Wrote " << outputPath << " in " << seconds(start) << " s" << std::endl;
+    }
+    catch (const std::exception & e)
+    {
+        std::cerr << e.what() << std::endl;
+        return -1;
+    }
+
+    return 0;
+}
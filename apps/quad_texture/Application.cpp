@@ -5,7 +5,6 @@
 #include <glm/glm.hpp>
 #include <imgui.h>
 #include <glmlv/imgui_impl_glfw_gl3.hpp>
-#include <glmlv/Image2DRGBA.hpp>
 
 int Application::run()
 {
@@ -19,7 +18,7 @@ int Application::run()
         glUniform1i(m_uSamplerLocation, 0);
         glBindSampler(0, m_samplerObject);
 
-        glBindTexture(GL_TEXTURE_2D, m_texObject);
+        m_texture.bind();
         glBindVertexArray(m_quadVAO);
         glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, nullptr);
         glBindVertexArray(0);
@@ -29,6 +28,7 @@ int Application::run()
         {
             ImGui::Begin("GUI");
             ImGui::Text("Application average %.3f ms/frame (%.1f FPS)", 1000.0f / ImGui::GetIO().Framerate, ImGui::GetIO().Framerate);
+            ImGui::Text("Texture memory: %.2f MB", m_texture.byteSize() / (1024.f * 1024.f));
             ImGui::ColorEditMode(ImGuiColorEditMode_RGB);
             if (ImGui::ColorEdit3("clearColor", clearColor)) {
                 glClearColor(clearColor[0], clearColor[1], clearColor[2], 1.f);
@@ -120,19 +120,13 @@ Application::Application(int argc, char** argv):
     glBindVertexArray(0);
 
     {
-        auto image = glmlv::readImage(m_AssetsRootPath / m_AppName / "textures" / "opengl-logo.png");
-
         glActiveTexture(GL_TEXTURE0);
 
-        glGenTextures(1, &m_texObject);
-        glBindTexture(GL_TEXTURE_2D, m_texObject);
-        glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGB32F, image.width(), image.height());
-        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, image.width(), image.height(), GL_RGBA, GL_UNSIGNED_BYTE, image.data());
-        glBindTexture(GL_TEXTURE_2D, 0);
+        m_texture = glmlv::GLTexture2D(m_AssetsRootPath / m_AppName / "textures" / "opengl-logo.png", true);
     }
 
     glGenSamplers(1, &m_samplerObject);
-    glSamplerParameteri(m_samplerObject, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glSamplerParameteri(m_samplerObject, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
     glSamplerParameteri(m_samplerObject, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 
     m_uSamplerLocation = glGetUniformLocation(m_program.glId(), "uSampler");
@@ -154,10 +148,6 @@ Application::~Application()
         glDeleteBuffers(1, &m_quadVAO);
     }
 
-    if (m_texObject) {
-        glDeleteTextures(1, &m_texObject);
-    }
-
     if (m_samplerObject) {
         glDeleteSamplers(1, &m_samplerObject);
     }
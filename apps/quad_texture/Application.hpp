@@ -3,6 +3,7 @@
 #include <glmlv/filesystem.hpp>
 #include <glmlv/GLFWHandle.hpp>
 #include <glmlv/GLProgram.hpp>
+#include <glmlv/GLTexture2D.hpp>
 
 class Application
 {
@@ -27,7 +28,7 @@ private:
     GLuint m_quadIBO = 0;
     GLuint m_quadVAO = 0;
 
-    GLuint m_texObject = 0;
+    glmlv::GLTexture2D m_texture;
     GLuint m_samplerObject = 0;
 
     GLint m_uSamplerLocation = -1;
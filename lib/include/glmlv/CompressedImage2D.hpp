@@ -0,0 +1,149 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include <glad/glad.h>
+#include <glmlv/filesystem.hpp>
+#include <glmlv/Image2DRGBA.hpp>
+
+// S3TC enums are not part of core OpenGL, they are not defined by our glad loader
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#endif
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+#ifndef GL_COMPRESSED_SRGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_SRGB_S3TC_DXT1_EXT 0x8C4C
+#endif
+#ifndef GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT 0x8C4F
+#endif
+
+namespace glmlv
+{
+
+// Block compressed formats. All of them encode 4x4 texels blocks in 8 or 16 bytes.
+// BC1 and BC3 require GL_EXT_texture_compression_s3tc, the others are part of OpenGL 4.3 core.
+enum class CompressedFormat : uint32_t
+{
+    BC1_RGB = 1, // Opaque color, 8 bytes per block
+    BC1_SRGB = 2,
+    BC3_RGBA = 3, // Color with alpha, 16 bytes per block
+    BC3_SRGB_ALPHA = 4,
+    BC4_R = 5, // Single channel data, 8 bytes per block
+    BC5_RG = 6, // Two channels data (normal maps), 16 bytes per block
+    ETC2_RGB = 7, // Opaque color, 8 bytes per block
+    ETC2_SRGB = 8,
+    ETC2_RGBA_EAC = 9, // Color with alpha, 16 bytes per block
+    ETC2_SRGB_ALPHA_EAC = 10,
+    EAC_R11 = 11, // Single channel data, 8 bytes per block
+    EAC_RG11 = 12, // Two channels data, 16 bytes per block
+    BC7_RGBA = 13, // High quality color with alpha (BPTC), 16 bytes per block. Can be loaded from containers but not encoded.
+    BC7_SRGB_ALPHA = 14
+};
+
+GLenum getGLInternalFormat(CompressedFormat format);
+
+// Size in bytes of a 4x4 block
+size_t getBlockByteSize(CompressedFormat format);
+
+// Pick the compressed format of an image according to the number of channels that are meaningful (1, 2, 3 or 4).
+// Color images with 4 channels are compressed with an alpha format only if some texels are not opaque.
+// sRGB images with 1 or 2 channels (gray, gray with alpha) use the RGB and RGBA formats, their RGB channels must hold the gray.
+// If useS3TC is false, the ETC2/EAC formats of OpenGL 4.3 core are returned.
+CompressedFormat chooseCompressedFormat(const Image2DRGBA & image, ColorSpace colorSpace, size_t channelCount, bool useS3TC);
+
+// Block compressed mip chain, stored from the largest level to the smallest in a single allocation unless it references external storage
+class CompressedImage2D
+{
+public:
+    CompressedImage2D() = default;
+
+    // Allocate levelCount levels of a width x height image
+    CompressedImage2D(CompressedFormat format, size_t width, size_t height, size_t levelCount);
+
+    // Reference levels stored elsewhere (e.g. in a memory mapped file), data is kept alive by the shared pointer.
+    // levelOffsets[level] is the offset of each level from data, levels must not be written.
+    CompressedImage2D(CompressedFormat format, size_t width, size_t height, std::shared_ptr<unsigned char> data, std::vector<size_t> levelOffsets);
+
+    CompressedImage2D(const CompressedImage2D&) = delete;
+    CompressedImage2D& operator =(const CompressedImage2D&) = delete;
+
+    CompressedImage2D(CompressedImage2D&&) = default;
+    CompressedImage2D& operator =(CompressedImage2D&&) = default;
+
+    CompressedFormat format() const
+    {
+        return m_Format;
+    }
+
+    size_t levelCount() const
+    {
+        return m_LevelOffsets.size();
+    }
+
+    size_t width(size_t level = 0) const
+    {
+        return std::max(size_t(1), m_nWidth >> level);
+    }
+
+    size_t height(size_t level = 0) const
+    {
+        return std::max(size_t(1), m_nHeight >> level);
+    }
+
+    size_t blockCountX(size_t level = 0) const
+    {
+        return (width(level) + 3) / 4;
+    }
+
+    size_t blockCountY(size_t level = 0) const
+    {
+        return (height(level) + 3) / 4;
+    }
+
+    size_t byteSize(size_t level) const
+    {
+        return blockCountX(level) * blockCountY(level) * getBlockByteSize(m_Format);
+    }
+
+    size_t byteSize() const
+    {
+        return m_nByteSize;
+    }
+
+    const unsigned char * data(size_t level = 0) const
+    {
+        return m_pData.get() + m_LevelOffsets[level];
+    }
+
+    unsigned char * data(size_t level = 0)
+    {
+        return m_pData.get() + m_LevelOffsets[level];
+    }
+
+private:
+    CompressedFormat m_Format = CompressedFormat::BC1_RGB;
+    std::shared_ptr<unsigned char> m_pData;
+    std::vector<size_t> m_LevelOffsets;
+    size_t m_nByteSize = 0;
+    size_t m_nWidth = 0;
+    size_t m_nHeight = 0;
+};
+
+// Compress all the levels of a mip chain. Blocks are encoded in parallel.
+// BC7 has no encoder, requesting it throws.
+CompressedImage2D compressImage(const Image2DRGBAMipChain & mipChain, CompressedFormat format);
+
+// Read and write compressed images in the binary format of the texture cache
+CompressedImage2D readCompressedImage(const fs::path & path);
+void writeCompressedImage(const CompressedImage2D & image, const fs::path & path);
+
+// Return the compressed mip chain of an image, loaded from cacheDirectory if it has already been computed.
+// Otherwise the mip chain is generated and compressed, then stored in cacheDirectory for the next loads.
+// Cache entries are named after a hash of the image content, the color space and the format.
+CompressedImage2D loadOrCompressImage(const Image2DRGBA & image, ColorSpace colorSpace, CompressedFormat format, const fs::path & cacheDirectory);
+
+}
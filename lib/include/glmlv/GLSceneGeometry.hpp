@@ -0,0 +1,93 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glmlv/GLTexture2D.hpp>
+#include <glmlv/scene_loading.hpp>
+
+namespace glmlv
+{
+
+// Vertex, index and instance buffers of a SceneData, with two vertex arrays:
+// - all the attributes: location 0 position, 1 normal, 2 texture coordinates, 3 tangent if the scene has tangents
+// - positions only at location 0, for depth prepasses and shadow maps
+// Both read the localToWorld matrix of the instance being drawn at locations 4 to 7 (one column each, divisor 1): the matrix of
+// the shape followed by its instanceMatrices (see detectInstances). The normal matrix is to be derived from it in the shader.
+// Interleaved scenes are uploaded in one vertex buffer, scenes with split vertex streams (see splitVertexStreams) in one buffer per
+// attribute: the position only vertex array then reads tightly packed positions. Indices are packed with packIndexBuffer.
+class GLSceneGeometry
+{
+public:
+    GLSceneGeometry() = default;
+
+    explicit GLSceneGeometry(const SceneData & data);
+
+    ~GLSceneGeometry();
+
+    GLSceneGeometry(const GLSceneGeometry&) = delete;
+    GLSceneGeometry& operator =(const GLSceneGeometry&) = delete;
+
+    GLSceneGeometry(GLSceneGeometry&& rvalue);
+    GLSceneGeometry& operator =(GLSceneGeometry&& rvalue);
+
+    void bind() const
+    {
+        glBindVertexArray(m_VAO);
+    }
+
+    void bindPositions() const
+    {
+        glBindVertexArray(m_PositionVAO);
+    }
+
+    // Draw every instance of a shape with the bound vertex array
+    void drawShape(size_t shape) const
+    {
+        glDrawElementsInstancedBaseVertexBaseInstance(GL_TRIANGLES, GLsizei(m_IndexCountPerShape[shape]), m_IndexTypePerShape[shape],
+            (const GLvoid *) m_IndexByteOffsetPerShape[shape], m_InstanceCountPerShape[shape], m_BaseVertexPerShape[shape], m_FirstInstancePerShape[shape]);
+    }
+
+    size_t shapeCount() const
+    {
+        return m_IndexCountPerShape.size();
+    }
+
+    bool hasSeparateVertexStreams() const
+    {
+        return m_bSeparateStreams;
+    }
+
+    // Bytes of the vertex, index and instance buffers
+    size_t byteSize() const
+    {
+        return m_nByteSize;
+    }
+
+private:
+    void release();
+
+    static const size_t BufferCount = 6; // Interleaved vertices or positions, normals, texture coordinates, tangents, indices, instance matrices
+
+    GLuint m_VAO = 0;
+    GLuint m_PositionVAO = 0;
+    GLuint m_Buffers[BufferCount] = { 0 };
+    bool m_bSeparateStreams = false;
+    size_t m_nByteSize = 0;
+
+    std::vector<size_t> m_IndexByteOffsetPerShape;
+    std::vector<uint32_t> m_IndexCountPerShape;
+    std::vector<GLenum> m_IndexTypePerShape;
+    std::vector<GLint> m_BaseVertexPerShape;
+    std::vector<GLsizei> m_InstanceCountPerShape;
+    std::vector<GLuint> m_FirstInstancePerShape; // In the instance buffer
+};
+
+// Textures of data, from their block compressed version when there is one. Textures used as Ka, Kd or Ks are sRGB colors.
+// Unused and empty textures are empty GLTexture2D objects, so that the texture ids of the materials stay valid.
+std::vector<GLTexture2D> uploadSceneTextures(const SceneData & data);
+
+// GPU resident scenes: once uploaded with GLSceneGeometry and uploadSceneTextures, free the vertices, tangents, indices and
+// images of data, keeping its bounds, shapes, matrices, instances and materials. With keepPositions, the positions stay in
+// data.positionBuffer and the indices in data.indexBuffer, e.g. for picking. The scene can then no longer be uploaded nor modified.
+void releaseUploadedSceneData(SceneData & data, bool keepPositions = false);
+
+}
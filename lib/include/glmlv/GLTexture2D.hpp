@@ -0,0 +1,132 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glmlv/filesystem.hpp>
+#include <glmlv/Image2DRGBA.hpp>
+#include <glmlv/CompressedImage2D.hpp>
+#include <glmlv/TextureContainer.hpp>
+
+namespace glmlv
+{
+
+// Number of levels of a complete mip chain for a width x height texture
+GLsizei computeMipLevelCount(GLsizei width, GLsizei height);
+
+// Sized internal format for 8 bits per component pixels of the given format (GL_RED, GL_RG, GL_RGB or GL_RGBA)
+// sRGB is only honored for GL_RGB and GL_RGBA, there is no sized sRGB format for one or two components
+GLenum chooseInternalFormat(GLenum format, bool sRGB);
+
+// Sized internal format keeping the components of an image format: R8 images are uploaded as GL_R8, RGBA16F as GL_RGBA16F, ...
+// sRGB is only honored for RGB8 and RGBA8
+GLenum chooseInternalFormat(ImageFormat format, bool sRGB);
+
+// Pixel format and type to give to glTexSubImage2D for the texels of an image format
+GLenum getGLPixelFormat(ImageFormat format);
+GLenum getGLPixelType(ImageFormat format);
+
+// Number of bytes of video memory required by a texture, summed over its levels
+size_t computeTextureByteSize(GLenum internalFormat, GLsizei width, GLsizei height, GLsizei levelCount);
+
+// True if the current context exposes GL_EXT_texture_compression_s3tc (BC1 and BC3 formats).
+// BC4/BC5 (RGTC) and ETC2/EAC are always available with an OpenGL 4.3+ context.
+bool isS3TCSupported();
+
+class GLTexture2D
+{
+public:
+    GLTexture2D() = default;
+
+    // Allocate an immutable texture without initial content (render targets, shadow maps, ...)
+    GLTexture2D(GLenum internalFormat, GLsizei width, GLsizei height, GLsizei levelCount = 1);
+
+    // Upload 8 bits per component pixels in a texture with a complete mip chain, generated on the GPU
+    GLTexture2D(GLsizei width, GLsizei height, GLenum format, const void * pixels, bool sRGB);
+
+    // Upload pixels of any type in a texture with a complete mip chain, generated on the GPU
+    GLTexture2D(GLsizei width, GLsizei height, GLenum internalFormat, GLenum format, GLenum type, const void * pixels);
+
+    // Set sRGB to true for color textures (diffuse, ambient, ...), false for data textures (normals, roughness, ...)
+    // The texture has the components of the image, a one channel image is not expanded to RGBA.
+    // One and two channels color textures are swizzled to sample as gray (RRR1) and gray with alpha (RRRG).
+    template<ImageFormat F>
+    explicit GLTexture2D(const Image2D<F> & image, bool sRGB = false):
+        GLTexture2D(GLsizei(image.width()), GLsizei(image.height()), chooseInternalFormat(F, sRGB), getGLPixelFormat(F), getGLPixelType(F), image.data())
+    {
+        if (sRGB) {
+            setGraySwizzle();
+        }
+    }
+
+    explicit GLTexture2D(const AnyImage2D & image, bool sRGB = false);
+
+    // Keep the channels of the file, see readAnyImage
+    explicit GLTexture2D(const fs::path & path, bool sRGB = false);
+
+    // Upload all the levels of a mip chain computed on the CPU, no mip generation is done by the GPU
+    explicit GLTexture2D(const Image2DRGBAMipChain & mipChain, bool sRGB = false);
+
+    // Upload all the levels of a block compressed image as is, the color space is part of its format
+    explicit GLTexture2D(const CompressedImage2D & image);
+
+    // Upload all the levels of a layer of a KTX2/DDS container directly from its mapped file
+    explicit GLTexture2D(const TextureContainer & container, size_t layer = 0);
+
+    ~GLTexture2D();
+
+    GLTexture2D(const GLTexture2D&) = delete;
+    GLTexture2D& operator =(const GLTexture2D&) = delete;
+
+    GLTexture2D(GLTexture2D&& rvalue);
+    GLTexture2D& operator =(GLTexture2D&& rvalue);
+
+    GLuint glId() const
+    {
+        return m_GLId;
+    }
+
+    void bind() const
+    {
+        glBindTexture(GL_TEXTURE_2D, m_GLId);
+    }
+
+    GLenum internalFormat() const
+    {
+        return m_InternalFormat;
+    }
+
+    GLsizei width() const
+    {
+        return m_nWidth;
+    }
+
+    GLsizei height() const
+    {
+        return m_nHeight;
+    }
+
+    GLsizei levelCount() const
+    {
+        return m_nLevelCount;
+    }
+
+    size_t byteSize() const
+    {
+        return computeTextureByteSize(m_InternalFormat, m_nWidth, m_nHeight, m_nLevelCount);
+    }
+
+    // For color textures with one or two channels, including BC4/BC5 and EAC: sample them as gray (RRR1) or gray with alpha (RRRG).
+    // Other formats are left as is.
+    void setGraySwizzle();
+
+private:
+    void allocate(GLenum internalFormat, GLsizei width, GLsizei height, GLsizei levelCount);
+    void release();
+
+    GLuint m_GLId = 0;
+    GLenum m_InternalFormat = GL_NONE;
+    GLsizei m_nWidth = 0;
+    GLsizei m_nHeight = 0;
+    GLsizei m_nLevelCount = 0;
+};
+
+}
@@ -0,0 +1,240 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <glmlv/filesystem.hpp>
+
+namespace glmlv
+{
+
+enum class ImageFormat
+{
+    R8,
+    RG8,
+    RGB8,
+    RGBA8,
+    R16F, // Half floats, stored as their 16 bits pattern
+    RGBA16F,
+    RGBA32F // HDR images (.hdr files)
+};
+
+template<ImageFormat Format> struct ImageFormatTraits;
+
+template<> struct ImageFormatTraits<ImageFormat::R8> { using ComponentType = unsigned char; static const size_t NumComponents = 1; };
+template<> struct ImageFormatTraits<ImageFormat::RG8> { using ComponentType = unsigned char; static const size_t NumComponents = 2; };
+template<> struct ImageFormatTraits<ImageFormat::RGB8> { using ComponentType = unsigned char; static const size_t NumComponents = 3; };
+template<> struct ImageFormatTraits<ImageFormat::RGBA8> { using ComponentType = unsigned char; static const size_t NumComponents = 4; };
+template<> struct ImageFormatTraits<ImageFormat::R16F> { using ComponentType = uint16_t; static const size_t NumComponents = 1; };
+template<> struct ImageFormatTraits<ImageFormat::RGBA16F> { using ComponentType = uint16_t; static const size_t NumComponents = 4; };
+template<> struct ImageFormatTraits<ImageFormat::RGBA32F> { using ComponentType = float; static const size_t NumComponents = 4; };
+
+size_t getComponentCount(ImageFormat format);
+
+size_t getTexelByteSize(ImageFormat format);
+
+// Pixels are allocated with stb_image's allocator, so that images read from files and created in memory are released the same way
+struct ImageDataDeleter
+{
+    void operator ()(void * ptr) const;
+};
+
+class AnyImage2D;
+
+template<ImageFormat F> class Image2D;
+
+template<ImageFormat Format = ImageFormat::RGBA8>
+Image2D<Format> readImage(const fs::path& path);
+
+// Image whose texels are NumComponents consecutive components of type ComponentType, rows stored from top to bottom
+template<ImageFormat F>
+class Image2D
+{
+public:
+    using ComponentType = typename ImageFormatTraits<F>::ComponentType;
+    static const ImageFormat Format = F;
+    static const size_t NumComponents = ImageFormatTraits<F>::NumComponents;
+
+    Image2D() = default;
+
+    Image2D(size_t width, size_t height);
+
+    // Fill the image with a texel, components beyond NumComponents are ignored
+    Image2D(size_t width, size_t height, ComponentType r, ComponentType g = 0, ComponentType b = 0, ComponentType a = 0);
+
+    Image2D(const Image2D&) = delete;
+    Image2D& operator =(const Image2D&) = delete;
+
+    Image2D(Image2D&&) = default;
+    Image2D& operator =(Image2D&&) = default;
+
+    size_t width() const
+    {
+        return m_nWidth;
+    }
+
+    size_t height() const
+    {
+        return m_nHeight;
+    }
+
+    size_t size() const
+    {
+        return width() * height();
+    }
+
+    size_t byteSize() const
+    {
+        return size() * NumComponents * sizeof(ComponentType);
+    }
+
+    const ComponentType * data() const
+    {
+        return m_pData.get();
+    }
+
+    ComponentType * data()
+    {
+        return m_pData.get();
+    }
+
+    const ComponentType * operator ()(size_t x, size_t y) const
+    {
+        return m_pData.get() + (x + y * m_nWidth) * NumComponents;
+    }
+
+    ComponentType * operator ()(size_t x, size_t y)
+    {
+        return const_cast<ComponentType*>(static_cast<const Image2D&>(*this)(x, y));
+    }
+
+    void flipY(); // Flip the image along its y axis
+
+private:
+    template<ImageFormat G> friend Image2D<G> readImage(const fs::path& path);
+    friend class AnyImage2D;
+
+    std::unique_ptr<ComponentType[], ImageDataDeleter> m_pData;
+    size_t m_nWidth = 0;
+    size_t m_nHeight = 0;
+};
+
+template<ImageFormat F> const ImageFormat Image2D<F>::Format;
+template<ImageFormat F> const size_t Image2D<F>::NumComponents;
+
+extern template class Image2D<ImageFormat::R8>;
+extern template class Image2D<ImageFormat::RG8>;
+extern template class Image2D<ImageFormat::RGB8>;
+extern template class Image2D<ImageFormat::RGBA8>;
+extern template class Image2D<ImageFormat::R16F>;
+extern template class Image2D<ImageFormat::RGBA16F>;
+extern template class Image2D<ImageFormat::RGBA32F>;
+
+// Image whose format is only known at runtime, e.g. loaded with readAnyImage.
+class AnyImage2D
+{
+public:
+    AnyImage2D() = default;
+
+    // Take ownership of the pixels of image
+    template<ImageFormat F>
+    AnyImage2D(Image2D<F> && image):
+        m_Format(F), m_pData(reinterpret_cast<unsigned char*>(image.m_pData.release())), m_nWidth(image.m_nWidth), m_nHeight(image.m_nHeight)
+    {
+        image.m_nWidth = image.m_nHeight = 0;
+    }
+
+    AnyImage2D(const AnyImage2D&) = delete;
+    AnyImage2D& operator =(const AnyImage2D&) = delete;
+
+    AnyImage2D(AnyImage2D&&) = default;
+    AnyImage2D& operator =(AnyImage2D&&) = default;
+
+    ImageFormat format() const
+    {
+        return m_Format;
+    }
+
+    size_t width() const
+    {
+        return m_nWidth;
+    }
+
+    size_t height() const
+    {
+        return m_nHeight;
+    }
+
+    size_t size() const
+    {
+        return width() * height();
+    }
+
+    size_t componentCount() const
+    {
+        return getComponentCount(m_Format);
+    }
+
+    size_t byteSize() const
+    {
+        return size() * getTexelByteSize(m_Format);
+    }
+
+    const unsigned char * data() const
+    {
+        return m_pData.get();
+    }
+
+    unsigned char * data()
+    {
+        return m_pData.get();
+    }
+
+    // Typed access to the texels, nullptr if the image has another format
+    template<ImageFormat F>
+    const typename ImageFormatTraits<F>::ComponentType * dataAs() const
+    {
+        return m_Format == F ? reinterpret_cast<const typename ImageFormatTraits<F>::ComponentType *>(m_pData.get()) : nullptr;
+    }
+
+    void flipY();
+
+    // Copy of the image in its own format
+    AnyImage2D clone() const;
+
+    // Copy of the image with 4 components of 8 bits. Gray (one component) and gray with alpha (two components) images are
+    // replicated to RGB, missing components are set to 0 (alpha to 255) and float components are clamped to [0, 1].
+    Image2D<ImageFormat::RGBA8> toRGBA8() const;
+
+private:
+    ImageFormat m_Format = ImageFormat::RGBA8;
+    std::unique_ptr<unsigned char[], ImageDataDeleter> m_pData;
+    size_t m_nWidth = 0;
+    size_t m_nHeight = 0;
+};
+
+// Supported formats for reading are:
+////    JPEG baseline & progressive(12 bpc / arithmetic not supported, same as stock IJG lib)
+////    PNG 1 / 2 / 4 / 8 - bit - per - channel(16 bpc not supported)
+////
+////    TGA(not sure what subset, if a subset)
+////    BMP non - 1bpp, non - RLE
+////    PSD(composited view only, no extra channels, 8 / 16 bit - per - channel)
+////
+////    GIF(*comp always reports as 4 - channel)
+////    HDR(radiance rgbE format)
+////    PIC(Softimage PIC)
+////    PNM(PPM and PGM binary only)
+// The file is converted to Format, whatever its number of channels.
+template<ImageFormat Format>
+Image2D<Format> readImage(const fs::path& path);
+
+// Keep the channels of the file: R8, RG8, RGB8 or RGBA8 for LDR files, RGBA32F for HDR files
+AnyImage2D readAnyImage(const fs::path& path);
+
+// Supported formats for writing are png, bmp and tga for 8 bits images, hdr for RGBA32F images
+template<ImageFormat Format>
+void writeImage(const Image2D<Format>& image, const fs::path& path);
+
+void writeImage(const AnyImage2D& image, const fs::path& path);
+
+}
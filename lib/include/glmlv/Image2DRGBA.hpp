@@ -1,93 +1,92 @@
 #pragma once
 
+#include <algorithm>
 #include <memory>
+#include <vector>
 #include <glmlv/filesystem.hpp>
+#include <glmlv/Image2D.hpp>
 
 namespace glmlv
 {
 
-class Image2DRGBA
+// Historical name of 8 bits RGBA images, most of the library works on this format
+using Image2DRGBA = Image2D<ImageFormat::RGBA8>;
+
+enum class ColorSpace
 {
-public:
-    static const size_t NumComponents = 4;
+    Linear, // Data textures (normal maps, roughness, ...), filtered as is
+    sRGB // Color textures, RGB components are filtered in linear space then encoded back to sRGB. Alpha is always linear.
+};
+
+enum class MipFilter
+{
+    Box, // 2x2 average, fastest
+    Kaiser // Kaiser windowed sinc, sharper mips with less aliasing
+};
 
-    Image2DRGBA() = default;
+// All the levels of a mip pyramid, stored from the largest to the smallest in a single allocation
+class Image2DRGBAMipChain
+{
+public:
+    static const size_t NumComponents = Image2DRGBA::NumComponents;
 
-    Image2DRGBA(size_t width, size_t height);
+    Image2DRGBAMipChain() = default;
 
-    Image2DRGBA(size_t width, size_t height, unsigned char r, unsigned char g, unsigned char b, unsigned char a);
+    // Allocate the complete mip chain of a width x height image
+    Image2DRGBAMipChain(size_t width, size_t height);
 
-    Image2DRGBA(const Image2DRGBA&) = delete;
-    Image2DRGBA& operator =(const Image2DRGBA&) = delete;
+    Image2DRGBAMipChain(const Image2DRGBAMipChain&) = delete;
+    Image2DRGBAMipChain& operator =(const Image2DRGBAMipChain&) = delete;
 
-    Image2DRGBA(Image2DRGBA&&) = default;
-    Image2DRGBA& operator =(Image2DRGBA&&) = default;
+    Image2DRGBAMipChain(Image2DRGBAMipChain&&) = default;
+    Image2DRGBAMipChain& operator =(Image2DRGBAMipChain&&) = default;
 
-    size_t width() const
+    size_t levelCount() const
     {
-        return m_nWidth;
+        return m_LevelOffsets.size();
     }
 
-    size_t height() const
+    size_t width(size_t level = 0) const
     {
-        return m_nHeight;
+        return std::max(size_t(1), m_nWidth >> level);
     }
 
-    size_t size() const
+    size_t height(size_t level = 0) const
     {
-        return width() * height();
+        return std::max(size_t(1), m_nHeight >> level);
     }
 
-    const unsigned char * data() const
+    // Size in bytes of a level, or of the whole chain
+    size_t byteSize(size_t level) const
     {
-        return m_pData.get();
+        return width(level) * height(level) * NumComponents;
     }
 
-    unsigned char * data()
+    size_t byteSize() const
     {
-        return m_pData.get();
+        return m_nByteSize;
     }
 
-    const unsigned char * operator ()(size_t x, size_t y) const
+    const unsigned char * data(size_t level = 0) const
     {
-        return m_pData.get() + (x + y * m_nWidth) * NumComponents;
+        return m_pData.get() + m_LevelOffsets[level];
     }
 
-    unsigned char * operator ()(size_t x, size_t y)
+    unsigned char * data(size_t level = 0)
     {
-        return const_cast<unsigned char*>((*this)(x, y));
+        return m_pData.get() + m_LevelOffsets[level];
     }
 
-    void flipY(); // Flip the image along its y axis
-
 private:
-    friend Image2DRGBA readImage(const fs::path& path);
-
-    struct Deleter
-    {
-        void operator ()(unsigned char *) const;
-    };
-
-    std::unique_ptr<unsigned char[], Deleter> m_pData;
+    std::unique_ptr<unsigned char[]> m_pData;
+    std::vector<size_t> m_LevelOffsets;
+    size_t m_nByteSize = 0;
     size_t m_nWidth = 0;
     size_t m_nHeight = 0;
 };
 
-// Supported formats for reading are:
-////    JPEG baseline & progressive(12 bpc / arithmetic not supported, same as stock IJG lib)
-////    PNG 1 / 2 / 4 / 8 - bit - per - channel(16 bpc not supported)
-////    
-////    TGA(not sure what subset, if a subset)
-////    BMP non - 1bpp, non - RLE
-////    PSD(composited view only, no extra channels, 8 / 16 bit - per - channel)
-////    
-////    GIF(*comp always reports as 4 - channel)
-////    HDR(radiance rgbE format)
-////    PIC(Softimage PIC)
-////    PNM(PPM and PGM binary only)
-Image2DRGBA readImage(const fs::path& path);
-
-// Supported formats for writing are png, bmp and tga
-void writeImage(const Image2DRGBA& image, const fs::path& path);
+// Compute all the levels of the mip pyramid of an image on the CPU, level 0 being a copy of the image.
+// Rows of each level are filtered in parallel.
+Image2DRGBAMipChain generateMipChain(const Image2DRGBA & image, ColorSpace colorSpace, MipFilter filter = MipFilter::Box);
 
 }
\ No newline at end of file
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstddef>
+#include <glmlv/filesystem.hpp>
+
+namespace glmlv
+{
+
+// Read-only memory mapping of a whole file. Pages are loaded by the OS on first access, nothing is copied.
+class MappedFile
+{
+public:
+    MappedFile() = default;
+
+    explicit MappedFile(const fs::path & path);
+
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator =(const MappedFile&) = delete;
+
+    MappedFile(MappedFile&& rvalue);
+    MappedFile& operator =(MappedFile&& rvalue);
+
+    const unsigned char * data() const
+    {
+        return m_pData;
+    }
+
+    size_t size() const
+    {
+        return m_nSize;
+    }
+
+private:
+    void release();
+
+    const unsigned char * m_pData = nullptr;
+    size_t m_nSize = 0;
+#ifdef _WIN32
+    void * m_FileHandle = nullptr;
+    void * m_MappingHandle = nullptr;
+#endif
+};
+
+}
@@ -0,0 +1,144 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+#include <glad/glad.h>
+#include <glmlv/filesystem.hpp>
+#include <glmlv/MappedFile.hpp>
+#include <glmlv/Image2DRGBA.hpp>
+#include <glmlv/CompressedImage2D.hpp>
+
+namespace glmlv
+{
+
+// Order of the rows of an image in memory. Images read by readImage are top down, OpenGL expects bottom up
+// (scene loaders flip their textures accordingly).
+enum class RowOrder
+{
+    TopDown,
+    BottomUp
+};
+
+// One level of one layer of a texture container, pointing in the container storage
+struct TextureSpan
+{
+    const unsigned char * data = nullptr;
+    size_t byteSize = 0;
+    size_t width = 0;
+    size_t height = 0;
+};
+
+// Pre-mipped texture read from a KTX2 or DDS file. The file is memory mapped and levels are exposed
+// without any copy, ready to be given to glCompressedTexSubImage2D or glTexSubImage2D.
+// Supported formats are the CompressedFormat ones, and 8 bits R, RG, RGBA, BGRA, 16 bits float R, RGBA and 32 bits float RGBA.
+class TextureContainer
+{
+public:
+    TextureContainer() = default;
+
+    bool isCompressed() const
+    {
+        return m_bIsCompressed;
+    }
+
+    // Only meaningful for compressed containers
+    CompressedFormat compressedFormat() const
+    {
+        return m_CompressedFormat;
+    }
+
+    GLenum internalFormat() const
+    {
+        return m_InternalFormat;
+    }
+
+    // Pixel format and type to give to glTexSubImage2D, only meaningful for uncompressed containers
+    GLenum pixelFormat() const
+    {
+        return m_PixelFormat;
+    }
+
+    GLenum pixelType() const
+    {
+        return m_PixelType;
+    }
+
+    RowOrder rowOrder() const
+    {
+        return m_RowOrder;
+    }
+
+    size_t width(size_t level = 0) const
+    {
+        return std::max(size_t(1), m_nWidth >> level);
+    }
+
+    size_t height(size_t level = 0) const
+    {
+        return std::max(size_t(1), m_nHeight >> level);
+    }
+
+    size_t levelCount() const
+    {
+        return m_nLevelCount;
+    }
+
+    // Array layers, cube map faces are counted as layers
+    size_t layerCount() const
+    {
+        return m_nLayerCount;
+    }
+
+    TextureSpan level(size_t level, size_t layer = 0) const
+    {
+        const auto index = level * m_nLayerCount + layer;
+        return { m_pFile->data() + m_LevelOffsets[index], m_LevelByteSizes[level], width(level), height(level) };
+    }
+
+    // Mip chain of a layer of a compressed container, referencing the mapped file
+    CompressedImage2D compressedImage(size_t layer = 0) const;
+
+private:
+    friend TextureContainer readKTX2(const fs::path & path);
+    friend TextureContainer readDDS(const fs::path & path);
+
+    std::shared_ptr<const MappedFile> m_pFile;
+    bool m_bIsCompressed = false;
+    CompressedFormat m_CompressedFormat = CompressedFormat::BC1_RGB;
+    GLenum m_InternalFormat = GL_NONE;
+    GLenum m_PixelFormat = GL_NONE;
+    GLenum m_PixelType = GL_NONE;
+    RowOrder m_RowOrder = RowOrder::TopDown;
+    size_t m_nWidth = 0;
+    size_t m_nHeight = 0;
+    size_t m_nLevelCount = 0;
+    size_t m_nLayerCount = 0;
+    std::vector<size_t> m_LevelOffsets; // Offset in the file of each (level, layer), indexed by level * layerCount + layer
+    std::vector<size_t> m_LevelByteSizes; // Byte size of one layer of each level
+};
+
+// Supercompressed (Basis Universal, zstd) KTX2 files and 3D textures are not supported
+TextureContainer readKTX2(const fs::path & path);
+
+// Legacy DDS (DXT1, DXT5, ATI1, ATI2, 32 bits RGB masks) and DX10 extended header files
+TextureContainer readDDS(const fs::path & path);
+
+// Choose the reader from the extension (.ktx2 or .dds)
+TextureContainer readTextureContainer(const fs::path & path);
+
+// True for the extensions handled by readTextureContainer
+bool isTextureContainerPath(const fs::path & path);
+
+// KTX2 files store the row order in their KTXorientation metadata. The color space of compressed images is given by their format.
+void writeKTX2(const CompressedImage2D & image, const fs::path & path, RowOrder rowOrder = RowOrder::TopDown);
+void writeKTX2(const Image2DRGBAMipChain & mipChain, ColorSpace colorSpace, const fs::path & path, RowOrder rowOrder = RowOrder::TopDown);
+
+// DDS files are always top down. ETC2/EAC formats cannot be stored in DDS.
+void writeDDS(const CompressedImage2D & image, const fs::path & path);
+void writeDDS(const Image2DRGBAMipChain & mipChain, ColorSpace colorSpace, const fs::path & path);
+
+// Reverse the rows of a compressed image, by reordering the blocks and the texels inside each block.
+// Only BC1, BC3, BC4 and BC5 with levels heights multiple of 4 (or smaller than 4) can be flipped; returns an empty image otherwise.
+CompressedImage2D flipY(const CompressedImage2D & image);
+
+}
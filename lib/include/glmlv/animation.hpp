@@ -0,0 +1,108 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <glmlv/gltf_loading.hpp>
+
+namespace glmlv
+{
+
+enum class AnimationPath
+{
+    Translation,
+    Rotation,
+    Scale,
+    Weights // Morph target weights
+};
+
+enum class AnimationInterpolation
+{
+    Step,
+    Linear, // Spherical for rotations
+    CubicSpline // Hermite spline, keys store an in tangent, a value and an out tangent
+};
+
+// Keyframed animation of node properties, one channel per animated property.
+// Keyframes are stored as a structure of arrays: the times of all samplers in one array and their values in another,
+// each value padded to a multiple of 4 floats so that interpolation works on 4 components at once.
+class AnimationClip
+{
+public:
+    std::string name;
+
+    float duration() const
+    {
+        return m_fDuration;
+    }
+
+    size_t channelCount() const
+    {
+        return m_Channels.size();
+    }
+
+    int channelNode(size_t channel) const
+    {
+        return m_Channels[channel].node;
+    }
+
+    AnimationPath channelPath(size_t channel) const
+    {
+        return m_Channels[channel].path;
+    }
+
+    // Meaningful floats of the channel in the output of sample(): 3 for translations and scales, 4 for rotations (x, y, z, w),
+    // the number of morph targets for weights
+    size_t channelComponentCount(size_t channel) const
+    {
+        return m_Samplers[m_Channels[channel].sampler].componentCount;
+    }
+
+    // Offset of the channel in the output of sample(), a multiple of 4
+    size_t channelOutputOffset(size_t channel) const
+    {
+        return m_Channels[channel].outputOffset;
+    }
+
+    // Number of floats written by sample()
+    size_t outputSize() const
+    {
+        return m_nOutputSize;
+    }
+
+    // Evaluate every channel at time, clamped to the keys of its sampler. output must hold outputSize() floats.
+    void sample(float time, float * output) const;
+
+private:
+    friend std::vector<AnimationClip> loadGltfAnimations(const GltfDocument & document);
+
+    struct Sampler
+    {
+        AnimationInterpolation interpolation = AnimationInterpolation::Linear;
+        size_t keyOffset = 0; // In m_Times
+        size_t keyCount = 0;
+        size_t valueOffset = 0; // In m_Values
+        size_t componentCount = 0;
+        size_t laneCount = 0; // Groups of 4 floats per value
+    };
+
+    struct Channel
+    {
+        int node = -1;
+        AnimationPath path = AnimationPath::Translation;
+        size_t sampler = 0;
+        size_t outputOffset = 0;
+    };
+
+    std::vector<Sampler> m_Samplers;
+    std::vector<Channel> m_Channels;
+    std::vector<float> m_Times;
+    std::vector<float> m_Values;
+    size_t m_nOutputSize = 0;
+    float m_fDuration = 0.f;
+};
+
+// Read the animations of a glTF model, throw std::runtime_error on invalid samplers.
+// Channels targeting missing nodes and samplers with less than one key are skipped.
+std::vector<AnimationClip> loadGltfAnimations(const GltfDocument & document);
+
+}
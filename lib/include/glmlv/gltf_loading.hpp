@@ -0,0 +1,97 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+#include <tiny_gltf.h>
+#include <glmlv/filesystem.hpp>
+#include <glmlv/MappedFile.hpp>
+
+namespace glmlv
+{
+
+enum class GltfBufferMode
+{
+    Copy, // Buffers are read by tinygltf in model.buffers[i].data
+    Map // .bin files and the binary chunk of .glb files are memory mapped, model.buffers[i].data stays empty
+};
+
+enum class GltfImageMode
+{
+    Decode, // Images are decoded by tinygltf while loading, one after the other
+    Defer // Only the location of the encoded images is kept, call GltfDocument::decodeImage on the images actually needed
+};
+
+// Byte range [begin, end) of a buffer
+struct GltfByteRange
+{
+    size_t buffer = 0;
+    size_t begin = 0;
+    size_t end = 0;
+};
+
+// A glTF model and the storage of its buffers. Always access buffers through bufferData(), whatever the mode.
+class GltfDocument
+{
+public:
+    tinygltf::Model model;
+
+    size_t bufferCount() const
+    {
+        return m_Buffers.size();
+    }
+
+    const unsigned char * bufferData(size_t buffer) const
+    {
+        return m_Buffers[buffer].data;
+    }
+
+    size_t bufferByteSize(size_t buffer) const
+    {
+        return m_Buffers[buffer].byteSize;
+    }
+
+    // Decode a deferred image in model.images[image], does nothing if it is already decoded. Throw std::runtime_error on failure.
+    // Different images can be decoded concurrently from several threads.
+    void decodeImage(size_t image);
+
+    // Where the encoded bytes of a deferred image are: a file, a buffer view or a copy
+    struct EncodedImage
+    {
+        fs::path path;
+        GltfByteRange range;
+        std::vector<unsigned char> bytes;
+    };
+
+private:
+    friend GltfDocument loadGltf(const fs::path & path, GltfBufferMode bufferMode, GltfImageMode imageMode);
+
+    struct BufferSpan
+    {
+        const unsigned char * data = nullptr;
+        size_t byteSize = 0;
+    };
+
+    std::vector<BufferSpan> m_Buffers;
+    std::vector<std::shared_ptr<const MappedFile>> m_Files; // Mapped .glb and .bin files
+    std::vector<std::vector<unsigned char>> m_DecodedBuffers; // Buffers embedded as base64 data URIs and decoded meshopt fallback buffers
+    std::vector<EncodedImage> m_EncodedImages; // Empty if images are not deferred
+};
+
+// Load a .gltf or .glb file, throw std::runtime_error on failure.
+// In Map mode, images stored in buffer views are decoded from the mapping and base64 buffers are decoded without going through tinygltf.
+// Deferred images in Map mode are not even read, in Copy mode their encoded bytes are copied by tinygltf.
+// EXT_meshopt_compression buffer views are decoded in Map mode only, Copy mode needs files with uncompressed fallback buffers.
+GltfDocument loadGltf(const fs::path & path, GltfBufferMode bufferMode = GltfBufferMode::Map, GltfImageMode imageMode = GltfImageMode::Decode);
+
+// Bytes read by an accessor, from its first to its last element. Accessors without buffer view (sparse only) have an empty range.
+GltfByteRange getAccessorByteRange(const tinygltf::Model & model, int accessor);
+
+// Elements of an accessor converted to floats, one float per component. Normalized integers are mapped to [0, 1] or [-1, 1]
+// as glTF specifies, other integers are converted as is. Accessors without buffer view are zeros (sparse values are ignored).
+std::vector<float> readAccessorAsFloats(const GltfDocument & document, int accessor);
+
+// Sort the ranges by buffer and offset, and merge the ones that overlap once their begin is rounded down to alignment.
+// Aligned begins preserve the alignment of the data when the ranges are packed at aligned offsets.
+std::vector<GltfByteRange> mergeByteRanges(std::vector<GltfByteRange> ranges, size_t alignment);
+
+}
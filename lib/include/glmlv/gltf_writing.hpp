@@ -0,0 +1,15 @@
+#pragma once
+
+#include <glmlv/scene_loading.hpp>
+
+namespace glmlv
+{
+
+// Write data as a binary glTF file. Each shape becomes a node with its own mesh, whose vertices are packed in first use order
+// in a single interleaved buffer view (position, normal, texture coordinates) and whose indices use 16 bits when possible.
+// Instances of a shape are additional nodes referencing the same mesh. Tangents, when computed, are written in their own buffer view.
+// Diffuse and normal textures are written as png files next to path and referenced by the materials, Phong materials are approximated
+// with dielectric metallic roughness ones. Throw std::runtime_error on failure.
+void writeGlbScene(const SceneData & data, const fs::path & path);
+
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <glmlv/memory_registry.hpp>
+
+#include <imgui.h>
+
+#include <iostream>
+#include <stdexcept>
+
+namespace glmlv
+{
+
+// Collapsing header of the current ImGui window listing collectMemoryUsage(), with a button writing it as JSON to reportPath
+inline void imguiMemoryPanel(const fs::path & reportPath = "memory.json")
+{
+    if (!ImGui::CollapsingHeader("Memory")) {
+        return;
+    }
+    const auto usages = collectMemoryUsage();
+    const auto toMB = [](size_t byteSize) { return byteSize / (1024.f * 1024.f); };
+    ImGui::Text("CPU: %.2f MB, GPU: %.2f MB", toMB(computeTotalByteSize(usages, MemoryDomain::CPU)), toMB(computeTotalByteSize(usages, MemoryDomain::GPU)));
+    ImGui::Columns(4, "memoryUsages");
+    ImGui::Text("Domain"); ImGui::NextColumn();
+    ImGui::Text("Category"); ImGui::NextColumn();
+    ImGui::Text("MB"); ImGui::NextColumn();
+    ImGui::Text("Count"); ImGui::NextColumn();
+    ImGui::Separator();
+    for (const auto & usage : usages)
+    {
+        ImGui::Text(usage.domain == MemoryDomain::CPU ? "CPU" : "GPU"); ImGui::NextColumn();
+        ImGui::Text("%s", usage.category.c_str()); ImGui::NextColumn();
+        ImGui::Text("%.3f", toMB(usage.byteSize)); ImGui::NextColumn();
+        ImGui::Text("%zu", usage.count); ImGui::NextColumn();
+    }
+    ImGui::Columns(1);
+    if (ImGui::Button("Write JSON report"))
+    {
+        try
+        {
+            writeMemoryReport(usages, reportPath);
+            std::clog << "Memory report written to " << reportPath << std::endl;
+        }
+        catch (const std::exception &) // Already reported on std::cerr
+        {
+        }
+    }
+}
+
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <glmlv/scene_loading.hpp>
+
+namespace glmlv
+{
+
+// Indices of the shapes of a scene in a single element buffer. The indices of a shape are relative to its base vertex, the lowest
+// vertex it uses, and take 16 bits when its vertices span less than 65535 indices (0xFFFF is left for primitive restart).
+// Draw shape i with glDrawElementsBaseVertex(GL_TRIANGLES, indexCountPerShape[i], indexSizePerShape[i] == 2 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT,
+// (const GLvoid *) byteOffsetPerShape[i], baseVertexPerShape[i]).
+struct PackedIndexBuffer
+{
+    std::vector<uint8_t> data; // Index range of each shape, aligned to 4 bytes
+    std::vector<size_t> byteOffsetPerShape;
+    std::vector<uint32_t> indexCountPerShape;
+    std::vector<uint8_t> indexSizePerShape; // 2 or 4 bytes
+    std::vector<int32_t> baseVertexPerShape;
+};
+
+// Shapes are packed in parallel
+PackedIndexBuffer packIndexBuffer(const SceneData & data);
+
+}
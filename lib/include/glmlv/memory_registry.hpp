@@ -0,0 +1,74 @@
+#pragma once
+
+#include <glmlv/filesystem.hpp>
+
+#include <cstddef>
+#include <functional>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace glmlv
+{
+
+struct SceneData;
+
+enum class MemoryDomain
+{
+    CPU, // RAM
+    GPU // Video memory
+};
+
+struct MemoryUsage
+{
+    MemoryDomain domain = MemoryDomain::CPU;
+    std::string category; // e.g. "GLTexture2D/GL_RGBA32F", "Scene/vertexBuffer"
+    size_t byteSize = 0;
+    size_t count = 0; // Live objects or elements of the category
+};
+
+// Process wide counters of the memory used by the objects that track their allocations (GLTexture2D, GLSceneGeometry, ...), thread safe.
+// Each call to trackAllocation must be matched by a trackRelease with the same arguments.
+void trackAllocation(MemoryDomain domain, const std::string & category, size_t byteSize);
+void trackRelease(MemoryDomain domain, const std::string & category, size_t byteSize);
+
+// Report the memory of objects that do not track their allocations when the registry is queried, e.g. a SceneData:
+// MemorySource source("Scene", [&]() { return computeSceneMemoryUsage(data); });
+// The report function is registered until the MemorySource is destroyed, the object it reads must outlive it.
+class MemorySource
+{
+public:
+    MemorySource() = default;
+
+    MemorySource(std::string name, std::function<std::vector<MemoryUsage>()> report);
+
+    ~MemorySource();
+
+    MemorySource(const MemorySource&) = delete;
+    MemorySource& operator =(const MemorySource&) = delete;
+
+    MemorySource(MemorySource&& rvalue);
+    MemorySource& operator =(MemorySource&& rvalue);
+
+private:
+    void release();
+
+    size_t m_nId = 0;
+};
+
+// Tracked counters, then the usages reported by each source with its name prepended to their category, sorted by domain and category
+std::vector<MemoryUsage> collectMemoryUsage();
+
+size_t computeTotalByteSize(const std::vector<MemoryUsage> & usages, MemoryDomain domain);
+
+// CPU memory of the buffers of a scene, with its textures by format
+std::vector<MemoryUsage> computeSceneMemoryUsage(const SceneData & data);
+
+// JSON object { "cpuBytes": n, "gpuBytes": n, "usages": [ { "domain": "CPU" or "GPU", "category": ..., "bytes": n, "count": n }, ... ] }
+void writeMemoryReport(const std::vector<MemoryUsage> & usages, std::ostream & output);
+void writeMemoryReport(const std::vector<MemoryUsage> & usages, const fs::path & path);
+
+// Name of a GL internal format (GL_RGBA8, GL_DEPTH_COMPONENT32F, ...), its hexadecimal value if unknown
+std::string getGLInternalFormatName(unsigned int internalFormat);
+
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <glmlv/scene_loading.hpp>
+
+namespace glmlv
+{
+
+// Cluster of at most MaxMeshletVertices vertices and MaxMeshletTriangles triangles of a shape, with its bounds in the local space of the shape
+struct Meshlet
+{
+    uint32_t vertexOffset = 0; // In SceneMeshlets::vertices
+    uint32_t triangleOffset = 0; // In SceneMeshlets::triangles, in triangles
+    uint32_t vertexCount = 0;
+    uint32_t triangleCount = 0;
+
+    glm::vec3 center = glm::vec3(0); // Bounding sphere
+    float radius = 0.f;
+    glm::vec3 coneAxis = glm::vec3(0); // Normal cone: every triangle faces away from positions p with
+    float coneCutoff = 1.f; // dot(center - p, coneAxis) >= coneCutoff * length(center - p) + radius. 1 if the cone is too wide to cull anything.
+};
+
+const size_t MaxMeshletVertices = 64;
+const size_t MaxMeshletTriangles = 124;
+
+struct SceneMeshlets
+{
+    std::vector<Meshlet> meshlets;
+    std::vector<uint32_t> vertices; // Indices in SceneData::vertexBuffer
+    std::vector<uint8_t> triangles; // 3 indices in the vertices of its meshlet per triangle
+
+    // Meshlets of each shape of the SceneData they are built from
+    std::vector<uint32_t> meshletOffsetPerShape;
+    std::vector<uint32_t> meshletCountPerShape;
+};
+
+// Split the triangles of each shape in spatially coherent meshlets: triangles are added to the current meshlet by number of new
+// vertices then distance to its center, new meshlets start next to the previous one, or at the next triangle in Morton order.
+// Shapes are processed in parallel.
+SceneMeshlets buildMeshlets(const SceneData & data, size_t maxVertices = MaxMeshletVertices, size_t maxTriangles = MaxMeshletTriangles);
+
+// True if no triangle of the meshlet faces cameraPosition, given in the local space of the shape of the meshlet
+inline bool isMeshletBackfacing(const Meshlet & meshlet, const glm::vec3 & cameraPosition)
+{
+    const auto direction = meshlet.center - cameraPosition;
+    return glm::dot(direction, meshlet.coneAxis) >= meshlet.coneCutoff * glm::length(direction) + meshlet.radius;
+}
+
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+namespace glmlv
+{
+
+// How the data of an EXT_meshopt_compression buffer view is encoded
+enum class MeshoptMode
+{
+    Attributes, // Vertex codec: byte deltas between consecutive elements, for vertex attributes (byteStride multiple of 4)
+    Triangles, // Index codec: triangle list with edge and vertex caches, 2 or 4 bytes indices
+    Indices // Index sequence codec: delta encoded indices of any topology, 2 or 4 bytes indices
+};
+
+// Transform applied to attributes after decoding
+enum class MeshoptFilter
+{
+    None,
+    Octahedral, // Unit vectors encoded as octahedral 8 or 16 bits x, y, turned back to normalized x, y, z. The 4th component is kept.
+    Quaternion, // Unit quaternions encoded as 3 16 bits components and the index of the largest one, turned back to normalized x, y, z, w
+    Exponential // 32 bits floats encoded as a 24 bits mantissa and a 8 bits exponent
+};
+
+// Parse the mode and filter strings of the EXT_meshopt_compression extension, throw std::runtime_error on unknown values
+MeshoptMode parseMeshoptMode(const std::string & mode);
+MeshoptFilter parseMeshoptFilter(const std::string & filter);
+
+// Decode count elements of byteStride bytes from source into destination (count * byteStride bytes), then apply the filter.
+// Throw std::runtime_error if the data is malformed or the stride does not match the mode.
+void decodeMeshoptBuffer(unsigned char * destination, size_t count, size_t byteStride, const unsigned char * source, size_t sourceSize,
+    MeshoptMode mode, MeshoptFilter filter = MeshoptFilter::None);
+
+}
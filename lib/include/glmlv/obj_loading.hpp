@@ -0,0 +1,17 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <tiny_obj_loader.h>
+#include <glmlv/filesystem.hpp>
+
+namespace glmlv
+{
+
+// Parse an OBJ file into the structures of tinyobj::LoadObj (triangulated faces, per face material ids, same shape splitting on g, o and usemtl).
+// The file is memory mapped and split in chunks at line boundaries, parsed in parallel with a locale independent float parser.
+// Material files named by mtllib are read from mtlBaseDir with tinyobj::LoadMtl. Throw std::runtime_error if the file cannot be read.
+void loadObjFile(const fs::path & objPath, const fs::path & mtlBaseDir, tinyobj::attrib_t & attribs,
+    std::vector<tinyobj::shape_t> & shapes, std::vector<tinyobj::material_t> & materials);
+
+}
@@ -0,0 +1,174 @@
+#pragma once
+
+#include <algorithm>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+namespace glmlv
+{
+
+inline size_t getWorkerCount()
+{
+    const auto threadCount = std::thread::hardware_concurrency();
+    return threadCount ? threadCount : 4;
+}
+
+// Split [0, count) in contiguous chunks of at least minChunkSize elements and call f(begin, end) on each chunk from a different thread.
+// Returns when all chunks are processed, exceptions thrown by f are rethrown in the calling thread.
+template<typename Function>
+void parallelFor(size_t count, size_t minChunkSize, Function && f)
+{
+    const auto maxChunkCount = (count + std::max<size_t>(1, minChunkSize) - 1) / std::max<size_t>(1, minChunkSize);
+    const auto chunkCount = std::min(getWorkerCount(), maxChunkCount);
+    if (chunkCount <= 1) {
+        f(size_t(0), count);
+        return;
+    }
+
+    const auto chunkSize = (count + chunkCount - 1) / chunkCount;
+
+    std::vector<std::future<void>> futures;
+    for (size_t begin = chunkSize; begin < count; begin += chunkSize)
+    {
+        const auto end = std::min(count, begin + chunkSize);
+        futures.emplace_back(std::async(std::launch::async, [&f, begin, end]() { f(begin, end); }));
+    }
+
+    f(size_t(0), std::min(count, chunkSize)); // The calling thread processes the first chunk
+
+    for (auto & future : futures) {
+        future.get();
+    }
+}
+
+// Fixed set of worker threads running submitted tasks in submission order. Unlike parallelFor, the calling thread
+// is free to do other work (e.g. OpenGL calls) while the tasks run, and waits on the returned futures.
+class ThreadPool
+{
+public:
+    explicit ThreadPool(size_t threadCount = getWorkerCount())
+    {
+        for (size_t i = 0; i < std::max<size_t>(1, threadCount); ++i)
+        {
+            m_Threads.emplace_back([this]()
+            {
+                while (true)
+                {
+                    std::function<void()> task;
+                    {
+                        std::unique_lock<std::mutex> lock(m_Mutex);
+                        m_Condition.wait(lock, [this]() { return m_bStopping || !m_Tasks.empty(); });
+                        if (m_Tasks.empty()) {
+                            return;
+                        }
+                        task = std::move(m_Tasks.front());
+                        m_Tasks.pop();
+                    }
+                    task();
+                }
+            });
+        }
+    }
+
+    // Queued tasks are run before the threads are joined
+    ~ThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            m_bStopping = true;
+        }
+        m_Condition.notify_all();
+        for (auto & thread : m_Threads) {
+            thread.join();
+        }
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator =(const ThreadPool&) = delete;
+
+    size_t threadCount() const
+    {
+        return m_Threads.size();
+    }
+
+    // Exceptions thrown by f are rethrown by the get() of the returned future
+    template<typename Function>
+    auto submit(Function && f) -> std::future<decltype(f())>
+    {
+        const auto task = std::make_shared<std::packaged_task<decltype(f())()>>(std::forward<Function>(f));
+        auto future = task->get_future();
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            m_Tasks.emplace([task]() { (*task)(); });
+        }
+        m_Condition.notify_one();
+        return future;
+    }
+
+private:
+    std::vector<std::thread> m_Threads;
+    std::queue<std::function<void()>> m_Tasks;
+    std::mutex m_Mutex;
+    std::condition_variable m_Condition;
+    bool m_bStopping = false;
+};
+
+// Same as parallelFor, but the chunks run on the threads of pool instead of new threads: for work done every frame.
+// Must not be called from a task of pool.
+template<typename Function>
+void parallelFor(ThreadPool & pool, size_t count, size_t minChunkSize, Function && f)
+{
+    const auto maxChunkCount = (count + std::max<size_t>(1, minChunkSize) - 1) / std::max<size_t>(1, minChunkSize);
+    const auto chunkCount = std::min(pool.threadCount() + 1, maxChunkCount);
+    if (chunkCount <= 1) {
+        f(size_t(0), count);
+        return;
+    }
+
+    const auto chunkSize = (count + chunkCount - 1) / chunkCount;
+
+    // Unlike those of std::async, the futures of the pool do not wait when destroyed: every task referencing f
+    // must be finished before leaving, even when a chunk throws. The first exception is rethrown afterwards.
+    std::exception_ptr exception;
+    std::vector<std::future<void>> futures;
+    try
+    {
+        for (size_t begin = chunkSize; begin < count; begin += chunkSize)
+        {
+            const auto end = std::min(count, begin + chunkSize);
+            futures.emplace_back(pool.submit([&f, begin, end]() { f(begin, end); }));
+        }
+
+        f(size_t(0), std::min(count, chunkSize)); // The calling thread processes the first chunk
+    }
+    catch (...)
+    {
+        exception = std::current_exception();
+    }
+
+    for (auto & future : futures)
+    {
+        try
+        {
+            future.get();
+        }
+        catch (...)
+        {
+            if (!exception) {
+                exception = std::current_exception();
+            }
+        }
+    }
+    if (exception) {
+        std::rethrow_exception(exception);
+    }
+}
+
+}
@@ -2,6 +2,7 @@
 
 #include <glmlv/simple_geometry.hpp>
 #include <glmlv/Image2DRGBA.hpp>
+#include <glmlv/CompressedImage2D.hpp>
 #include <glmlv/filesystem.hpp>
 #include <glm/vec3.hpp>
 
@@ -23,6 +24,7 @@ namespace glmlv
             int32_t KdTextureId = -1;
             int32_t KsTextureId = -1;
             int32_t shininessTextureId = -1;
+            int32_t normalTextureId = -1; // Tangent space normal map, see tangentBuffer
         };
 
 		// Points min et max de la bounding box englobant la scene
@@ -30,15 +32,27 @@ namespace glmlv
         glm::vec3 bboxMax = glm::vec3(std::numeric_limits<float>::lowest());
 
         std::vector<Vertex3f3f2f> vertexBuffer; // Tableau de sommets
+        // Attributs des sommets en flux spars, remplis par splitVertexStreams qui vide alors vertexBuffer
+        std::vector<glm::vec3> positionBuffer;
+        std::vector<glm::vec3> normalBuffer;
+        std::vector<glm::vec2> texCoordsBuffer;
+        std::vector<glm::vec4> tangentBuffer; // Tangente de chaque sommet et signe de la bitangente en w, vide si computeTangents n'a pas t appele
         std::vector<uint32_t> indexBuffer; // Tableau d'index de sommets
 
 		size_t shapeCount = 0; // Nombre d'objets  dessiner
         std::vector<uint32_t> indexCountPerShape; // Nomber d'index de sommets pour chaque objet
 		std::vector<glm::mat4> localToWorldMatrixPerShape; // Matrice localToWorld de chaque objet
         std::vector<int32_t> materialIDPerShape; // Index du materiau de chaque objet (-1 si pas de materiaux)
+        // Nombre d'instances de chaque objet, vide si chaque objet n'est dessin qu'une fois (voir detectInstances).
+        // La premire instance utilise localToWorldMatrixPerShape, les matrices localToWorld des autres se suivent dans instanceMatrices.
+        std::vector<uint32_t> instanceCountPerShape;
+        std::vector<glm::mat4> instanceMatrices;
 
         std::vector<PhongMaterial> materials; // Tableau des materiaux
-        std::vector<Image2DRGBA> textures; // Tableau des textures rfrencs par les materiaux
+        std::vector<AnyImage2D> textures; // Tableau des textures rfrencs par les materiaux, avec les canaux du fichier
+        // Versions compresses des textures (mmes indices, vide si absente), remplies par compressSceneTextures ou par le chargement de conteneurs KTX2/DDS.
+        // Les textures charges depuis un conteneur compress n'existent que sous cette forme (image vide dans textures).
+        std::vector<CompressedImage2D> compressedTextures;
     };
 
 #ifdef GLMLV_USE_ASSIMP
@@ -50,11 +64,17 @@ namespace glmlv
     }
 #endif
 
-    void loadTinyObjScene(const fs::path & path, const fs::path & mtlBaseDir, SceneData & data, bool loadTextures = true);
+    enum class ObjParser
+    {
+        TinyObj, // tinyobj::LoadObj, reads the file line by line on one thread
+        Parallel // loadObjFile, memory maps the file and parses chunks of lines in parallel
+    };
 
-    inline void loadTinyObjScene(const fs::path & path, SceneData & data, bool loadTextures = true)
+    void loadTinyObjScene(const fs::path & path, const fs::path & mtlBaseDir, SceneData & data, bool loadTextures = true, ObjParser parser = ObjParser::Parallel);
+
+    inline void loadTinyObjScene(const fs::path & path, SceneData & data, bool loadTextures = true, ObjParser parser = ObjParser::Parallel)
     {
-        return loadTinyObjScene(path, path.parent_path(), data, loadTextures);
+        return loadTinyObjScene(path, path.parent_path(), data, loadTextures, parser);
     }
 
     inline void loadObjScene(const fs::path & path, const fs::path & mtlBaseDir, SceneData & data, bool loadTextures = true)
@@ -70,4 +90,23 @@ namespace glmlv
     {
         return loadObjScene(path, path.parent_path(), data, loadTextures);
     }
+
+    // Load a .gltf or .glb file: each triangle primitive of each node of the default scene becomes a shape with the world matrix of its node.
+    // Indices of any width are converted to 32 bits, base color textures are loaded once per image. Throw std::runtime_error on failure.
+    void loadGltfScene(const fs::path & path, SceneData & data, bool loadTextures = true);
+
+    // Load an OBJ or glTF scene depending on the extension of path
+    inline void loadScene(const fs::path & path, SceneData & data, bool loadTextures = true)
+    {
+        if (path.extension() == ".gltf" || path.extension() == ".glb") {
+            return loadGltfScene(path, data, loadTextures);
+        }
+        return loadObjScene(path, data, loadTextures);
+    }
+
+    // Fill data.compressedTextures with the block compressed mip chain of each texture.
+    // Textures used as Ka, Kd or Ks are compressed as sRGB color, shininess textures as single channel data.
+    // Normal maps keep their X and Y as two channels data (BC5 or EAC_RG11), Z is to be rebuilt as sqrt(1 - x - y) when sampling.
+    // Results are cached in cacheDirectory (typically next to the scene file), so that only the first load pays for the compression.
+    void compressSceneTextures(SceneData & data, const fs::path & cacheDirectory, bool useS3TC);
 }
\ No newline at end of file
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <glmlv/scene_loading.hpp>
+
+namespace glmlv
+{
+
+// Reorder the triangles of each shape of data.indexBuffer to improve post transform vertex cache hits (Forsyth's algorithm).
+// Shapes keep their index range, material and matrix, shapes are processed in parallel.
+void optimizeVertexCache(SceneData & data);
+
+// Reorder clusters of triangles of each shape so that triangles likely to occlude the others are drawn first, reducing the overdraw
+// within shapes. Clusters are cut in the current order: run it after optimizeVertexCache, the cache miss ratio of each cluster stays
+// below threshold times the one of the vertex cache optimized order. The cluster order is chosen against the views of
+// computeOverdrawRatio, a shape is left as is when no order improves it.
+void optimizeOverdraw(SceneData & data, float threshold = 1.05f);
+
+// Fragments passing the depth test per covered pixel when each shape is rasterized alone in draw order from the 6 axis directions,
+// back faces culled, 1 without overdraw
+float computeOverdrawRatio(const SceneData & data);
+
+// Merge the shapes sharing a material in a single shape with an identity matrix, to draw them with one call. Vertices of transformed
+// shapes are pre-transformed to world space. With gridCellSize > 0, triangles are also split by the cell of a world space grid
+// containing their centroid, so that merged shapes can still be culled. Shapes are ordered by material then cell.
+// Instanced shapes are kept as they are.
+void mergeShapesByMaterial(SceneData & data, float gridCellSize = 0.f);
+
+// Find the shapes with the same material and geometry up to a translation, a rotation and a uniform scale, with their vertices in the
+// same order. One copy of each is kept with the matrices of the others in data.instanceMatrices, the vertices of the others are removed.
+void detectInstances(SceneData & data);
+
+// Average number of vertex shader invocations per triangle with a FIFO cache of cacheSize vertices, 0.5 at best, 3 at worst
+float computeAverageCacheMissRatio(const SceneData & data, size_t cacheSize = 32);
+
+}
@@ -23,10 +23,33 @@ struct Vertex3f3f2f
     }
 };
 
+// Indices are stored on 16 bits in shortIndexBuffer when there are at most 65536 vertices, otherwise on 32 bits in intIndexBuffer.
+// Upload them with getIndexCount, getIndexSize and getIndexData, the other buffer is empty.
 struct SimpleGeometry
 {
     std::vector<Vertex3f3f2f> vertexBuffer;
-    std::vector<uint32_t> indexBuffer;
+    std::vector<uint16_t> shortIndexBuffer;
+    std::vector<uint32_t> intIndexBuffer;
+
+    SimpleGeometry() = default;
+
+    SimpleGeometry(std::vector<Vertex3f3f2f> vertices, const std::vector<uint32_t> & indices);
+
+    size_t getIndexCount() const
+    {
+        return intIndexBuffer.empty() ? shortIndexBuffer.size() : intIndexBuffer.size();
+    }
+
+    // In bytes, 2 for GL_UNSIGNED_SHORT, 4 for GL_UNSIGNED_INT
+    size_t getIndexSize() const
+    {
+        return intIndexBuffer.empty() ? sizeof(uint16_t) : sizeof(uint32_t);
+    }
+
+    const void * getIndexData() const
+    {
+        return intIndexBuffer.empty() ? static_cast<const void *>(shortIndexBuffer.data()) : static_cast<const void *>(intIndexBuffer.data());
+    }
 };
 
 SimpleGeometry makeTriangle();
@@ -0,0 +1,18 @@
+#pragma once
+
+#include <glmlv/scene_loading.hpp>
+
+namespace glmlv
+{
+
+// Replace the null normals of data.vertexBuffer by smooth normals: the angle weighted average of the normals of the triangles
+// around the vertex, vertices of a shape at the same position being welded so that texture seams stay smooth. Distinct shapes are
+// not welded together. Shapes are processed in parallel.
+void computeMissingNormals(SceneData & data);
+
+// Fill data.tangentBuffer with a tangent per vertex, following the conventions of MikkTSpace: angle weighted average of the
+// tangents of the triangles around the vertex, orthogonalized against its normal, w being the sign of the bitangent
+// (bitangent = w * cross(normal, tangent)). Vertices shared by triangles of opposite handedness are split. Shapes are processed in parallel.
+void computeTangents(SceneData & data);
+
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <glmlv/scene_loading.hpp>
+
+namespace glmlv
+{
+
+// Move the interleaved SceneData::vertexBuffer to positionBuffer, normalBuffer and texCoordsBuffer, so that passes reading only
+// positions (depth prepass, shadow maps, bounds) do not load normals and texture coordinates.
+// The loaders and the passes modifying the geometry (scene_optimization, tangent_space, buildMeshlets, writeGlbScene) work on
+// the interleaved layout: split the streams once the scene is ready to be drawn.
+void splitVertexStreams(SceneData & data);
+
+// Inverse of splitVertexStreams
+void interleaveVertexStreams(SceneData & data);
+
+inline bool hasSeparateVertexStreams(const SceneData & data)
+{
+    return data.vertexBuffer.empty() && !data.positionBuffer.empty()
+        && data.normalBuffer.size() == data.positionBuffer.size() && data.texCoordsBuffer.size() == data.positionBuffer.size();
+}
+
+// Also counts the positions kept by releaseUploadedSceneData
+inline size_t getVertexCount(const SceneData & data)
+{
+    return data.vertexBuffer.empty() ? data.positionBuffer.size() : data.vertexBuffer.size();
+}
+
+}
@@ -0,0 +1,278 @@
+#include <glmlv/GLSceneGeometry.hpp>
+#include <glmlv/index_packing.hpp>
+#include <glmlv/memory_registry.hpp>
+#include <glmlv/vertex_streams.hpp>
+
+#include <algorithm>
+#include <cstddef>
+#include <iostream>
+#include <numeric>
+#include <stdexcept>
+
+namespace glmlv
+{
+
+namespace
+{
+
+enum VertexAttrib
+{
+    PositionAttrib = 0,
+    NormalAttrib = 1,
+    TexCoordsAttrib = 2,
+    TangentAttrib = 3,
+    InstanceMatrixAttrib = 4 // To 7, one column per location
+};
+
+GLuint createBuffer(GLenum target, size_t byteSize, const void * data)
+{
+    GLuint buffer = 0;
+    glGenBuffers(1, &buffer);
+    glBindBuffer(target, buffer);
+    glBufferStorage(target, std::max(byteSize, size_t(1)), data, 0);
+    return buffer;
+}
+
+void setVertexAttrib(GLuint attrib, GLint size, GLsizei stride, size_t offset)
+{
+    glEnableVertexAttribArray(attrib);
+    glVertexAttribPointer(attrib, size, GL_FLOAT, GL_FALSE, stride, (const GLvoid *) offset);
+}
+
+void setInstanceMatrixAttrib(GLuint instanceBuffer)
+{
+    glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+    for (GLuint column = 0; column < 4; ++column)
+    {
+        setVertexAttrib(InstanceMatrixAttrib + column, 4, sizeof(glm::mat4), column * sizeof(glm::vec4));
+        glVertexAttribDivisor(InstanceMatrixAttrib + column, 1);
+    }
+}
+
+}
+
+GLSceneGeometry::GLSceneGeometry(const SceneData & data):
+    m_bSeparateStreams(glmlv::hasSeparateVertexStreams(data))
+{
+    const auto vertexCount = getVertexCount(data);
+    const auto indexCount = std::accumulate(begin(data.indexCountPerShape), end(data.indexCountPerShape), size_t(0));
+    if (indexCount && ((data.vertexBuffer.empty() && !m_bSeparateStreams) || data.indexBuffer.size() < indexCount))
+    {
+        std::cerr << "Unable to upload scene geometry: its vertices or indices have been released" << std::endl;
+        throw std::runtime_error("Unable to upload scene geometry: its vertices or indices have been released");
+    }
+    // Each shape has at least one instance, the matrices of the others follow each other in instanceMatrices
+    auto hasShapeWithoutInstance = false;
+    size_t extraInstanceCount = 0;
+    for (size_t shape = 0; shape < std::min(data.shapeCount, data.instanceCountPerShape.size()); ++shape)
+    {
+        hasShapeWithoutInstance |= !data.instanceCountPerShape[shape];
+        extraInstanceCount += std::max(data.instanceCountPerShape[shape], 1u) - 1;
+    }
+    if (hasShapeWithoutInstance || extraInstanceCount != data.instanceMatrices.size())
+    {
+        std::cerr << "Unable to upload scene geometry: its instance counts do not match its instance matrices" << std::endl;
+        throw std::runtime_error("Unable to upload scene geometry: its instance counts do not match its instance matrices");
+    }
+    const auto hasTangents = !data.tangentBuffer.empty() && data.tangentBuffer.size() == vertexCount;
+    if (m_bSeparateStreams)
+    {
+        m_Buffers[0] = createBuffer(GL_ARRAY_BUFFER, vertexCount * sizeof(glm::vec3), data.positionBuffer.data());
+        m_Buffers[1] = createBuffer(GL_ARRAY_BUFFER, vertexCount * sizeof(glm::vec3), data.normalBuffer.data());
+        m_Buffers[2] = createBuffer(GL_ARRAY_BUFFER, vertexCount * sizeof(glm::vec2), data.texCoordsBuffer.data());
+        m_nByteSize += vertexCount * (2 * sizeof(glm::vec3) + sizeof(glm::vec2));
+    }
+    else
+    {
+        m_Buffers[0] = createBuffer(GL_ARRAY_BUFFER, vertexCount * sizeof(Vertex3f3f2f), data.vertexBuffer.data());
+        m_nByteSize += vertexCount * sizeof(Vertex3f3f2f);
+    }
+    if (hasTangents)
+    {
+        m_Buffers[3] = createBuffer(GL_ARRAY_BUFFER, vertexCount * sizeof(glm::vec4), data.tangentBuffer.data());
+        m_nByteSize += vertexCount * sizeof(glm::vec4);
+    }
+
+    const auto packedIndices = packIndexBuffer(data);
+    m_Buffers[4] = createBuffer(GL_ELEMENT_ARRAY_BUFFER, packedIndices.data.size(), packedIndices.data.data());
+    m_nByteSize += packedIndices.data.size();
+    m_IndexByteOffsetPerShape = packedIndices.byteOffsetPerShape;
+    m_IndexCountPerShape = packedIndices.indexCountPerShape;
+    m_BaseVertexPerShape.assign(begin(packedIndices.baseVertexPerShape), end(packedIndices.baseVertexPerShape));
+    for (const auto indexSize : packedIndices.indexSizePerShape) {
+        m_IndexTypePerShape.push_back(indexSize == sizeof(uint16_t) ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT);
+    }
+
+    // The instances of each shape are contiguous, its own matrix first
+    std::vector<glm::mat4> instanceMatrices;
+    size_t extraInstanceOffset = 0;
+    for (size_t shape = 0; shape < data.shapeCount; ++shape)
+    {
+        const auto instanceCount = shape < data.instanceCountPerShape.size() ? data.instanceCountPerShape[shape] : 1;
+        m_FirstInstancePerShape.push_back(GLuint(instanceMatrices.size()));
+        m_InstanceCountPerShape.push_back(GLsizei(instanceCount));
+        instanceMatrices.push_back(shape < data.localToWorldMatrixPerShape.size() ? data.localToWorldMatrixPerShape[shape] : glm::mat4(1));
+        instanceMatrices.insert(end(instanceMatrices), begin(data.instanceMatrices) + extraInstanceOffset, begin(data.instanceMatrices) + extraInstanceOffset + instanceCount - 1);
+        extraInstanceOffset += instanceCount - 1;
+    }
+    m_Buffers[5] = createBuffer(GL_ARRAY_BUFFER, instanceMatrices.size() * sizeof(glm::mat4), instanceMatrices.data());
+    m_nByteSize += instanceMatrices.size() * sizeof(glm::mat4);
+
+    glGenVertexArrays(1, &m_VAO);
+    glBindVertexArray(m_VAO);
+    glBindBuffer(GL_ARRAY_BUFFER, m_Buffers[0]);
+    if (m_bSeparateStreams)
+    {
+        setVertexAttrib(PositionAttrib, 3, sizeof(glm::vec3), 0);
+        glBindBuffer(GL_ARRAY_BUFFER, m_Buffers[1]);
+        setVertexAttrib(NormalAttrib, 3, sizeof(glm::vec3), 0);
+        glBindBuffer(GL_ARRAY_BUFFER, m_Buffers[2]);
+        setVertexAttrib(TexCoordsAttrib, 2, sizeof(glm::vec2), 0);
+    }
+    else
+    {
+        setVertexAttrib(PositionAttrib, 3, sizeof(Vertex3f3f2f), offsetof(Vertex3f3f2f, position));
+        setVertexAttrib(NormalAttrib, 3, sizeof(Vertex3f3f2f), offsetof(Vertex3f3f2f, normal));
+        setVertexAttrib(TexCoordsAttrib, 2, sizeof(Vertex3f3f2f), offsetof(Vertex3f3f2f, texCoords));
+    }
+    if (hasTangents)
+    {
+        glBindBuffer(GL_ARRAY_BUFFER, m_Buffers[3]);
+        setVertexAttrib(TangentAttrib, 4, sizeof(glm::vec4), 0);
+    }
+    setInstanceMatrixAttrib(m_Buffers[5]);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_Buffers[4]);
+
+    glGenVertexArrays(1, &m_PositionVAO);
+    glBindVertexArray(m_PositionVAO);
+    glBindBuffer(GL_ARRAY_BUFFER, m_Buffers[0]);
+    if (m_bSeparateStreams) {
+        setVertexAttrib(PositionAttrib, 3, sizeof(glm::vec3), 0);
+    }
+    else {
+        setVertexAttrib(PositionAttrib, 3, sizeof(Vertex3f3f2f), offsetof(Vertex3f3f2f, position));
+    }
+    setInstanceMatrixAttrib(m_Buffers[5]);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_Buffers[4]);
+
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    trackAllocation(MemoryDomain::GPU, "GLSceneGeometry", m_nByteSize);
+}
+
+GLSceneGeometry::~GLSceneGeometry()
+{
+    release();
+}
+
+GLSceneGeometry::GLSceneGeometry(GLSceneGeometry&& rvalue):
+    m_VAO(rvalue.m_VAO), m_PositionVAO(rvalue.m_PositionVAO), m_bSeparateStreams(rvalue.m_bSeparateStreams), m_nByteSize(rvalue.m_nByteSize),
+    m_IndexByteOffsetPerShape(std::move(rvalue.m_IndexByteOffsetPerShape)), m_IndexCountPerShape(std::move(rvalue.m_IndexCountPerShape)),
+    m_IndexTypePerShape(std::move(rvalue.m_IndexTypePerShape)), m_BaseVertexPerShape(std::move(rvalue.m_BaseVertexPerShape)),
+    m_InstanceCountPerShape(std::move(rvalue.m_InstanceCountPerShape)), m_FirstInstancePerShape(std::move(rvalue.m_FirstInstancePerShape))
+{
+    std::copy(rvalue.m_Buffers, rvalue.m_Buffers + BufferCount, m_Buffers);
+    rvalue.m_VAO = rvalue.m_PositionVAO = 0;
+    std::fill(rvalue.m_Buffers, rvalue.m_Buffers + BufferCount, 0);
+}
+
+GLSceneGeometry& GLSceneGeometry::operator =(GLSceneGeometry&& rvalue)
+{
+    if (this != &rvalue)
+    {
+        release();
+        m_VAO = rvalue.m_VAO;
+        m_PositionVAO = rvalue.m_PositionVAO;
+        std::copy(rvalue.m_Buffers, rvalue.m_Buffers + BufferCount, m_Buffers);
+        m_bSeparateStreams = rvalue.m_bSeparateStreams;
+        m_nByteSize = rvalue.m_nByteSize;
+        m_IndexByteOffsetPerShape = std::move(rvalue.m_IndexByteOffsetPerShape);
+        m_IndexCountPerShape = std::move(rvalue.m_IndexCountPerShape);
+        m_IndexTypePerShape = std::move(rvalue.m_IndexTypePerShape);
+        m_BaseVertexPerShape = std::move(rvalue.m_BaseVertexPerShape);
+        m_InstanceCountPerShape = std::move(rvalue.m_InstanceCountPerShape);
+        m_FirstInstancePerShape = std::move(rvalue.m_FirstInstancePerShape);
+        rvalue.m_VAO = rvalue.m_PositionVAO = 0;
+        std::fill(rvalue.m_Buffers, rvalue.m_Buffers + BufferCount, 0);
+    }
+    return *this;
+}
+
+void GLSceneGeometry::release()
+{
+    if (m_VAO)
+    {
+        glDeleteVertexArrays(1, &m_VAO);
+        glDeleteVertexArrays(1, &m_PositionVAO);
+        glDeleteBuffers(GLsizei(BufferCount), m_Buffers); // Zeros are ignored
+        trackRelease(MemoryDomain::GPU, "GLSceneGeometry", m_nByteSize);
+    }
+}
+
+std::vector<GLTexture2D> uploadSceneTextures(const SceneData & data)
+{
+    std::vector<bool> isColorTexture(data.textures.size(), false);
+    std::vector<bool> isUsed(data.textures.size(), false);
+    for (const auto & material : data.materials)
+    {
+        for (const auto textureId : { material.KaTextureId, material.KdTextureId, material.KsTextureId }) {
+            if (textureId >= 0) {
+                isColorTexture[textureId] = isUsed[textureId] = true;
+            }
+        }
+        for (const auto textureId : { material.shininessTextureId, material.normalTextureId }) {
+            if (textureId >= 0) {
+                isUsed[textureId] = true;
+            }
+        }
+    }
+
+    std::vector<GLTexture2D> textures(data.textures.size());
+    for (size_t i = 0; i < data.textures.size(); ++i)
+    {
+        if (!isUsed[i]) {
+            continue;
+        }
+        if (i < data.compressedTextures.size() && data.compressedTextures[i].levelCount()) {
+            textures[i] = GLTexture2D(data.compressedTextures[i]);
+            if (isColorTexture[i]) {
+                textures[i].setGraySwizzle();
+            }
+        }
+        else if (data.textures[i].size()) {
+            textures[i] = GLTexture2D(data.textures[i], isColorTexture[i]);
+        }
+    }
+    return textures;
+}
+
+void releaseUploadedSceneData(SceneData & data, bool keepPositions)
+{
+    if (keepPositions && !data.vertexBuffer.empty())
+    {
+        data.positionBuffer.resize(data.vertexBuffer.size());
+        for (size_t i = 0; i < data.vertexBuffer.size(); ++i) {
+            data.positionBuffer[i] = data.vertexBuffer[i].position;
+        }
+    }
+    std::vector<Vertex3f3f2f>().swap(data.vertexBuffer);
+    std::vector<glm::vec3>().swap(data.normalBuffer);
+    std::vector<glm::vec2>().swap(data.texCoordsBuffer);
+    std::vector<glm::vec4>().swap(data.tangentBuffer);
+    if (!keepPositions)
+    {
+        std::vector<glm::vec3>().swap(data.positionBuffer);
+        std::vector<uint32_t>().swap(data.indexBuffer);
+    }
+
+    // Empty images keep the texture ids valid
+    for (auto & texture : data.textures) {
+        texture = AnyImage2D();
+    }
+    for (auto & texture : data.compressedTextures) {
+        texture = CompressedImage2D();
+    }
+}
+
+}
@@ -0,0 +1,360 @@
+#include <glmlv/GLTexture2D.hpp>
+#include <glmlv/memory_registry.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+
+namespace glmlv
+{
+
+GLsizei computeMipLevelCount(GLsizei width, GLsizei height)
+{
+    GLsizei levelCount = 1;
+    for (auto size = std::max(width, height); size > 1; size /= 2) {
+        ++levelCount;
+    }
+    return levelCount;
+}
+
+GLenum chooseInternalFormat(GLenum format, bool sRGB)
+{
+    switch (format)
+    {
+    case GL_RED:
+        return GL_R8;
+    case GL_RG:
+        return GL_RG8;
+    case GL_RGB:
+        return sRGB ? GL_SRGB8 : GL_RGB8;
+    case GL_RGBA:
+        return sRGB ? GL_SRGB8_ALPHA8 : GL_RGBA8;
+    }
+    std::cerr << "Unsupported pixel format " << format << std::endl;
+    throw std::runtime_error("Unsupported pixel format");
+}
+
+GLenum chooseInternalFormat(ImageFormat format, bool sRGB)
+{
+    switch (format)
+    {
+    case ImageFormat::R16F:
+        return GL_R16F;
+    case ImageFormat::RGBA16F:
+        return GL_RGBA16F;
+    case ImageFormat::RGBA32F:
+        return GL_RGBA32F;
+    default:
+        return chooseInternalFormat(getGLPixelFormat(format), sRGB);
+    }
+}
+
+GLenum getGLPixelFormat(ImageFormat format)
+{
+    switch (format)
+    {
+    case ImageFormat::R8:
+    case ImageFormat::R16F:
+        return GL_RED;
+    case ImageFormat::RG8:
+        return GL_RG;
+    case ImageFormat::RGB8:
+        return GL_RGB;
+    case ImageFormat::RGBA8:
+    case ImageFormat::RGBA16F:
+    case ImageFormat::RGBA32F:
+        return GL_RGBA;
+    }
+    return GL_NONE;
+}
+
+GLenum getGLPixelType(ImageFormat format)
+{
+    switch (format)
+    {
+    case ImageFormat::R16F:
+    case ImageFormat::RGBA16F:
+        return GL_HALF_FLOAT;
+    case ImageFormat::RGBA32F:
+        return GL_FLOAT;
+    default:
+        return GL_UNSIGNED_BYTE;
+    }
+}
+
+// Bytes per texel of uncompressed internal formats
+static size_t getTexelByteSize(GLenum internalFormat)
+{
+    switch (internalFormat)
+    {
+    case GL_R8:
+        return 1;
+    case GL_RG8:
+    case GL_R16F:
+    case GL_DEPTH_COMPONENT16:
+        return 2;
+    case GL_RGB8: // Drivers pad 3 components texels to 4 bytes
+    case GL_SRGB8:
+    case GL_RGBA8:
+    case GL_SRGB8_ALPHA8:
+    case GL_RG16F:
+    case GL_R32F:
+    case GL_R11F_G11F_B10F:
+    case GL_DEPTH_COMPONENT24:
+    case GL_DEPTH_COMPONENT32F:
+    case GL_DEPTH24_STENCIL8:
+        return 4;
+    case GL_RGB16F:
+    case GL_RGBA16F:
+    case GL_RG32F:
+        return 8;
+    case GL_RGB32F:
+    case GL_RGBA32F:
+        return 16;
+    }
+    std::clog << "Warning: unknown texel size for internal format " << internalFormat << ", assuming 4 bytes" << std::endl;
+    return 4;
+}
+
+// Bytes per 4x4 block of compressed internal formats, 0 for uncompressed formats
+static size_t getCompressedBlockByteSize(GLenum internalFormat)
+{
+    switch (internalFormat)
+    {
+    case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+    case GL_COMPRESSED_SRGB_S3TC_DXT1_EXT:
+    case GL_COMPRESSED_RED_RGTC1:
+    case GL_COMPRESSED_RGB8_ETC2:
+    case GL_COMPRESSED_SRGB8_ETC2:
+    case GL_COMPRESSED_R11_EAC:
+        return 8;
+    case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
+    case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT:
+    case GL_COMPRESSED_RG_RGTC2:
+    case GL_COMPRESSED_RGBA8_ETC2_EAC:
+    case GL_COMPRESSED_SRGB8_ALPHA8_ETC2_EAC:
+    case GL_COMPRESSED_RG11_EAC:
+    case GL_COMPRESSED_RGBA_BPTC_UNORM:
+    case GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM:
+        return 16;
+    }
+    return 0;
+}
+
+size_t computeTextureByteSize(GLenum internalFormat, GLsizei width, GLsizei height, GLsizei levelCount)
+{
+    const auto blockByteSize = getCompressedBlockByteSize(internalFormat);
+    const auto texelByteSize = blockByteSize ? 0 : getTexelByteSize(internalFormat);
+
+    size_t byteSize = 0;
+    for (GLsizei level = 0; level < levelCount; ++level)
+    {
+        const size_t levelWidth = std::max(1, width >> level);
+        const size_t levelHeight = std::max(1, height >> level);
+        if (blockByteSize) {
+            byteSize += ((levelWidth + 3) / 4) * ((levelHeight + 3) / 4) * blockByteSize;
+        }
+        else {
+            byteSize += levelWidth * levelHeight * texelByteSize;
+        }
+    }
+    return byteSize;
+}
+
+bool isS3TCSupported()
+{
+    GLint extensionCount = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &extensionCount);
+    for (GLint i = 0; i < extensionCount; ++i)
+    {
+        const auto extension = reinterpret_cast<const char*>(glGetStringi(GL_EXTENSIONS, GLuint(i)));
+        if (extension && std::strcmp(extension, "GL_EXT_texture_compression_s3tc") == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+GLTexture2D::GLTexture2D(GLenum internalFormat, GLsizei width, GLsizei height, GLsizei levelCount)
+{
+    allocate(internalFormat, width, height, levelCount);
+}
+
+GLTexture2D::GLTexture2D(GLsizei width, GLsizei height, GLenum format, const void * pixels, bool sRGB):
+    GLTexture2D(width, height, chooseInternalFormat(format, sRGB), format, GL_UNSIGNED_BYTE, pixels)
+{
+    if (sRGB) {
+        setGraySwizzle();
+    }
+}
+
+GLTexture2D::GLTexture2D(GLsizei width, GLsizei height, GLenum internalFormat, GLenum format, GLenum type, const void * pixels)
+{
+    allocate(internalFormat, width, height, computeMipLevelCount(width, height));
+
+    glBindTexture(GL_TEXTURE_2D, m_GLId);
+
+    // Rows of 1, 2 or 3 components pixels are not necessarily 4 bytes aligned
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, format, type, pixels);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+    glGenerateMipmap(GL_TEXTURE_2D);
+
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+GLTexture2D::GLTexture2D(const AnyImage2D & image, bool sRGB):
+    GLTexture2D(GLsizei(image.width()), GLsizei(image.height()), chooseInternalFormat(image.format(), sRGB), getGLPixelFormat(image.format()), getGLPixelType(image.format()), image.data())
+{
+    if (sRGB) {
+        setGraySwizzle();
+    }
+}
+
+GLTexture2D::GLTexture2D(const fs::path & path, bool sRGB):
+    GLTexture2D(readAnyImage(path), sRGB)
+{
+}
+
+GLTexture2D::GLTexture2D(const Image2DRGBAMipChain & mipChain, bool sRGB)
+{
+    allocate(chooseInternalFormat(GL_RGBA, sRGB), GLsizei(mipChain.width()), GLsizei(mipChain.height()), GLsizei(mipChain.levelCount()));
+
+    glBindTexture(GL_TEXTURE_2D, m_GLId);
+
+    for (size_t level = 0; level < mipChain.levelCount(); ++level) {
+        glTexSubImage2D(GL_TEXTURE_2D, GLint(level), 0, 0, GLsizei(mipChain.width(level)), GLsizei(mipChain.height(level)), GL_RGBA, GL_UNSIGNED_BYTE, mipChain.data(level));
+    }
+
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+GLTexture2D::GLTexture2D(const CompressedImage2D & image)
+{
+    allocate(getGLInternalFormat(image.format()), GLsizei(image.width()), GLsizei(image.height()), GLsizei(image.levelCount()));
+
+    glBindTexture(GL_TEXTURE_2D, m_GLId);
+
+    for (size_t level = 0; level < image.levelCount(); ++level) {
+        glCompressedTexSubImage2D(GL_TEXTURE_2D, GLint(level), 0, 0, GLsizei(image.width(level)), GLsizei(image.height(level)), m_InternalFormat, GLsizei(image.byteSize(level)), image.data(level));
+    }
+
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, image.levelCount() > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+GLTexture2D::GLTexture2D(const TextureContainer & container, size_t layer)
+{
+    allocate(container.internalFormat(), GLsizei(container.width()), GLsizei(container.height()), GLsizei(container.levelCount()));
+
+    glBindTexture(GL_TEXTURE_2D, m_GLId);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1); // Container levels are tightly packed
+
+    for (size_t level = 0; level < container.levelCount(); ++level)
+    {
+        const auto span = container.level(level, layer);
+        if (container.isCompressed()) {
+            glCompressedTexSubImage2D(GL_TEXTURE_2D, GLint(level), 0, 0, GLsizei(span.width), GLsizei(span.height), m_InternalFormat, GLsizei(span.byteSize), span.data);
+        }
+        else {
+            glTexSubImage2D(GL_TEXTURE_2D, GLint(level), 0, 0, GLsizei(span.width), GLsizei(span.height), container.pixelFormat(), container.pixelType(), span.data);
+        }
+    }
+
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, container.levelCount() > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+GLTexture2D::~GLTexture2D()
+{
+    release();
+}
+
+GLTexture2D::GLTexture2D(GLTexture2D&& rvalue):
+    m_GLId(rvalue.m_GLId), m_InternalFormat(rvalue.m_InternalFormat),
+    m_nWidth(rvalue.m_nWidth), m_nHeight(rvalue.m_nHeight), m_nLevelCount(rvalue.m_nLevelCount)
+{
+    rvalue.m_GLId = 0;
+}
+
+GLTexture2D& GLTexture2D::operator =(GLTexture2D&& rvalue)
+{
+    if (this != &rvalue)
+    {
+        release();
+        m_GLId = rvalue.m_GLId;
+        m_InternalFormat = rvalue.m_InternalFormat;
+        m_nWidth = rvalue.m_nWidth;
+        m_nHeight = rvalue.m_nHeight;
+        m_nLevelCount = rvalue.m_nLevelCount;
+        rvalue.m_GLId = 0;
+    }
+    return *this;
+}
+
+void GLTexture2D::release()
+{
+    if (m_GLId) {
+        glDeleteTextures(1, &m_GLId);
+        trackRelease(MemoryDomain::GPU, "GLTexture2D/" + getGLInternalFormatName(m_InternalFormat), byteSize());
+    }
+}
+
+void GLTexture2D::allocate(GLenum internalFormat, GLsizei width, GLsizei height, GLsizei levelCount)
+{
+    m_InternalFormat = internalFormat;
+    m_nWidth = width;
+    m_nHeight = height;
+    m_nLevelCount = levelCount;
+
+    glGenTextures(1, &m_GLId);
+    glBindTexture(GL_TEXTURE_2D, m_GLId);
+    glTexStorage2D(GL_TEXTURE_2D, levelCount, internalFormat, width, height);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    trackAllocation(MemoryDomain::GPU, "GLTexture2D/" + getGLInternalFormatName(m_InternalFormat), byteSize());
+}
+
+void GLTexture2D::setGraySwizzle()
+{
+    GLint alpha;
+    switch (m_InternalFormat)
+    {
+    case GL_R8:
+    case GL_R16F:
+    case GL_R32F:
+    case GL_COMPRESSED_RED_RGTC1:
+    case GL_COMPRESSED_R11_EAC:
+        alpha = GL_ONE;
+        break;
+    case GL_RG8:
+    case GL_RG16F:
+    case GL_RG32F:
+    case GL_COMPRESSED_RG_RGTC2:
+    case GL_COMPRESSED_RG11_EAC:
+        alpha = GL_GREEN;
+        break;
+    default:
+        return;
+    }
+
+    const GLint swizzle[] = { GL_RED, GL_RED, GL_RED, alpha };
+    glBindTexture(GL_TEXTURE_2D, m_GLId);
+    glTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_RGBA, swizzle);
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+}
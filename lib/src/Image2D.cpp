@@ -0,0 +1,402 @@
+#include <glmlv/Image2D.hpp>
+
+#include <iostream>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+#define STB_IMAGE_IMPLEMENTATION
+#include <stb_image.h>
+
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include <stb_image_write.h>
+
+namespace glmlv
+{
+
+namespace
+{
+
+uint16_t floatToHalf(float value)
+{
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+
+    const uint32_t sign = (bits >> 16) & 0x8000;
+    const int32_t exponent = int32_t((bits >> 23) & 0xFF) - 127 + 15;
+    uint32_t mantissa = bits & 0x7FFFFF;
+
+    if (((bits >> 23) & 0xFF) == 0xFF) { // Inf and NaN
+        return uint16_t(sign | 0x7C00 | (mantissa ? 0x200 : 0));
+    }
+    if (exponent >= 31) { // Overflow to infinity
+        return uint16_t(sign | 0x7C00);
+    }
+    if (exponent <= 0) // Denormals and underflow to zero
+    {
+        if (exponent < -10) {
+            return uint16_t(sign);
+        }
+        mantissa |= 0x800000;
+        const auto shift = uint32_t(14 - exponent);
+        return uint16_t(sign | ((mantissa + (1u << (shift - 1))) >> shift));
+    }
+    // Round to nearest, a carry in the mantissa correctly increments the exponent
+    return uint16_t((sign | (uint32_t(exponent) << 10) | (mantissa >> 13)) + ((mantissa >> 12) & 1));
+}
+
+float halfToFloat(uint16_t value)
+{
+    const uint32_t sign = uint32_t(value & 0x8000) << 16;
+    const uint32_t exponent = (value >> 10) & 0x1F;
+    const uint32_t mantissa = value & 0x3FF;
+
+    float result;
+    if (exponent == 0) {
+        result = std::ldexp(float(mantissa), -24); // Denormals
+    }
+    else
+    {
+        const uint32_t bits = exponent == 31 ? (0x7F800000 | (mantissa << 13)) : (((exponent + 127 - 15) << 23) | (mantissa << 13));
+        std::memcpy(&result, &bits, sizeof(result));
+    }
+    return sign ? -result : result;
+}
+
+void onReadFailure(const fs::path & path)
+{
+    std::cerr << "Unable to load image " << path << ": " << stbi_failure_reason() << std::endl;
+    throw std::runtime_error(stbi_failure_reason());
+}
+
+// Load the components of an image file, converted to the component type of the destination
+unsigned char * loadComponents(const fs::path & path, int & width, int & height, size_t componentCount, unsigned char *)
+{
+    int fileComponentCount;
+    return stbi_load(path.string().c_str(), &width, &height, &fileComponentCount, int(componentCount));
+}
+
+float * loadComponents(const fs::path & path, int & width, int & height, size_t componentCount, float *)
+{
+    int fileComponentCount;
+    if (stbi_is_hdr(path.string().c_str())) {
+        return stbi_loadf(path.string().c_str(), &width, &height, &fileComponentCount, int(componentCount));
+    }
+
+    // LDR files are normalized to [0, 1] without gamma here: stbi_ldr_to_hdr_gamma is a global shared by the loading threads
+    std::unique_ptr<unsigned char[], ImageDataDeleter> bytes(stbi_load(path.string().c_str(), &width, &height, &fileComponentCount, int(componentCount)));
+    if (!bytes) {
+        return nullptr;
+    }
+
+    const auto count = size_t(width) * height * componentCount;
+    auto * floats = (float *) STBI_MALLOC(count * sizeof(float));
+    for (size_t i = 0; i < count; ++i) {
+        floats[i] = bytes[i] / 255.f;
+    }
+    return floats;
+}
+
+uint16_t * loadComponents(const fs::path & path, int & width, int & height, size_t componentCount, uint16_t *)
+{
+    std::unique_ptr<float[], ImageDataDeleter> floats(loadComponents(path, width, height, componentCount, (float *) nullptr));
+    if (!floats) {
+        return nullptr;
+    }
+
+    const auto count = size_t(width) * height * componentCount;
+    auto * halfs = (uint16_t *) STBI_MALLOC(count * sizeof(uint16_t));
+    for (size_t i = 0; i < count; ++i) {
+        halfs[i] = floatToHalf(floats[i]);
+    }
+    return halfs;
+}
+
+inline unsigned char toUnorm8(unsigned char value)
+{
+    return value;
+}
+
+inline unsigned char toUnorm8(float value)
+{
+    return (unsigned char)(std::min(std::max(value, 0.f), 1.f) * 255.f + 0.5f);
+}
+
+inline unsigned char toUnorm8(uint16_t value)
+{
+    return toUnorm8(halfToFloat(value));
+}
+
+template<ImageFormat F>
+void convertToRGBA8(const unsigned char * data, size_t texelCount, unsigned char * rgba)
+{
+    using ComponentType = typename ImageFormatTraits<F>::ComponentType;
+    const auto componentCount = ImageFormatTraits<F>::NumComponents;
+    const auto * components = reinterpret_cast<const ComponentType *>(data);
+
+    for (size_t i = 0; i < texelCount; ++i)
+    {
+        const auto * texel = components + i * componentCount;
+        auto * dst = rgba + i * 4;
+        dst[0] = toUnorm8(texel[0]);
+        dst[1] = componentCount <= 2 ? dst[0] : toUnorm8(texel[1]);
+        dst[2] = componentCount <= 2 ? dst[0] : toUnorm8(texel[2]);
+        dst[3] = componentCount == 4 ? toUnorm8(texel[3]) : componentCount == 2 ? toUnorm8(texel[1]) : 255;
+    }
+}
+
+void flipRows(unsigned char * data, size_t rowByteSize, size_t height)
+{
+    if (!height) {
+        return;
+    }
+
+    unsigned char * pFirstLine = data;
+    unsigned char * pLastLine = data + (height - 1) * rowByteSize;
+
+    while (pFirstLine < pLastLine)
+    {
+        std::swap_ranges(pFirstLine, pFirstLine + rowByteSize, pLastLine);
+        pFirstLine += rowByteSize;
+        pLastLine -= rowByteSize;
+    }
+}
+
+}
+
+size_t getComponentCount(ImageFormat format)
+{
+    switch (format)
+    {
+    case ImageFormat::R8:
+    case ImageFormat::R16F:
+        return 1;
+    case ImageFormat::RG8:
+        return 2;
+    case ImageFormat::RGB8:
+        return 3;
+    case ImageFormat::RGBA8:
+    case ImageFormat::RGBA16F:
+    case ImageFormat::RGBA32F:
+        return 4;
+    }
+    return 0;
+}
+
+size_t getTexelByteSize(ImageFormat format)
+{
+    switch (format)
+    {
+    case ImageFormat::R8:
+        return 1;
+    case ImageFormat::RG8:
+    case ImageFormat::R16F:
+        return 2;
+    case ImageFormat::RGB8:
+        return 3;
+    case ImageFormat::RGBA8:
+        return 4;
+    case ImageFormat::RGBA16F:
+        return 8;
+    case ImageFormat::RGBA32F:
+        return 16;
+    }
+    return 0;
+}
+
+void ImageDataDeleter::operator ()(void * ptr) const
+{
+    stbi_image_free(ptr);
+}
+
+template<ImageFormat F>
+Image2D<F>::Image2D(size_t width, size_t height):
+    m_pData((ComponentType*) STBI_MALLOC(width * height * NumComponents * sizeof(ComponentType))),
+    m_nWidth(width),
+    m_nHeight(height)
+{
+}
+
+template<ImageFormat F>
+Image2D<F>::Image2D(size_t width, size_t height, ComponentType r, ComponentType g, ComponentType b, ComponentType a)
+    : Image2D(width, height)
+{
+    const ComponentType texel[4] = { r, g, b, a };
+    ComponentType * pPixel = m_pData.get();
+    for (size_t i = 0, s = size(); i < s; ++i)
+    {
+        std::copy(texel, texel + NumComponents, pPixel);
+        pPixel += NumComponents;
+    }
+}
+
+template<ImageFormat F>
+void Image2D<F>::flipY()
+{
+    flipRows(reinterpret_cast<unsigned char *>(m_pData.get()), m_nWidth * NumComponents * sizeof(ComponentType), m_nHeight);
+}
+
+template class Image2D<ImageFormat::R8>;
+template class Image2D<ImageFormat::RG8>;
+template class Image2D<ImageFormat::RGB8>;
+template class Image2D<ImageFormat::RGBA8>;
+template class Image2D<ImageFormat::R16F>;
+template class Image2D<ImageFormat::RGBA16F>;
+template class Image2D<ImageFormat::RGBA32F>;
+
+void AnyImage2D::flipY()
+{
+    flipRows(m_pData.get(), m_nWidth * getTexelByteSize(m_Format), m_nHeight);
+}
+
+AnyImage2D AnyImage2D::clone() const
+{
+    AnyImage2D image;
+    image.m_Format = m_Format;
+    image.m_pData.reset((unsigned char *) STBI_MALLOC(byteSize()));
+    image.m_nWidth = m_nWidth;
+    image.m_nHeight = m_nHeight;
+    std::copy(data(), data() + byteSize(), image.data());
+    return image;
+}
+
+Image2D<ImageFormat::RGBA8> AnyImage2D::toRGBA8() const
+{
+    Image2D<ImageFormat::RGBA8> image(m_nWidth, m_nHeight);
+    switch (m_Format)
+    {
+    case ImageFormat::R8:
+        convertToRGBA8<ImageFormat::R8>(data(), size(), image.data());
+        break;
+    case ImageFormat::RG8:
+        convertToRGBA8<ImageFormat::RG8>(data(), size(), image.data());
+        break;
+    case ImageFormat::RGB8:
+        convertToRGBA8<ImageFormat::RGB8>(data(), size(), image.data());
+        break;
+    case ImageFormat::RGBA8:
+        std::copy(data(), data() + byteSize(), image.data());
+        break;
+    case ImageFormat::R16F:
+        convertToRGBA8<ImageFormat::R16F>(data(), size(), image.data());
+        break;
+    case ImageFormat::RGBA16F:
+        convertToRGBA8<ImageFormat::RGBA16F>(data(), size(), image.data());
+        break;
+    case ImageFormat::RGBA32F:
+        convertToRGBA8<ImageFormat::RGBA32F>(data(), size(), image.data());
+        break;
+    }
+    return image;
+}
+
+template<ImageFormat F>
+Image2D<F> readImage(const fs::path& path)
+{
+    Image2D<F> image;
+    int w, h;
+    image.m_pData.reset(loadComponents(path, w, h, Image2D<F>::NumComponents, (typename Image2D<F>::ComponentType *) nullptr));
+    if (!image.m_pData) {
+        onReadFailure(path);
+    }
+
+    image.m_nWidth = w;
+    image.m_nHeight = h;
+
+    return image;
+}
+
+template Image2D<ImageFormat::R8> readImage<ImageFormat::R8>(const fs::path&);
+template Image2D<ImageFormat::RG8> readImage<ImageFormat::RG8>(const fs::path&);
+template Image2D<ImageFormat::RGB8> readImage<ImageFormat::RGB8>(const fs::path&);
+template Image2D<ImageFormat::RGBA8> readImage<ImageFormat::RGBA8>(const fs::path&);
+template Image2D<ImageFormat::R16F> readImage<ImageFormat::R16F>(const fs::path&);
+template Image2D<ImageFormat::RGBA16F> readImage<ImageFormat::RGBA16F>(const fs::path&);
+template Image2D<ImageFormat::RGBA32F> readImage<ImageFormat::RGBA32F>(const fs::path&);
+
+AnyImage2D readAnyImage(const fs::path& path)
+{
+    int w, h, componentCount;
+    if (!stbi_info(path.string().c_str(), &w, &h, &componentCount)) {
+        onReadFailure(path);
+    }
+
+    if (stbi_is_hdr(path.string().c_str())) {
+        return readImage<ImageFormat::RGBA32F>(path);
+    }
+    switch (componentCount)
+    {
+    case 1:
+        return readImage<ImageFormat::R8>(path);
+    case 2:
+        return readImage<ImageFormat::RG8>(path);
+    case 3:
+        return readImage<ImageFormat::RGB8>(path);
+    }
+    return readImage<ImageFormat::RGBA8>(path);
+}
+
+static void writeImage(ImageFormat format, size_t width, size_t height, const void * data, const fs::path& path)
+{
+    const auto onFailure = []()
+    {
+        std::cerr << "Unable to write image" << std::endl;
+        throw std::runtime_error("Unable to write image");
+    };
+
+    // stb_image_write functions return 0 on failure
+    const auto ext = path.extension();
+    const auto componentCount = int(getComponentCount(format));
+    const bool is8Bits = format == ImageFormat::R8 || format == ImageFormat::RG8 || format == ImageFormat::RGB8 || format == ImageFormat::RGBA8;
+    if (is8Bits && ext == ".png")
+    {
+        if (!stbi_write_png(path.string().c_str(), int(width), int(height), componentCount, data, 0)) {
+            onFailure();
+        }
+    }
+    else if (is8Bits && ext == ".bmp")
+    {
+        if (!stbi_write_bmp(path.string().c_str(), int(width), int(height), componentCount, data)) {
+            onFailure();
+        }
+    }
+    else if (is8Bits && ext == ".tga")
+    {
+        if (!stbi_write_tga(path.string().c_str(), int(width), int(height), componentCount, data)) {
+            onFailure();
+        }
+    }
+    else if (format == ImageFormat::RGBA32F && ext == ".hdr")
+    {
+        if (!stbi_write_hdr(path.string().c_str(), int(width), int(height), componentCount, static_cast<const float *>(data))) {
+            onFailure();
+        }
+    }
+    else
+    {
+        std::cerr << "Unsupported image format or extension for " << path << std::endl;
+        throw std::runtime_error("Unsupported image format or extension");
+    }
+}
+
+template<ImageFormat F>
+void writeImage(const Image2D<F>& image, const fs::path& path)
+{
+    writeImage(F, image.width(), image.height(), image.data(), path);
+}
+
+template void writeImage<ImageFormat::R8>(const Image2D<ImageFormat::R8>&, const fs::path&);
+template void writeImage<ImageFormat::RG8>(const Image2D<ImageFormat::RG8>&, const fs::path&);
+template void writeImage<ImageFormat::RGB8>(const Image2D<ImageFormat::RGB8>&, const fs::path&);
+template void writeImage<ImageFormat::RGBA8>(const Image2D<ImageFormat::RGBA8>&, const fs::path&);
+template void writeImage<ImageFormat::R16F>(const Image2D<ImageFormat::R16F>&, const fs::path&);
+template void writeImage<ImageFormat::RGBA16F>(const Image2D<ImageFormat::RGBA16F>&, const fs::path&);
+template void writeImage<ImageFormat::RGBA32F>(const Image2D<ImageFormat::RGBA32F>&, const fs::path&);
+
+void writeImage(const AnyImage2D& image, const fs::path& path)
+{
+    writeImage(image.format(), image.width(), image.height(), image.data(), path);
+}
+
+}
@@ -0,0 +1,148 @@
+#include <glmlv/MappedFile.hpp>
+
+#include <iostream>
+#include <stdexcept>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace glmlv
+{
+
+static void onMappingFailure(const fs::path & path)
+{
+    std::cerr << "Unable to map file " << path << std::endl;
+    throw std::runtime_error("Unable to map file");
+}
+
+#ifdef _WIN32
+
+MappedFile::MappedFile(const fs::path & path)
+{
+    m_FileHandle = CreateFileW(path.wstring().c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (m_FileHandle == INVALID_HANDLE_VALUE)
+    {
+        m_FileHandle = nullptr;
+        onMappingFailure(path);
+    }
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(m_FileHandle, &size))
+    {
+        release();
+        onMappingFailure(path);
+    }
+    m_nSize = size_t(size.QuadPart);
+    if (!m_nSize) {
+        return; // Empty files cannot be mapped
+    }
+
+    m_MappingHandle = CreateFileMappingW(m_FileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    m_pData = m_MappingHandle ? static_cast<const unsigned char *>(MapViewOfFile(m_MappingHandle, FILE_MAP_READ, 0, 0, 0)) : nullptr;
+    if (!m_pData)
+    {
+        release();
+        onMappingFailure(path);
+    }
+}
+
+void MappedFile::release()
+{
+    if (m_pData) {
+        UnmapViewOfFile(m_pData);
+    }
+    if (m_MappingHandle) {
+        CloseHandle(m_MappingHandle);
+    }
+    if (m_FileHandle) {
+        CloseHandle(m_FileHandle);
+    }
+    m_pData = nullptr;
+    m_MappingHandle = m_FileHandle = nullptr;
+}
+
+#else
+
+MappedFile::MappedFile(const fs::path & path)
+{
+    const auto fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        onMappingFailure(path);
+    }
+
+    struct stat status;
+    if (fstat(fd, &status) != 0)
+    {
+        close(fd);
+        onMappingFailure(path);
+    }
+    m_nSize = size_t(status.st_size);
+    if (!m_nSize)
+    {
+        close(fd);
+        return; // Empty files cannot be mapped
+    }
+
+    void * address = mmap(nullptr, m_nSize, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd); // The mapping keeps its own reference to the file
+    if (address == MAP_FAILED) {
+        onMappingFailure(path);
+    }
+    m_pData = static_cast<const unsigned char *>(address);
+}
+
+void MappedFile::release()
+{
+    if (m_pData) {
+        munmap(const_cast<unsigned char *>(m_pData), m_nSize);
+    }
+    m_pData = nullptr;
+}
+
+#endif
+
+MappedFile::~MappedFile()
+{
+    release();
+}
+
+MappedFile::MappedFile(MappedFile&& rvalue):
+    m_pData(rvalue.m_pData), m_nSize(rvalue.m_nSize)
+#ifdef _WIN32
+    , m_FileHandle(rvalue.m_FileHandle), m_MappingHandle(rvalue.m_MappingHandle)
+#endif
+{
+    rvalue.m_pData = nullptr;
+    rvalue.m_nSize = 0;
+#ifdef _WIN32
+    rvalue.m_FileHandle = rvalue.m_MappingHandle = nullptr;
+#endif
+}
+
+MappedFile& MappedFile::operator =(MappedFile&& rvalue)
+{
+    if (this != &rvalue)
+    {
+        release();
+        m_pData = rvalue.m_pData;
+        m_nSize = rvalue.m_nSize;
+        rvalue.m_pData = nullptr;
+        rvalue.m_nSize = 0;
+#ifdef _WIN32
+        m_FileHandle = rvalue.m_FileHandle;
+        m_MappingHandle = rvalue.m_MappingHandle;
+        rvalue.m_FileHandle = rvalue.m_MappingHandle = nullptr;
+#endif
+    }
+    return *this;
+}
+
+}
@@ -0,0 +1,237 @@
+#include <glmlv/animation.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define GLMLV_ANIMATION_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace glmlv
+{
+
+namespace
+{
+
+// Weighted sum of 2 or 4 groups of 4 floats, for laneCount groups
+void blend2(const float * a, float wa, const float * b, float wb, float * output, size_t laneCount)
+{
+#ifdef GLMLV_ANIMATION_SSE2
+    const __m128 weightA = _mm_set1_ps(wa);
+    const __m128 weightB = _mm_set1_ps(wb);
+    for (size_t i = 0; i < laneCount * 4; i += 4) {
+        _mm_storeu_ps(output + i, _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(a + i), weightA), _mm_mul_ps(_mm_loadu_ps(b + i), weightB)));
+    }
+#else
+    for (size_t i = 0; i < laneCount * 4; ++i) {
+        output[i] = a[i] * wa + b[i] * wb;
+    }
+#endif
+}
+
+void blend4(const float * a, float wa, const float * b, float wb, const float * c, float wc, const float * d, float wd, float * output, size_t laneCount)
+{
+#ifdef GLMLV_ANIMATION_SSE2
+    const __m128 weightA = _mm_set1_ps(wa);
+    const __m128 weightB = _mm_set1_ps(wb);
+    const __m128 weightC = _mm_set1_ps(wc);
+    const __m128 weightD = _mm_set1_ps(wd);
+    for (size_t i = 0; i < laneCount * 4; i += 4)
+    {
+        const __m128 ab = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(a + i), weightA), _mm_mul_ps(_mm_loadu_ps(b + i), weightB));
+        const __m128 cd = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(c + i), weightC), _mm_mul_ps(_mm_loadu_ps(d + i), weightD));
+        _mm_storeu_ps(output + i, _mm_add_ps(ab, cd));
+    }
+#else
+    for (size_t i = 0; i < laneCount * 4; ++i) {
+        output[i] = a[i] * wa + b[i] * wb + c[i] * wc + d[i] * wd;
+    }
+#endif
+}
+
+float dot4(const float * a, const float * b)
+{
+    return a[0] * b[0] + a[1] * b[1] + a[2] * b[2] + a[3] * b[3];
+}
+
+void normalize4(float * q)
+{
+    const auto length = std::sqrt(dot4(q, q));
+    if (length > 0.f)
+    {
+        for (size_t i = 0; i < 4; ++i) {
+            q[i] /= length;
+        }
+    }
+}
+
+// Shortest path spherical interpolation, normalized linear interpolation when the quaternions are too close
+void slerp(const float * a, const float * b, float t, float * output)
+{
+    auto cosTheta = dot4(a, b);
+    const auto sign = cosTheta < 0.f ? -1.f : 1.f;
+    cosTheta *= sign;
+    auto wa = 1.f - t;
+    auto wb = t;
+    if (cosTheta < 0.9995f)
+    {
+        const auto theta = std::acos(cosTheta);
+        const auto sinTheta = std::sin(theta);
+        wa = std::sin(wa * theta) / sinTheta;
+        wb = std::sin(wb * theta) / sinTheta;
+    }
+    blend2(a, wa, b, wb * sign, output, 1);
+    normalize4(output);
+}
+
+AnimationPath parsePath(const std::string & path)
+{
+    if (path == "translation") {
+        return AnimationPath::Translation;
+    }
+    if (path == "rotation") {
+        return AnimationPath::Rotation;
+    }
+    if (path == "scale") {
+        return AnimationPath::Scale;
+    }
+    if (path == "weights") {
+        return AnimationPath::Weights;
+    }
+    throw std::runtime_error("Unknown animation path " + path);
+}
+
+AnimationInterpolation parseInterpolation(const std::string & interpolation)
+{
+    if (interpolation == "STEP") {
+        return AnimationInterpolation::Step;
+    }
+    if (interpolation == "CUBICSPLINE") {
+        return AnimationInterpolation::CubicSpline;
+    }
+    return AnimationInterpolation::Linear;
+}
+
+}
+
+void AnimationClip::sample(float time, float * output) const
+{
+    for (const auto & channel : m_Channels)
+    {
+        const auto & sampler = m_Samplers[channel.sampler];
+        const auto times = m_Times.data() + sampler.keyOffset;
+        const auto values = m_Values.data() + sampler.valueOffset;
+        const auto valueSize = sampler.laneCount * 4;
+        const auto keySize = sampler.interpolation == AnimationInterpolation::CubicSpline ? 3 * valueSize : valueSize;
+        const auto valueInKey = sampler.interpolation == AnimationInterpolation::CubicSpline ? valueSize : 0; // Skip the in tangent
+        auto result = output + channel.outputOffset;
+
+        // Key before time, or first or last key out of the range
+        const auto next = size_t(std::upper_bound(times, times + sampler.keyCount, time) - times);
+        if (next == 0 || next == sampler.keyCount || sampler.interpolation == AnimationInterpolation::Step)
+        {
+            const auto key = next == 0 ? 0 : next - 1;
+            std::memcpy(result, values + key * keySize + valueInKey, valueSize * sizeof(float));
+            continue;
+        }
+
+        const auto previous = next - 1;
+        const auto delta = times[next] - times[previous];
+        const auto t = delta > 0.f ? (time - times[previous]) / delta : 0.f;
+        if (sampler.interpolation == AnimationInterpolation::Linear)
+        {
+            if (channel.path == AnimationPath::Rotation) {
+                slerp(values + previous * keySize, values + next * keySize, t, result);
+            }
+            else {
+                blend2(values + previous * keySize, 1.f - t, values + next * keySize, t, result, sampler.laneCount);
+            }
+            continue;
+        }
+
+        // Hermite basis, tangents are scaled by the duration between the keys
+        const auto t2 = t * t;
+        const auto t3 = t2 * t;
+        const auto value0 = values + previous * keySize + valueSize;
+        const auto outTangent0 = value0 + valueSize;
+        const auto inTangent1 = values + next * keySize;
+        const auto value1 = inTangent1 + valueSize;
+        blend4(value0, 2.f * t3 - 3.f * t2 + 1.f, outTangent0, (t3 - 2.f * t2 + t) * delta,
+            value1, -2.f * t3 + 3.f * t2, inTangent1, (t3 - t2) * delta, result, sampler.laneCount);
+        if (channel.path == AnimationPath::Rotation) {
+            normalize4(result);
+        }
+    }
+}
+
+std::vector<AnimationClip> loadGltfAnimations(const GltfDocument & document)
+{
+    const auto & model = document.model;
+    std::vector<AnimationClip> clips;
+    for (size_t i = 0; i < model.animations.size(); ++i)
+    {
+        const auto & animation = model.animations[i];
+        AnimationClip clip;
+        clip.name = animation.name.empty() ? "Animation " + std::to_string(i) : animation.name;
+
+        // Samplers are read on first use, a sampler can be shared by several channels
+        std::vector<int> samplerIndices(animation.samplers.size(), -1);
+        for (const auto & channel : animation.channels)
+        {
+            if (channel.target_node < 0 || channel.target_node >= int(model.nodes.size()) || channel.sampler < 0 || channel.sampler >= int(animation.samplers.size())) {
+                continue;
+            }
+            const auto path = parsePath(channel.target_path);
+            if (samplerIndices[channel.sampler] < 0)
+            {
+                const auto & gltfSampler = animation.samplers[channel.sampler];
+                AnimationClip::Sampler sampler;
+                sampler.interpolation = parseInterpolation(gltfSampler.interpolation);
+                const auto times = readAccessorAsFloats(document, gltfSampler.input);
+                const auto values = readAccessorAsFloats(document, gltfSampler.output);
+                const auto valuesPerKey = sampler.interpolation == AnimationInterpolation::CubicSpline ? size_t(3) : size_t(1);
+                sampler.keyCount = times.size();
+                if (!sampler.keyCount) {
+                    continue;
+                }
+                if (values.size() % (sampler.keyCount * valuesPerKey)) {
+                    throw std::runtime_error("Invalid output of sampler " + std::to_string(channel.sampler) + " in " + clip.name);
+                }
+                sampler.componentCount = values.size() / (sampler.keyCount * valuesPerKey);
+                sampler.laneCount = (sampler.componentCount + 3) / 4;
+                sampler.keyOffset = clip.m_Times.size();
+                sampler.valueOffset = clip.m_Values.size();
+                clip.m_Times.insert(end(clip.m_Times), begin(times), end(times));
+                clip.m_fDuration = std::max(clip.m_fDuration, times.back());
+
+                // Pad each value with zeros to a multiple of 4 floats
+                clip.m_Values.resize(clip.m_Values.size() + sampler.keyCount * valuesPerKey * sampler.laneCount * 4, 0.f);
+                for (size_t v = 0; v < sampler.keyCount * valuesPerKey; ++v)
+                {
+                    std::copy(begin(values) + v * sampler.componentCount, begin(values) + (v + 1) * sampler.componentCount,
+                        begin(clip.m_Values) + sampler.valueOffset + v * sampler.laneCount * 4);
+                }
+                samplerIndices[channel.sampler] = int(clip.m_Samplers.size());
+                clip.m_Samplers.push_back(sampler);
+            }
+
+            AnimationClip::Channel clipChannel;
+            clipChannel.node = channel.target_node;
+            clipChannel.path = path;
+            clipChannel.sampler = size_t(samplerIndices[channel.sampler]);
+            clipChannel.outputOffset = clip.m_nOutputSize;
+            if ((path == AnimationPath::Rotation) != (clip.m_Samplers[clipChannel.sampler].componentCount == 4) && path != AnimationPath::Weights) {
+                throw std::runtime_error("Invalid " + channel.target_path + " sampler in " + clip.name);
+            }
+            clip.m_nOutputSize += clip.m_Samplers[clipChannel.sampler].laneCount * 4;
+            clip.m_Channels.push_back(clipChannel);
+        }
+        clips.emplace_back(std::move(clip));
+    }
+    return clips;
+}
+
+}
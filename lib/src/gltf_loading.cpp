@@ -0,0 +1,528 @@
+#define TINYGLTF_IMPLEMENTATION
+#include <glmlv/gltf_loading.hpp>
+#include <glmlv/meshopt_decoding.hpp>
+#include <glmlv/parallel.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <stdexcept>
+
+namespace glmlv
+{
+
+namespace
+{
+
+const uint32_t GlbMagic = 0x46546C67; // "glTF"
+const uint32_t GlbJsonChunkType = 0x4E4F534A; // "JSON"
+const uint32_t GlbBinChunkType = 0x004E4942; // "BIN\0"
+
+// Given to tinygltf in place of every buffer, so that it does not read nor copy them: a single zero byte
+const char * PlaceholderBufferURI = "data:application/octet-stream;base64,AA==";
+
+void onLoadingError(const fs::path & path, const std::string & message)
+{
+    std::cerr << "Unable to load glTF file " << path << ": " << message << std::endl;
+    throw std::runtime_error(message);
+}
+
+uint32_t readUint32(const unsigned char * data)
+{
+    uint32_t value;
+    std::memcpy(&value, data, sizeof(value));
+    return value;
+}
+
+bool decodeBase64(const char * begin, const char * end, std::vector<unsigned char> & output)
+{
+    int8_t values[256];
+    std::fill(values, values + 256, int8_t(-1));
+    const char * alphabet = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    for (int8_t i = 0; i < 64; ++i) {
+        values[(unsigned char) alphabet[i]] = i;
+    }
+
+    output.clear();
+    output.reserve((end - begin) / 4 * 3);
+    uint32_t bits = 0;
+    int bitCount = 0;
+    for (auto it = begin; it != end && *it != '='; ++it)
+    {
+        const auto value = values[(unsigned char) *it];
+        if (value < 0) {
+            return false;
+        }
+        bits = (bits << 6) | uint32_t(value);
+        bitCount += 6;
+        if (bitCount >= 8)
+        {
+            bitCount -= 8;
+            output.push_back((unsigned char)(bits >> bitCount));
+        }
+    }
+    return true;
+}
+
+const nlohmann::json * findMeshoptExtension(const nlohmann::json & object)
+{
+    const auto extensions = object.find("extensions");
+    if (extensions == object.end() || !extensions->is_object()) {
+        return nullptr;
+    }
+    const auto extension = extensions->find("EXT_meshopt_compression");
+    return extension != extensions->end() && extension->is_object() ? &*extension : nullptr;
+}
+
+// A buffer view compressed with EXT_meshopt_compression, decoded in the storage of its fallback buffer
+struct MeshoptBufferView
+{
+    unsigned char * destination = nullptr;
+    const unsigned char * source = nullptr;
+    size_t sourceSize = 0;
+    size_t count = 0;
+    size_t byteStride = 0;
+    MeshoptMode mode = MeshoptMode::Attributes;
+    MeshoptFilter filter = MeshoptFilter::None;
+};
+
+// Relative URIs may contain percent encoded characters (spaces, ...)
+std::string decodeURI(const std::string & uri)
+{
+    std::string result;
+    for (size_t i = 0; i < uri.size(); ++i)
+    {
+        if (uri[i] == '%' && i + 2 < uri.size())
+        {
+            result += char(std::stoi(uri.substr(i + 1, 2), nullptr, 16));
+            i += 2;
+        }
+        else {
+            result += uri[i];
+        }
+    }
+    return result;
+}
+
+// Images stored in buffer views (and deferred image files) are given to tinygltf with a placeholder buffer view,
+// their bytes are taken from the document here
+struct GltfImageLoader
+{
+    const GltfDocument * document = nullptr;
+    bool defer = false;
+    std::vector<GltfDocument::EncodedImage> encodedImages; // Indexed by image, grown on demand
+};
+
+bool loadImageData(tinygltf::Image * image, const int imageIndex, std::string * err, std::string * warn,
+    int requiredWidth, int requiredHeight, const unsigned char * bytes, int size, void * userData)
+{
+    auto & loader = *static_cast<GltfImageLoader *>(userData);
+    if (loader.encodedImages.size() <= size_t(imageIndex)) {
+        loader.encodedImages.resize(imageIndex + 1);
+    }
+    auto & encodedImage = loader.encodedImages[imageIndex];
+    const auto & range = encodedImage.range;
+    if (loader.defer)
+    {
+        // Only data URIs and copied buffers need to keep a copy of their bytes
+        if (encodedImage.path.empty() && range.end == range.begin) {
+            encodedImage.bytes.assign(bytes, bytes + size);
+        }
+        return true;
+    }
+    if (range.end > range.begin)
+    {
+        bytes = loader.document->bufferData(range.buffer) + range.begin;
+        size = int(range.end - range.begin);
+    }
+    return tinygltf::LoadImageData(image, imageIndex, err, warn, requiredWidth, requiredHeight, bytes, size, nullptr);
+}
+
+}
+
+GltfDocument loadGltf(const fs::path & path, GltfBufferMode bufferMode, GltfImageMode imageMode)
+{
+    GltfDocument document;
+    tinygltf::TinyGLTF loader;
+    std::string err;
+    std::string warn;
+    const auto isBinary = path.extension() == ".glb";
+    const auto baseDirectory = path.parent_path();
+
+    GltfImageLoader imageLoader;
+    imageLoader.document = &document;
+    imageLoader.defer = imageMode == GltfImageMode::Defer;
+    loader.SetImageLoader(loadImageData, &imageLoader);
+
+    if (bufferMode == GltfBufferMode::Copy)
+    {
+        const auto loaded = isBinary ?
+            loader.LoadBinaryFromFile(&document.model, &err, &warn, path.string()) :
+            loader.LoadASCIIFromFile(&document.model, &err, &warn, path.string());
+        if (!warn.empty()) {
+            std::clog << "Warning: " << warn << std::endl;
+        }
+        if (!loaded) {
+            onLoadingError(path, err);
+        }
+        for (const auto & buffer : document.model.buffers) {
+            document.m_Buffers.push_back({ buffer.data.data(), buffer.data.size() });
+        }
+        if (imageLoader.defer)
+        {
+            document.m_EncodedImages = std::move(imageLoader.encodedImages);
+            document.m_EncodedImages.resize(document.model.images.size());
+        }
+        return document;
+    }
+
+    const auto file = std::make_shared<const MappedFile>(path);
+    const char * jsonBegin = reinterpret_cast<const char *>(file->data());
+    const char * jsonEnd = jsonBegin + file->size();
+    GltfDocument::BufferSpan binaryChunk;
+    if (isBinary)
+    {
+        // 12 bytes header followed by the JSON chunk and an optional binary chunk, each with a 8 bytes header
+        if (file->size() < 20 || readUint32(file->data()) != GlbMagic || readUint32(file->data() + 4) != 2) {
+            onLoadingError(path, "Not a glTF 2.0 binary file");
+        }
+        const auto fileSize = std::min(size_t(readUint32(file->data() + 8)), file->size());
+        const auto jsonSize = size_t(readUint32(file->data() + 12));
+        if (readUint32(file->data() + 16) != GlbJsonChunkType || 20 + jsonSize > fileSize) {
+            onLoadingError(path, "Invalid JSON chunk");
+        }
+        jsonBegin = reinterpret_cast<const char *>(file->data() + 20);
+        jsonEnd = jsonBegin + jsonSize;
+
+        const auto binaryChunkOffset = 20 + jsonSize;
+        if (binaryChunkOffset + 8 <= fileSize && readUint32(file->data() + binaryChunkOffset + 4) == GlbBinChunkType)
+        {
+            binaryChunk.data = file->data() + binaryChunkOffset + 8;
+            binaryChunk.byteSize = std::min(size_t(readUint32(file->data() + binaryChunkOffset)), fileSize - binaryChunkOffset - 8);
+        }
+    }
+
+    nlohmann::json json;
+    try {
+        json = nlohmann::json::parse(jsonBegin, jsonEnd);
+    }
+    catch (const std::exception & e) {
+        onLoadingError(path, e.what());
+    }
+
+    // Resolve each buffer to the binary chunk, a mapped .bin file or a decoded data URI.
+    // Fallback buffers of EXT_meshopt_compression are allocated, their buffer views are decoded below.
+    std::vector<std::string> bufferURIs;
+    std::vector<unsigned char *> fallbackBuffers;
+    auto emptyArray = nlohmann::json::array();
+    auto & buffers = json.count("buffers") ? json["buffers"] : emptyArray;
+    for (size_t i = 0; i < buffers.size(); ++i)
+    {
+        auto & buffer = buffers[i];
+        const auto byteLength = buffer.value("byteLength", size_t(0));
+        const auto uri = buffer.value("uri", std::string());
+        const auto meshoptExtension = findMeshoptExtension(buffer);
+        GltfDocument::BufferSpan span;
+        fallbackBuffers.push_back(nullptr);
+        if (meshoptExtension && meshoptExtension->value("fallback", false))
+        {
+            document.m_DecodedBuffers.emplace_back(byteLength);
+            fallbackBuffers.back() = document.m_DecodedBuffers.back().data();
+            span = { fallbackBuffers.back(), byteLength };
+        }
+        else if (uri.empty())
+        {
+            if (i != 0 || !binaryChunk.data || byteLength > binaryChunk.byteSize) {
+                onLoadingError(path, "Buffer " + std::to_string(i) + " has no uri and no matching binary chunk");
+            }
+            span = { binaryChunk.data, byteLength };
+        }
+        else if (uri.compare(0, 5, "data:") == 0)
+        {
+            const auto dataOffset = uri.find(";base64,");
+            document.m_DecodedBuffers.emplace_back();
+            auto & decoded = document.m_DecodedBuffers.back();
+            if (dataOffset == std::string::npos || !decodeBase64(uri.data() + dataOffset + 8, uri.data() + uri.size(), decoded) || decoded.size() < byteLength) {
+                onLoadingError(path, "Invalid data uri for buffer " + std::to_string(i));
+            }
+            span = { decoded.data(), byteLength };
+        }
+        else
+        {
+            const auto bufferFile = std::make_shared<const MappedFile>(baseDirectory / decodeURI(uri));
+            if (bufferFile->size() < byteLength) {
+                onLoadingError(path, "File " + uri + " is smaller than the byteLength of buffer " + std::to_string(i));
+            }
+            span = { bufferFile->data(), byteLength };
+            document.m_Files.emplace_back(bufferFile);
+        }
+        document.m_Buffers.push_back(span);
+        bufferURIs.push_back(uri.compare(0, 5, "data:") == 0 ? std::string() : uri);
+
+        buffer["uri"] = PlaceholderBufferURI;
+        buffer["byteLength"] = 1;
+    }
+    if (isBinary) {
+        document.m_Files.emplace_back(file);
+    }
+
+    auto & bufferViews = json.count("bufferViews") ? json["bufferViews"] : emptyArray;
+    std::vector<MeshoptBufferView> meshoptBufferViews;
+    for (size_t i = 0; i < bufferViews.size(); ++i)
+    {
+        const auto extension = findMeshoptExtension(bufferViews[i]);
+        if (!extension) {
+            continue;
+        }
+        const auto buffer = bufferViews[i].value("buffer", size_t(0));
+        const auto source = extension->value("buffer", size_t(0));
+        if (buffer >= fallbackBuffers.size() || source >= document.m_Buffers.size()) {
+            onLoadingError(path, "Invalid buffer for compressed buffer view " + std::to_string(i));
+        }
+        // Buffers with actual data hold the uncompressed fallback, nothing to decode
+        if (!fallbackBuffers[buffer]) {
+            continue;
+        }
+
+        MeshoptBufferView view;
+        view.count = extension->value("count", size_t(0));
+        view.byteStride = extension->value("byteStride", size_t(0));
+        const auto byteOffset = bufferViews[i].value("byteOffset", size_t(0));
+        const auto sourceOffset = extension->value("byteOffset", size_t(0));
+        view.sourceSize = extension->value("byteLength", size_t(0));
+        if (byteOffset + view.count * view.byteStride > document.m_Buffers[buffer].byteSize || sourceOffset + view.sourceSize > document.m_Buffers[source].byteSize) {
+            onLoadingError(path, "Compressed buffer view " + std::to_string(i) + " is out of its buffers");
+        }
+        view.destination = fallbackBuffers[buffer] + byteOffset;
+        view.source = document.m_Buffers[source].data + sourceOffset;
+        try
+        {
+            view.mode = parseMeshoptMode(extension->value("mode", std::string()));
+            view.filter = parseMeshoptFilter(extension->value("filter", std::string()));
+        }
+        catch (const std::exception & e) {
+            onLoadingError(path, e.what());
+        }
+        meshoptBufferViews.push_back(view);
+    }
+    // Views are decoded in parallel, each one writes its own part of the fallback buffer
+    try
+    {
+        parallelFor(meshoptBufferViews.size(), 1, [&](size_t begin, size_t end)
+        {
+            for (auto i = begin; i < end; ++i)
+            {
+                const auto & view = meshoptBufferViews[i];
+                decodeMeshoptBuffer(view.destination, view.count, view.byteStride, view.source, view.sourceSize, view.mode, view.filter);
+            }
+        });
+    }
+    catch (const std::exception & e) {
+        onLoadingError(path, e.what());
+    }
+
+    // Images stored in buffer views are redirected to a placeholder view in the first placeholder buffer.
+    // Deferred image files are redirected too, so that tinygltf does not read them.
+    std::vector<int> imageBufferViews;
+    std::vector<std::string> imageURIs;
+    const auto placeholderBufferView = int(bufferViews.size());
+    auto & images = json.count("images") ? json["images"] : emptyArray;
+    for (size_t i = 0; i < images.size(); ++i)
+    {
+        const auto bufferView = images[i].value("bufferView", -1);
+        const auto uri = images[i].value("uri", std::string());
+        imageBufferViews.push_back(bufferView);
+        imageURIs.push_back(uri);
+        imageLoader.encodedImages.emplace_back();
+        if (bufferView < 0)
+        {
+            if (imageLoader.defer && !uri.empty() && uri.compare(0, 5, "data:") != 0)
+            {
+                imageLoader.encodedImages.back().path = baseDirectory / decodeURI(uri);
+                images[i].erase("uri");
+                images[i]["bufferView"] = placeholderBufferView;
+            }
+            continue;
+        }
+        if (size_t(bufferView) >= bufferViews.size()) {
+            onLoadingError(path, "Invalid buffer view for image " + std::to_string(i));
+        }
+
+        const auto & view = bufferViews[bufferView];
+        auto & range = imageLoader.encodedImages.back().range;
+        range.buffer = view.value("buffer", size_t(0));
+        range.begin = view.value("byteOffset", size_t(0));
+        range.end = range.begin + view.value("byteLength", size_t(0));
+        if (range.buffer >= document.m_Buffers.size() || range.end > document.m_Buffers[range.buffer].byteSize) {
+            onLoadingError(path, "Buffer view of image " + std::to_string(i) + " is out of its buffer");
+        }
+        images[i]["bufferView"] = placeholderBufferView;
+    }
+    const auto hasPlaceholderBufferView = std::any_of(begin(images), end(images), [&](const nlohmann::json & image) { return image.value("bufferView", -1) == placeholderBufferView; });
+    if (hasPlaceholderBufferView) {
+        bufferViews.push_back({ { "buffer", 0 }, { "byteLength", 1 } });
+    }
+
+    const auto text = json.dump();
+    const auto loaded = loader.LoadASCIIFromString(&document.model, &err, &warn, text.c_str(), unsigned(text.size()), baseDirectory.string());
+    if (!warn.empty()) {
+        std::clog << "Warning: " << warn << std::endl;
+    }
+    if (!loaded) {
+        onLoadingError(path, err);
+    }
+
+    // Restore the buffers and buffer views replaced by placeholders
+    for (size_t i = 0; i < document.model.buffers.size(); ++i)
+    {
+        document.model.buffers[i].data = std::vector<unsigned char>();
+        document.model.buffers[i].uri = bufferURIs[i];
+    }
+    if (hasPlaceholderBufferView) {
+        document.model.bufferViews.pop_back();
+    }
+    for (size_t i = 0; i < document.model.images.size(); ++i)
+    {
+        document.model.images[i].bufferView = imageBufferViews[i];
+        document.model.images[i].uri = imageURIs[i].compare(0, 5, "data:") == 0 ? std::string() : imageURIs[i];
+    }
+    if (imageLoader.defer)
+    {
+        document.m_EncodedImages = std::move(imageLoader.encodedImages);
+        document.m_EncodedImages.resize(document.model.images.size());
+    }
+    return document;
+}
+
+void GltfDocument::decodeImage(size_t image)
+{
+    auto & gltfImage = model.images[image];
+    if (!gltfImage.image.empty() || image >= m_EncodedImages.size()) {
+        return;
+    }
+
+    const auto & encodedImage = m_EncodedImages[image];
+    MappedFile file;
+    const unsigned char * bytes = encodedImage.bytes.data();
+    auto size = encodedImage.bytes.size();
+    if (!encodedImage.path.empty())
+    {
+        file = MappedFile(encodedImage.path);
+        bytes = file.data();
+        size = file.size();
+    }
+    else if (encodedImage.range.end > encodedImage.range.begin)
+    {
+        bytes = bufferData(encodedImage.range.buffer) + encodedImage.range.begin;
+        size = encodedImage.range.end - encodedImage.range.begin;
+    }
+
+    std::string err;
+    std::string warn;
+    if (!size || !tinygltf::LoadImageData(&gltfImage, int(image), &err, &warn, 0, 0, bytes, int(size), nullptr))
+    {
+        std::cerr << "Unable to decode image " << image << " " << gltfImage.uri << ": " << err << std::endl;
+        throw std::runtime_error("Unable to decode image " + std::to_string(image));
+    }
+}
+
+GltfByteRange getAccessorByteRange(const tinygltf::Model & model, int accessor)
+{
+    GltfByteRange range;
+    const auto & gltfAccessor = model.accessors[accessor];
+    if (gltfAccessor.bufferView < 0) {
+        return range;
+    }
+
+    const auto & bufferView = model.bufferViews[gltfAccessor.bufferView];
+    const auto elementSize = size_t(tinygltf::GetComponentSizeInBytes(uint32_t(gltfAccessor.componentType)) * tinygltf::GetTypeSizeInBytes(uint32_t(gltfAccessor.type)));
+    const auto stride = bufferView.byteStride ? bufferView.byteStride : elementSize;
+    range.buffer = size_t(bufferView.buffer);
+    range.begin = bufferView.byteOffset + gltfAccessor.byteOffset;
+    range.end = gltfAccessor.count ? range.begin + stride * (gltfAccessor.count - 1) + elementSize : range.begin;
+    return range;
+}
+
+std::vector<float> readAccessorAsFloats(const GltfDocument & document, int accessor)
+{
+    const auto & gltfAccessor = document.model.accessors[accessor];
+    const auto componentCount = size_t(tinygltf::GetTypeSizeInBytes(uint32_t(gltfAccessor.type)));
+    std::vector<float> values(gltfAccessor.count * componentCount, 0.f);
+    const auto range = getAccessorByteRange(document.model, accessor);
+    if (range.end <= range.begin) {
+        return values;
+    }
+    if (range.buffer >= document.bufferCount() || range.end > document.bufferByteSize(range.buffer)) {
+        throw std::runtime_error("Accessor " + std::to_string(accessor) + " is out of its buffer");
+    }
+
+    const auto & bufferView = document.model.bufferViews[gltfAccessor.bufferView];
+    const auto componentSize = size_t(tinygltf::GetComponentSizeInBytes(uint32_t(gltfAccessor.componentType)));
+    const auto stride = bufferView.byteStride ? bufferView.byteStride : componentSize * componentCount;
+    const auto data = document.bufferData(range.buffer) + range.begin;
+    const auto normalized = gltfAccessor.normalized;
+    const auto read = [&](auto zero, float maxValue, float minValue)
+    {
+        using T = decltype(zero);
+        for (size_t i = 0; i < gltfAccessor.count; ++i)
+        {
+            for (size_t c = 0; c < componentCount; ++c)
+            {
+                T value;
+                std::memcpy(&value, data + i * stride + c * sizeof(T), sizeof(T));
+                values[i * componentCount + c] = normalized ? std::max(float(value) / maxValue, minValue) : float(value);
+            }
+        }
+    };
+    switch (gltfAccessor.componentType)
+    {
+    case TINYGLTF_COMPONENT_TYPE_FLOAT:
+        read(float(), 1.f, -std::numeric_limits<float>::max());
+        break;
+    case TINYGLTF_COMPONENT_TYPE_BYTE:
+        read(int8_t(), 127.f, -1.f);
+        break;
+    case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE:
+        read(uint8_t(), 255.f, 0.f);
+        break;
+    case TINYGLTF_COMPONENT_TYPE_SHORT:
+        read(int16_t(), 32767.f, -1.f);
+        break;
+    case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT:
+        read(uint16_t(), 65535.f, 0.f);
+        break;
+    case TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT:
+        read(uint32_t(), 4294967295.f, 0.f);
+        break;
+    default:
+        throw std::runtime_error("Unsupported component type for accessor " + std::to_string(accessor));
+    }
+    return values;
+}
+
+std::vector<GltfByteRange> mergeByteRanges(std::vector<GltfByteRange> ranges, size_t alignment)
+{
+    ranges.erase(std::remove_if(begin(ranges), end(ranges), [](const GltfByteRange & range) { return range.end <= range.begin; }), end(ranges));
+    for (auto & range : ranges) {
+        range.begin -= range.begin % alignment;
+    }
+    std::sort(begin(ranges), end(ranges), [](const GltfByteRange & lhs, const GltfByteRange & rhs)
+    {
+        return lhs.buffer < rhs.buffer || (lhs.buffer == rhs.buffer && lhs.begin < rhs.begin);
+    });
+
+    std::vector<GltfByteRange> merged;
+    for (const auto & range : ranges)
+    {
+        if (!merged.empty() && merged.back().buffer == range.buffer && range.begin <= merged.back().end) {
+            merged.back().end = std::max(merged.back().end, range.end);
+        }
+        else {
+            merged.push_back(range);
+        }
+    }
+    return merged;
+}
+
+}
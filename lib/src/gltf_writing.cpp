@@ -0,0 +1,308 @@
+#include <glmlv/gltf_writing.hpp>
+#include <glmlv/parallel.hpp>
+
+#include <json.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <numeric>
+#include <stdexcept>
+#include <unordered_map>
+
+namespace glmlv
+{
+
+namespace
+{
+
+const uint32_t GlbMagic = 0x46546C67; // "glTF"
+const uint32_t GlbJsonChunkType = 0x4E4F534A; // "JSON"
+const uint32_t GlbBinChunkType = 0x004E4942; // "BIN\0"
+
+const int GltfArrayBuffer = 34962;
+const int GltfElementArrayBuffer = 34963;
+const int GltfUnsignedShort = 5123;
+const int GltfUnsignedInt = 5125;
+const int GltfFloat = 5126;
+
+size_t alignTo4(size_t size)
+{
+    return (size + 3) & ~size_t(3);
+}
+
+// Vertices of a shape in first use order and its indices relative to them
+struct PackedShape
+{
+    std::vector<uint32_t> vertices; // In data.vertexBuffer
+    std::vector<uint32_t> indices;
+    glm::vec3 bboxMin = glm::vec3(std::numeric_limits<float>::max());
+    glm::vec3 bboxMax = glm::vec3(std::numeric_limits<float>::lowest());
+};
+
+PackedShape packShape(const SceneData & data, size_t indexOffset, size_t indexCount)
+{
+    PackedShape shape;
+    std::unordered_map<uint32_t, uint32_t> localIndices;
+    shape.indices.reserve(indexCount);
+    for (size_t i = 0; i < indexCount; ++i)
+    {
+        const auto index = data.indexBuffer[indexOffset + i];
+        const auto inserted = localIndices.emplace(index, uint32_t(shape.vertices.size()));
+        if (inserted.second)
+        {
+            shape.vertices.push_back(index);
+            shape.bboxMin = glm::min(shape.bboxMin, data.vertexBuffer[index].position);
+            shape.bboxMax = glm::max(shape.bboxMax, data.vertexBuffer[index].position);
+        }
+        shape.indices.push_back(inserted.first->second);
+    }
+    return shape;
+}
+
+bool isIdentity(const glm::mat4 & matrix)
+{
+    return matrix == glm::mat4(1);
+}
+
+void onWritingError(const fs::path & path, const std::string & message)
+{
+    std::cerr << "Unable to write glTF file " << path << ": " << message << std::endl;
+    throw std::runtime_error(message);
+}
+
+}
+
+void writeGlbScene(const SceneData & data, const fs::path & path)
+{
+    const auto indexCount = std::accumulate(begin(data.indexCountPerShape), end(data.indexCountPerShape), size_t(0));
+    if (indexCount && (data.vertexBuffer.empty() || data.indexBuffer.size() < indexCount)) {
+        onWritingError(path, "Vertices are split in streams or released");
+    }
+
+    // Shapes are packed in parallel, empty shapes are dropped
+    std::vector<size_t> indexOffsets(data.shapeCount, 0);
+    for (size_t i = 1; i < data.shapeCount; ++i) {
+        indexOffsets[i] = indexOffsets[i - 1] + data.indexCountPerShape[i - 1];
+    }
+    std::vector<PackedShape> shapes(data.shapeCount);
+    parallelFor(data.shapeCount, 1, [&](size_t begin, size_t end)
+    {
+        for (auto shape = begin; shape < end; ++shape) {
+            shapes[shape] = packShape(data, indexOffsets[shape], data.indexCountPerShape[shape] - data.indexCountPerShape[shape] % 3);
+        }
+    });
+
+    // Binary chunk: every vertex first in one interleaved buffer view, then the indices of each shape aligned to 4 bytes
+    size_t vertexCount = 0;
+    size_t indexByteSize = 0;
+    for (const auto & shape : shapes)
+    {
+        vertexCount += shape.vertices.size();
+        const auto indexSize = shape.vertices.size() <= std::numeric_limits<uint16_t>::max() ? sizeof(uint16_t) : sizeof(uint32_t);
+        indexByteSize += alignTo4(shape.indices.size() * indexSize);
+    }
+    const auto vertexByteSize = vertexCount * sizeof(Vertex3f3f2f);
+    std::vector<unsigned char> binary(vertexByteSize + indexByteSize, 0);
+
+    // Tangents follow the indices in a third buffer view
+    const auto writeTangents = !data.tangentBuffer.empty() && data.tangentBuffer.size() == data.vertexBuffer.size();
+    if (!data.tangentBuffer.empty() && !writeTangents) {
+        std::clog << "Warning: tangents do not match the vertices, they are not written to " << path << std::endl;
+    }
+    std::vector<glm::vec4> tangents(writeTangents ? vertexCount : 0);
+
+    nlohmann::json accessors = nlohmann::json::array();
+    nlohmann::json meshes = nlohmann::json::array();
+    nlohmann::json nodes = nlohmann::json::array();
+    nlohmann::json sceneNodes = nlohmann::json::array();
+    size_t vertexOffset = 0;
+    size_t indexByteOffset = vertexByteSize;
+    size_t instanceOffset = 0;
+    for (size_t i = 0; i < shapes.size(); ++i)
+    {
+        const auto & shape = shapes[i];
+        const auto instanceCount = i < data.instanceCountPerShape.size() ? data.instanceCountPerShape[i] : 1;
+        instanceOffset += instanceCount - 1;
+        if (shape.indices.empty()) {
+            continue;
+        }
+
+        // glTF texture coordinates start at the top of the image, scene textures are stored bottom up
+        auto vertices = reinterpret_cast<Vertex3f3f2f *>(binary.data()) + vertexOffset;
+        for (size_t v = 0; v < shape.vertices.size(); ++v)
+        {
+            vertices[v] = data.vertexBuffer[shape.vertices[v]];
+            vertices[v].texCoords.y = 1.f - vertices[v].texCoords.y;
+        }
+        // Flipping the texture coordinates flips the bitangents
+        for (size_t v = 0; v < shape.vertices.size() && writeTangents; ++v)
+        {
+            tangents[vertexOffset + v] = data.tangentBuffer[shape.vertices[v]];
+            tangents[vertexOffset + v].w = -tangents[vertexOffset + v].w;
+        }
+        const auto vertexByteOffset = vertexOffset * sizeof(Vertex3f3f2f);
+        const auto tangentByteOffset = vertexOffset * sizeof(glm::vec4);
+        const auto positionAccessor = accessors.size();
+        accessors.push_back({ { "bufferView", 0 }, { "byteOffset", vertexByteOffset }, { "componentType", GltfFloat }, { "count", shape.vertices.size() }, { "type", "VEC3" },
+            { "min", { shape.bboxMin.x, shape.bboxMin.y, shape.bboxMin.z } }, { "max", { shape.bboxMax.x, shape.bboxMax.y, shape.bboxMax.z } } });
+        accessors.push_back({ { "bufferView", 0 }, { "byteOffset", vertexByteOffset + offsetof(Vertex3f3f2f, normal) }, { "componentType", GltfFloat }, { "count", shape.vertices.size() }, { "type", "VEC3" } });
+        accessors.push_back({ { "bufferView", 0 }, { "byteOffset", vertexByteOffset + offsetof(Vertex3f3f2f, texCoords) }, { "componentType", GltfFloat }, { "count", shape.vertices.size() }, { "type", "VEC2" } });
+        vertexOffset += shape.vertices.size();
+
+        const auto shortIndices = shape.vertices.size() <= std::numeric_limits<uint16_t>::max();
+        if (shortIndices)
+        {
+            auto indices = reinterpret_cast<uint16_t *>(binary.data() + indexByteOffset);
+            std::transform(begin(shape.indices), end(shape.indices), indices, [](uint32_t index) { return uint16_t(index); });
+        }
+        else {
+            std::memcpy(binary.data() + indexByteOffset, shape.indices.data(), shape.indices.size() * sizeof(uint32_t));
+        }
+        accessors.push_back({ { "bufferView", 1 }, { "byteOffset", indexByteOffset - vertexByteSize }, { "componentType", shortIndices ? GltfUnsignedShort : GltfUnsignedInt },
+            { "count", shape.indices.size() }, { "type", "SCALAR" } });
+        indexByteOffset += alignTo4(shape.indices.size() * (shortIndices ? sizeof(uint16_t) : sizeof(uint32_t)));
+
+        nlohmann::json primitive = { { "attributes", { { "POSITION", positionAccessor }, { "NORMAL", positionAccessor + 1 }, { "TEXCOORD_0", positionAccessor + 2 } } },
+            { "indices", positionAccessor + 3 } };
+        if (writeTangents)
+        {
+            primitive["attributes"]["TANGENT"] = accessors.size();
+            accessors.push_back({ { "bufferView", 2 }, { "byteOffset", tangentByteOffset }, { "componentType", GltfFloat }, { "count", shape.vertices.size() }, { "type", "VEC4" } });
+        }
+        const auto material = i < data.materialIDPerShape.size() ? data.materialIDPerShape[i] : -1;
+        if (material >= 0 && size_t(material) < data.materials.size()) {
+            primitive["material"] = material;
+        }
+        // Instances are nodes sharing the mesh
+        for (size_t instance = 0; instance < instanceCount; ++instance)
+        {
+            nlohmann::json node = { { "mesh", meshes.size() } };
+            const auto & matrix = instance ? data.instanceMatrices[instanceOffset - instanceCount + instance] : data.localToWorldMatrixPerShape[i];
+            if (!isIdentity(matrix)) {
+                node["matrix"] = std::vector<float>(&matrix[0][0], &matrix[0][0] + 16);
+            }
+            sceneNodes.push_back(nodes.size());
+            nodes.push_back(node);
+        }
+        meshes.push_back({ { "primitives", { primitive } } });
+    }
+    if (nodes.empty()) {
+        onWritingError(path, "No triangle to write");
+    }
+    binary.resize(indexByteOffset);
+    const auto tangentBufferViewOffset = binary.size();
+    binary.insert(end(binary), reinterpret_cast<const unsigned char *>(tangents.data()), reinterpret_cast<const unsigned char *>(tangents.data() + tangents.size()));
+
+    // Diffuse and normal textures referenced by the materials, written top down as the files they come from
+    std::unordered_map<int32_t, size_t> gltfTexturePerTexture;
+    nlohmann::json images = nlohmann::json::array();
+    nlohmann::json textures = nlohmann::json::array();
+    std::vector<int32_t> writtenTextures;
+    for (const auto & material : data.materials)
+    {
+        writtenTextures.push_back(material.KdTextureId);
+        writtenTextures.push_back(material.normalTextureId);
+    }
+    for (const auto texture : writtenTextures)
+    {
+        if (texture < 0 || size_t(texture) >= data.textures.size() || gltfTexturePerTexture.count(texture)) {
+            continue;
+        }
+        if (!data.textures[texture].size())
+        {
+            std::clog << "Warning: texture " << texture << " is only available compressed, it is not written to " << path << std::endl;
+            continue;
+        }
+        // 8 bits images keep their channels (gray, gray with alpha, ...), float ones are converted
+        const auto & source = data.textures[texture];
+        const auto imagePath = path.parent_path() / (path.stem().string() + "_" + std::to_string(texture) + ".png");
+        if (source.format() == ImageFormat::R8 || source.format() == ImageFormat::RG8 || source.format() == ImageFormat::RGB8 || source.format() == ImageFormat::RGBA8)
+        {
+            auto image = source.clone();
+            image.flipY();
+            writeImage(image, imagePath);
+        }
+        else
+        {
+            auto image = source.toRGBA8();
+            image.flipY();
+            writeImage(image, imagePath);
+        }
+        gltfTexturePerTexture[texture] = textures.size();
+        textures.push_back({ { "source", images.size() } });
+        images.push_back({ { "uri", imagePath.filename().string() } });
+    }
+
+    // Inverse of the approximation of loadGltfScene: shininess = 2 / roughness^4 - 2
+    nlohmann::json materials = nlohmann::json::array();
+    for (const auto & material : data.materials)
+    {
+        const auto roughness = std::sqrt(std::sqrt(2.f / (std::max(material.shininess, 0.f) + 2.f)));
+        nlohmann::json pbr = { { "baseColorFactor", { material.Kd.r, material.Kd.g, material.Kd.b, 1.f } }, { "metallicFactor", 0.f }, { "roughnessFactor", roughness } };
+        const auto it = gltfTexturePerTexture.find(material.KdTextureId);
+        if (it != end(gltfTexturePerTexture)) {
+            pbr["baseColorTexture"] = { { "index", (*it).second } };
+        }
+        nlohmann::json gltfMaterial = { { "pbrMetallicRoughness", pbr } };
+        const auto normalIt = gltfTexturePerTexture.find(material.normalTextureId);
+        if (normalIt != end(gltfTexturePerTexture)) {
+            gltfMaterial["normalTexture"] = { { "index", (*normalIt).second } };
+        }
+        if (!material.name.empty()) {
+            gltfMaterial["name"] = material.name;
+        }
+        materials.push_back(gltfMaterial);
+    }
+
+    nlohmann::json json = {
+        { "asset", { { "version", "2.0" }, { "generator", "glmlv" } } },
+        { "scene", 0 },
+        { "scenes", { { { "nodes", sceneNodes } } } },
+        { "nodes", nodes },
+        { "meshes", meshes },
+        { "accessors", accessors },
+        { "bufferViews", {
+            { { "buffer", 0 }, { "byteOffset", 0 }, { "byteLength", vertexByteSize }, { "byteStride", sizeof(Vertex3f3f2f) }, { "target", GltfArrayBuffer } },
+            { { "buffer", 0 }, { "byteOffset", vertexByteSize }, { "byteLength", tangentBufferViewOffset - vertexByteSize }, { "target", GltfElementArrayBuffer } } } },
+        { "buffers", { { { "byteLength", binary.size() } } } }
+    };
+    if (writeTangents) {
+        json["bufferViews"].push_back({ { "buffer", 0 }, { "byteOffset", tangentBufferViewOffset }, { "byteLength", binary.size() - tangentBufferViewOffset }, { "target", GltfArrayBuffer } });
+    }
+    if (!materials.empty()) {
+        json["materials"] = materials;
+    }
+    if (!textures.empty())
+    {
+        json["textures"] = textures;
+        json["images"] = images;
+    }
+
+    // Chunks are padded to 4 bytes: spaces for the JSON, zeros for the binary data
+    auto jsonString = json.dump();
+    jsonString.resize(alignTo4(jsonString.size()), ' ');
+    const uint32_t header[] = {
+        GlbMagic, 2, uint32_t(12 + 8 + jsonString.size() + 8 + binary.size()),
+        uint32_t(jsonString.size()), GlbJsonChunkType
+    };
+    const uint32_t binaryChunkHeader[] = { uint32_t(binary.size()), GlbBinChunkType };
+
+    std::ofstream out(path.string(), std::ios::binary);
+    if (!out) {
+        onWritingError(path, "Unable to open file");
+    }
+    out.write(reinterpret_cast<const char *>(header), sizeof(header));
+    out.write(jsonString.data(), jsonString.size());
+    out.write(reinterpret_cast<const char *>(binaryChunkHeader), sizeof(binaryChunkHeader));
+    out.write(reinterpret_cast<const char *>(binary.data()), binary.size());
+    if (!out) {
+        onWritingError(path, "Write failed");
+    }
+}
+
+}
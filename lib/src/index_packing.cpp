@@ -0,0 +1,71 @@
+#include <glmlv/index_packing.hpp>
+#include <glmlv/parallel.hpp>
+
+#include <algorithm>
+#include <limits>
+
+namespace glmlv
+{
+
+PackedIndexBuffer packIndexBuffer(const SceneData & data)
+{
+    PackedIndexBuffer packed;
+    packed.byteOffsetPerShape.resize(data.shapeCount, 0);
+    packed.indexCountPerShape = data.indexCountPerShape;
+    packed.indexSizePerShape.resize(data.shapeCount, uint8_t(sizeof(uint32_t)));
+    packed.baseVertexPerShape.resize(data.shapeCount, 0);
+
+    std::vector<size_t> indexOffsets(data.shapeCount, 0);
+    for (size_t i = 1; i < data.shapeCount; ++i) {
+        indexOffsets[i] = indexOffsets[i - 1] + data.indexCountPerShape[i - 1];
+    }
+
+    // Vertex range of each shape, then byte ranges in shape order
+    parallelFor(data.shapeCount, 1, [&](size_t begin, size_t end)
+    {
+        for (auto shape = begin; shape < end; ++shape)
+        {
+            const auto indices = data.indexBuffer.data() + indexOffsets[shape];
+            const auto indexCount = data.indexCountPerShape[shape];
+            if (!indexCount) {
+                continue;
+            }
+            const auto range = std::minmax_element(indices, indices + indexCount);
+            packed.baseVertexPerShape[shape] = int32_t(*range.first);
+            if (*range.second - *range.first < std::numeric_limits<uint16_t>::max()) {
+                packed.indexSizePerShape[shape] = uint8_t(sizeof(uint16_t));
+            }
+        }
+    });
+    size_t byteSize = 0;
+    for (size_t shape = 0; shape < data.shapeCount; ++shape)
+    {
+        packed.byteOffsetPerShape[shape] = byteSize;
+        byteSize += (size_t(data.indexCountPerShape[shape]) * packed.indexSizePerShape[shape] + 3) & ~size_t(3);
+    }
+
+    packed.data.resize(byteSize, 0);
+    parallelFor(data.shapeCount, 1, [&](size_t begin, size_t end)
+    {
+        for (auto shape = begin; shape < end; ++shape)
+        {
+            const auto indices = data.indexBuffer.data() + indexOffsets[shape];
+            const auto indexCount = data.indexCountPerShape[shape];
+            const auto baseVertex = uint32_t(packed.baseVertexPerShape[shape]);
+            const auto output = packed.data.data() + packed.byteOffsetPerShape[shape];
+            if (packed.indexSizePerShape[shape] == sizeof(uint16_t))
+            {
+                const auto shortIndices = reinterpret_cast<uint16_t *>(output);
+                std::transform(indices, indices + indexCount, shortIndices, [&](uint32_t index) { return uint16_t(index - baseVertex); });
+            }
+            else
+            {
+                const auto longIndices = reinterpret_cast<uint32_t *>(output);
+                std::transform(indices, indices + indexCount, longIndices, [&](uint32_t index) { return index - baseVertex; });
+            }
+        }
+    });
+    return packed;
+}
+
+}
@@ -0,0 +1,311 @@
+#include <glmlv/memory_registry.hpp>
+#include <glmlv/CompressedImage2D.hpp>
+#include <glmlv/scene_loading.hpp>
+
+#include <glad/glad.h>
+#include <json.hpp>
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+#include <tuple>
+
+namespace glmlv
+{
+
+namespace
+{
+
+struct MemoryCounter
+{
+    size_t byteSize = 0;
+    size_t count = 0;
+};
+
+struct MemoryRegistry
+{
+    std::mutex mutex;
+    std::map<std::pair<MemoryDomain, std::string>, MemoryCounter> counters;
+    std::map<size_t, std::pair<std::string, std::function<std::vector<MemoryUsage>()>>> sources;
+    size_t nextSourceId = 1;
+};
+
+// Never destroyed, objects tracking their memory may be released during static destruction
+MemoryRegistry & getRegistry()
+{
+    static auto registry = new MemoryRegistry();
+    return *registry;
+}
+
+const char * getImageFormatName(ImageFormat format)
+{
+    switch (format)
+    {
+    case ImageFormat::R8:
+        return "R8";
+    case ImageFormat::RG8:
+        return "RG8";
+    case ImageFormat::RGB8:
+        return "RGB8";
+    case ImageFormat::RGBA8:
+        return "RGBA8";
+    case ImageFormat::R16F:
+        return "R16F";
+    case ImageFormat::RGBA16F:
+        return "RGBA16F";
+    case ImageFormat::RGBA32F:
+        return "RGBA32F";
+    }
+    return "Unknown";
+}
+
+template<typename T>
+MemoryUsage getVectorUsage(const std::string & name, const std::vector<T> & vector)
+{
+    MemoryUsage usage;
+    usage.category = name;
+    usage.byteSize = vector.capacity() * sizeof(T);
+    usage.count = vector.size();
+    return usage;
+}
+
+}
+
+void trackAllocation(MemoryDomain domain, const std::string & category, size_t byteSize)
+{
+    auto & registry = getRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    auto & counter = registry.counters[std::make_pair(domain, category)];
+    counter.byteSize += byteSize;
+    ++counter.count;
+}
+
+void trackRelease(MemoryDomain domain, const std::string & category, size_t byteSize)
+{
+    auto & registry = getRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    const auto it = registry.counters.find(std::make_pair(domain, category));
+    if (it == end(registry.counters) || it->second.byteSize < byteSize || !it->second.count)
+    {
+        std::clog << "Warning: release of untracked memory in " << category << std::endl;
+        return;
+    }
+    it->second.byteSize -= byteSize;
+    if (!--it->second.count) {
+        registry.counters.erase(it);
+    }
+}
+
+MemorySource::MemorySource(std::string name, std::function<std::vector<MemoryUsage>()> report)
+{
+    auto & registry = getRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    m_nId = registry.nextSourceId++;
+    registry.sources.emplace(m_nId, std::make_pair(std::move(name), std::move(report)));
+}
+
+MemorySource::~MemorySource()
+{
+    release();
+}
+
+MemorySource::MemorySource(MemorySource&& rvalue):
+    m_nId(rvalue.m_nId)
+{
+    rvalue.m_nId = 0;
+}
+
+MemorySource& MemorySource::operator =(MemorySource&& rvalue)
+{
+    if (this != &rvalue)
+    {
+        release();
+        m_nId = rvalue.m_nId;
+        rvalue.m_nId = 0;
+    }
+    return *this;
+}
+
+void MemorySource::release()
+{
+    if (m_nId)
+    {
+        auto & registry = getRegistry();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        registry.sources.erase(m_nId);
+    }
+}
+
+std::vector<MemoryUsage> collectMemoryUsage()
+{
+    std::vector<MemoryUsage> usages;
+    std::vector<std::pair<std::string, std::function<std::vector<MemoryUsage>()>>> sources;
+    {
+        auto & registry = getRegistry();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        for (const auto & counter : registry.counters)
+        {
+            MemoryUsage usage;
+            usage.domain = counter.first.first;
+            usage.category = counter.first.second;
+            usage.byteSize = counter.second.byteSize;
+            usage.count = counter.second.count;
+            usages.push_back(usage);
+        }
+        for (const auto & source : registry.sources) {
+            sources.push_back(source.second);
+        }
+    }
+
+    // Sources are called without the lock, they may allocate tracked memory
+    for (const auto & source : sources)
+    {
+        for (auto usage : source.second())
+        {
+            usage.category = source.first + "/" + usage.category;
+            usages.push_back(std::move(usage));
+        }
+    }
+    std::sort(begin(usages), end(usages), [](const MemoryUsage & lhs, const MemoryUsage & rhs)
+    {
+        return std::tie(lhs.domain, lhs.category) < std::tie(rhs.domain, rhs.category);
+    });
+    return usages;
+}
+
+size_t computeTotalByteSize(const std::vector<MemoryUsage> & usages, MemoryDomain domain)
+{
+    size_t byteSize = 0;
+    for (const auto & usage : usages)
+    {
+        if (usage.domain == domain) {
+            byteSize += usage.byteSize;
+        }
+    }
+    return byteSize;
+}
+
+std::vector<MemoryUsage> computeSceneMemoryUsage(const SceneData & data)
+{
+    std::vector<MemoryUsage> usages = {
+        getVectorUsage("vertexBuffer", data.vertexBuffer),
+        getVectorUsage("positionBuffer", data.positionBuffer),
+        getVectorUsage("normalBuffer", data.normalBuffer),
+        getVectorUsage("texCoordsBuffer", data.texCoordsBuffer),
+        getVectorUsage("tangentBuffer", data.tangentBuffer),
+        getVectorUsage("indexBuffer", data.indexBuffer),
+        getVectorUsage("indexCountPerShape", data.indexCountPerShape),
+        getVectorUsage("localToWorldMatrixPerShape", data.localToWorldMatrixPerShape),
+        getVectorUsage("materialIDPerShape", data.materialIDPerShape),
+        getVectorUsage("instanceCountPerShape", data.instanceCountPerShape),
+        getVectorUsage("instanceMatrices", data.instanceMatrices),
+        getVectorUsage("materials", data.materials)
+    };
+    usages.erase(std::remove_if(begin(usages), end(usages), [](const MemoryUsage & usage) { return !usage.byteSize; }), end(usages));
+
+    // Decoded textures by format, so that 32 bits float textures of 8 bits data stand out
+    std::map<std::string, MemoryUsage> textureUsages;
+    const auto addTexture = [&](const std::string & category, size_t byteSize)
+    {
+        auto & usage = textureUsages[category];
+        usage.category = category;
+        usage.byteSize += byteSize;
+        ++usage.count;
+    };
+    for (const auto & texture : data.textures)
+    {
+        if (texture.size()) {
+            addTexture("textures/" + std::string(getImageFormatName(texture.format())), texture.byteSize());
+        }
+    }
+    for (const auto & texture : data.compressedTextures)
+    {
+        if (texture.byteSize()) {
+            addTexture("compressedTextures/" + getGLInternalFormatName(getGLInternalFormat(texture.format())), texture.byteSize());
+        }
+    }
+    for (const auto & usage : textureUsages) {
+        usages.push_back(usage.second);
+    }
+    return usages;
+}
+
+void writeMemoryReport(const std::vector<MemoryUsage> & usages, std::ostream & output)
+{
+    nlohmann::json jsonUsages = nlohmann::json::array();
+    for (const auto & usage : usages)
+    {
+        jsonUsages.push_back({ { "domain", usage.domain == MemoryDomain::CPU ? "CPU" : "GPU" }, { "category", usage.category },
+            { "bytes", usage.byteSize }, { "count", usage.count } });
+    }
+    const nlohmann::json report = {
+        { "cpuBytes", computeTotalByteSize(usages, MemoryDomain::CPU) },
+        { "gpuBytes", computeTotalByteSize(usages, MemoryDomain::GPU) },
+        { "usages", jsonUsages }
+    };
+    output << report.dump(4) << std::endl;
+}
+
+void writeMemoryReport(const std::vector<MemoryUsage> & usages, const fs::path & path)
+{
+    std::ofstream output(path.string());
+    if (!output)
+    {
+        std::cerr << "Unable to write memory report " << path << std::endl;
+        throw std::runtime_error("Unable to write memory report " + path.string());
+    }
+    writeMemoryReport(usages, output);
+}
+
+std::string getGLInternalFormatName(unsigned int internalFormat)
+{
+    switch (internalFormat)
+    {
+#define GLMLV_FORMAT_NAME(format) case format: return #format;
+    GLMLV_FORMAT_NAME(GL_R8)
+    GLMLV_FORMAT_NAME(GL_RG8)
+    GLMLV_FORMAT_NAME(GL_RGB8)
+    GLMLV_FORMAT_NAME(GL_RGBA8)
+    GLMLV_FORMAT_NAME(GL_SRGB8)
+    GLMLV_FORMAT_NAME(GL_SRGB8_ALPHA8)
+    GLMLV_FORMAT_NAME(GL_R16F)
+    GLMLV_FORMAT_NAME(GL_RG16F)
+    GLMLV_FORMAT_NAME(GL_RGB16F)
+    GLMLV_FORMAT_NAME(GL_RGBA16F)
+    GLMLV_FORMAT_NAME(GL_R32F)
+    GLMLV_FORMAT_NAME(GL_RG32F)
+    GLMLV_FORMAT_NAME(GL_RGB32F)
+    GLMLV_FORMAT_NAME(GL_RGBA32F)
+    GLMLV_FORMAT_NAME(GL_R11F_G11F_B10F)
+    GLMLV_FORMAT_NAME(GL_RGB10_A2)
+    GLMLV_FORMAT_NAME(GL_DEPTH_COMPONENT16)
+    GLMLV_FORMAT_NAME(GL_DEPTH_COMPONENT24)
+    GLMLV_FORMAT_NAME(GL_DEPTH_COMPONENT32F)
+    GLMLV_FORMAT_NAME(GL_DEPTH24_STENCIL8)
+    GLMLV_FORMAT_NAME(GL_DEPTH32F_STENCIL8)
+    GLMLV_FORMAT_NAME(GL_COMPRESSED_RGB_S3TC_DXT1_EXT)
+    GLMLV_FORMAT_NAME(GL_COMPRESSED_SRGB_S3TC_DXT1_EXT)
+    GLMLV_FORMAT_NAME(GL_COMPRESSED_RGBA_S3TC_DXT5_EXT)
+    GLMLV_FORMAT_NAME(GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT)
+    GLMLV_FORMAT_NAME(GL_COMPRESSED_RED_RGTC1)
+    GLMLV_FORMAT_NAME(GL_COMPRESSED_RG_RGTC2)
+    GLMLV_FORMAT_NAME(GL_COMPRESSED_RGB8_ETC2)
+    GLMLV_FORMAT_NAME(GL_COMPRESSED_SRGB8_ETC2)
+    GLMLV_FORMAT_NAME(GL_COMPRESSED_RGBA8_ETC2_EAC)
+    GLMLV_FORMAT_NAME(GL_COMPRESSED_SRGB8_ALPHA8_ETC2_EAC)
+    GLMLV_FORMAT_NAME(GL_COMPRESSED_R11_EAC)
+    GLMLV_FORMAT_NAME(GL_COMPRESSED_RG11_EAC)
+    GLMLV_FORMAT_NAME(GL_COMPRESSED_RGBA_BPTC_UNORM)
+    GLMLV_FORMAT_NAME(GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM)
+#undef GLMLV_FORMAT_NAME
+    }
+    char name[16];
+    std::snprintf(name, sizeof(name), "0x%04X", internalFormat);
+    return name;
+}
+
+}
@@ -0,0 +1,298 @@
+#include <glmlv/meshlets.hpp>
+#include <glmlv/parallel.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <unordered_map>
+
+namespace glmlv
+{
+
+namespace
+{
+
+// Interleave the bits of 10 bits coordinates
+uint32_t mortonCode(const glm::vec3 & normalizedPosition)
+{
+    const auto spread = [](uint32_t x)
+    {
+        x = (x | (x << 16)) & 0x030000FF;
+        x = (x | (x << 8)) & 0x0300F00F;
+        x = (x | (x << 4)) & 0x030C30C3;
+        x = (x | (x << 2)) & 0x09249249;
+        return x;
+    };
+    const auto cell = glm::clamp(normalizedPosition * 1023.f, glm::vec3(0), glm::vec3(1023));
+    return spread(uint32_t(cell.x)) | (spread(uint32_t(cell.y)) << 1) | (spread(uint32_t(cell.z)) << 2);
+}
+
+struct ShapeMeshlets
+{
+    std::vector<Meshlet> meshlets;
+    std::vector<uint32_t> vertices;
+    std::vector<uint8_t> triangles;
+};
+
+// Bounding sphere of the vertices and normal cone of the triangles of the last meshlet of output
+void computeMeshletBounds(const SceneData & data, ShapeMeshlets & output)
+{
+    auto & meshlet = output.meshlets.back();
+    const auto vertices = output.vertices.data() + meshlet.vertexOffset;
+    const auto triangles = output.triangles.data() + 3 * size_t(meshlet.triangleOffset);
+
+    glm::vec3 bboxMin(std::numeric_limits<float>::max()), bboxMax(std::numeric_limits<float>::lowest());
+    for (size_t v = 0; v < meshlet.vertexCount; ++v)
+    {
+        bboxMin = glm::min(bboxMin, data.vertexBuffer[vertices[v]].position);
+        bboxMax = glm::max(bboxMax, data.vertexBuffer[vertices[v]].position);
+    }
+    meshlet.center = 0.5f * (bboxMin + bboxMax);
+    meshlet.radius = 0.f;
+    for (size_t v = 0; v < meshlet.vertexCount; ++v) {
+        meshlet.radius = std::max(meshlet.radius, glm::distance(meshlet.center, data.vertexBuffer[vertices[v]].position));
+    }
+
+    // The cone is too wide when a triangle is at more than ~84 degrees from the average normal
+    std::vector<glm::vec3> normals;
+    normals.reserve(meshlet.triangleCount);
+    glm::vec3 axis(0);
+    for (size_t t = 0; t < meshlet.triangleCount; ++t)
+    {
+        const auto & p0 = data.vertexBuffer[vertices[triangles[3 * t]]].position;
+        const auto & p1 = data.vertexBuffer[vertices[triangles[3 * t + 1]]].position;
+        const auto & p2 = data.vertexBuffer[vertices[triangles[3 * t + 2]]].position;
+        const auto normal = glm::cross(p1 - p0, p2 - p0);
+        const auto length = glm::length(normal);
+        if (length > 0.f)
+        {
+            normals.push_back(normal / length);
+            axis += normals.back();
+        }
+    }
+    const auto axisLength = glm::length(axis);
+    meshlet.coneAxis = glm::vec3(0);
+    meshlet.coneCutoff = 1.f;
+    if (axisLength <= 0.f) {
+        return;
+    }
+    axis /= axisLength;
+    auto minDot = 1.f;
+    for (const auto & normal : normals) {
+        minDot = std::min(minDot, glm::dot(axis, normal));
+    }
+    if (minDot > 0.1f)
+    {
+        meshlet.coneAxis = axis;
+        meshlet.coneCutoff = std::sqrt(1.f - minDot * minDot);
+    }
+}
+
+ShapeMeshlets buildShapeMeshlets(const SceneData & data, const uint32_t * indices, size_t triangleCount, size_t maxVertices, size_t maxTriangles)
+{
+    ShapeMeshlets output;
+    if (!triangleCount) {
+        return output;
+    }
+
+    // Local vertex ids and the triangles of each vertex in compressed rows
+    std::unordered_map<uint32_t, uint32_t> localIdMap;
+    std::vector<uint32_t> localIndices(3 * triangleCount);
+    std::vector<uint32_t> vertexIds;
+    for (size_t i = 0; i < 3 * triangleCount; ++i)
+    {
+        const auto inserted = localIdMap.emplace(indices[i], uint32_t(vertexIds.size()));
+        if (inserted.second) {
+            vertexIds.push_back(indices[i]);
+        }
+        localIndices[i] = inserted.first->second;
+    }
+    const auto vertexCount = vertexIds.size();
+    std::vector<uint32_t> triangleOffsets(vertexCount + 1, 0);
+    for (const auto index : localIndices) {
+        ++triangleOffsets[index + 1];
+    }
+    for (size_t v = 0; v < vertexCount; ++v) {
+        triangleOffsets[v + 1] += triangleOffsets[v];
+    }
+    std::vector<uint32_t> trianglesPerVertex(3 * triangleCount);
+    {
+        auto next = triangleOffsets;
+        for (size_t i = 0; i < 3 * triangleCount; ++i) {
+            trianglesPerVertex[next[localIndices[i]]++] = uint32_t(i / 3);
+        }
+    }
+
+    // Seeds in Morton order of the triangle centroids
+    std::vector<glm::vec3> centroids(triangleCount);
+    glm::vec3 bboxMin(std::numeric_limits<float>::max()), bboxMax(std::numeric_limits<float>::lowest());
+    for (size_t t = 0; t < triangleCount; ++t)
+    {
+        centroids[t] = (data.vertexBuffer[indices[3 * t]].position + data.vertexBuffer[indices[3 * t + 1]].position + data.vertexBuffer[indices[3 * t + 2]].position) / 3.f;
+        bboxMin = glm::min(bboxMin, centroids[t]);
+        bboxMax = glm::max(bboxMax, centroids[t]);
+    }
+    const auto extent = glm::max(bboxMax - bboxMin, glm::vec3(1e-20f));
+    std::vector<std::pair<uint32_t, uint32_t>> seeds(triangleCount);
+    for (size_t t = 0; t < triangleCount; ++t) {
+        seeds[t] = std::make_pair(mortonCode((centroids[t] - bboxMin) / extent), uint32_t(t));
+    }
+    std::sort(begin(seeds), end(seeds));
+
+    std::vector<bool> emitted(triangleCount, false);
+    std::vector<uint32_t> remainingTriangles(vertexCount);
+    for (size_t v = 0; v < vertexCount; ++v) {
+        remainingTriangles[v] = triangleOffsets[v + 1] - triangleOffsets[v];
+    }
+    std::vector<int> meshletVertexIds(vertexCount, -1); // Index of the vertex in the current meshlet
+    std::vector<uint32_t> candidates;
+    std::vector<uint32_t> meshletVertices; // Local ids of the vertices of the current meshlet
+    size_t nextSeed = 0;
+    size_t emittedCount = 0;
+    while (emittedCount < triangleCount)
+    {
+        output.meshlets.emplace_back();
+        auto & meshlet = output.meshlets.back();
+        meshlet.vertexOffset = uint32_t(output.vertices.size());
+        meshlet.triangleOffset = uint32_t(output.triangles.size() / 3);
+        glm::vec3 centroidSum(0);
+        meshletVertices.clear();
+
+        // Seed next to the previous meshlet at its most isolated triangle, so that no small islands of triangles are left behind.
+        // Morton order when the previous meshlet has no neighbor left.
+        auto triangle = uint32_t(triangleCount);
+        auto bestRemaining = std::numeric_limits<uint32_t>::max();
+        for (const auto t : candidates)
+        {
+            const auto remaining = remainingTriangles[localIndices[3 * t]] + remainingTriangles[localIndices[3 * t + 1]] + remainingTriangles[localIndices[3 * t + 2]];
+            if (!emitted[t] && remaining < bestRemaining)
+            {
+                bestRemaining = remaining;
+                triangle = t;
+            }
+        }
+        candidates.clear();
+        if (triangle == triangleCount)
+        {
+            while (nextSeed < triangleCount && emitted[seeds[nextSeed].second]) {
+                ++nextSeed;
+            }
+            triangle = seeds[nextSeed].second;
+        }
+        while (true)
+        {
+            // Add the triangle and its neighbors as candidates
+            emitted[triangle] = true;
+            ++emittedCount;
+            for (size_t c = 0; c < 3; ++c)
+            {
+                const auto v = localIndices[3 * triangle + c];
+                --remainingTriangles[v];
+                if (meshletVertexIds[v] < 0)
+                {
+                    meshletVertexIds[v] = int(meshlet.vertexCount++);
+                    meshletVertices.push_back(v);
+                    output.vertices.push_back(vertexIds[v]);
+                    for (auto i = triangleOffsets[v]; i < triangleOffsets[v + 1]; ++i)
+                    {
+                        if (!emitted[trianglesPerVertex[i]]) {
+                            candidates.push_back(trianglesPerVertex[i]);
+                        }
+                    }
+                }
+                output.triangles.push_back(uint8_t(meshletVertexIds[v]));
+            }
+            ++meshlet.triangleCount;
+            centroidSum += centroids[triangle];
+            if (meshlet.triangleCount >= maxTriangles) {
+                break;
+            }
+
+            // Best candidate: fewest new vertices (none for the last triangle of a vertex), then closest to the center of the meshlet
+            const auto center = centroidSum / float(meshlet.triangleCount);
+            auto bestPriority = 4u;
+            auto bestDistance = std::numeric_limits<float>::max();
+            auto best = uint32_t(triangleCount);
+            for (size_t i = 0; i < candidates.size(); ++i)
+            {
+                const auto t = candidates[i];
+                if (emitted[t])
+                {
+                    candidates[i--] = candidates.back(); // Remove candidates added by several vertices once emitted
+                    candidates.pop_back();
+                    continue;
+                }
+                auto newVertices = 0u;
+                auto closesVertex = false; // Last triangle of a vertex of the meshlet, that would be left alone otherwise
+                for (size_t c = 0; c < 3; ++c)
+                {
+                    const auto v = localIndices[3 * t + c];
+                    newVertices += meshletVertexIds[v] < 0 ? 1 : 0;
+                    closesVertex = closesVertex || (meshletVertexIds[v] >= 0 && remainingTriangles[v] == 1);
+                }
+                if (meshlet.vertexCount + newVertices > maxVertices) {
+                    continue;
+                }
+                const auto priority = closesVertex ? 0u : newVertices;
+                const auto distance = glm::distance(center, centroids[t]);
+                if (priority < bestPriority || (priority == bestPriority && distance < bestDistance))
+                {
+                    bestPriority = priority;
+                    bestDistance = distance;
+                    best = t;
+                }
+            }
+            if (best == triangleCount) {
+                break;
+            }
+            triangle = best;
+        }
+
+        for (const auto v : meshletVertices) {
+            meshletVertexIds[v] = -1;
+        }
+        computeMeshletBounds(data, output);
+    }
+    return output;
+}
+
+}
+
+SceneMeshlets buildMeshlets(const SceneData & data, size_t maxVertices, size_t maxTriangles)
+{
+    maxVertices = glm::clamp(maxVertices, size_t(3), size_t(256)); // Local indices are 8 bits
+    maxTriangles = std::max(maxTriangles, size_t(1));
+
+    std::vector<size_t> indexOffsets(data.shapeCount, 0);
+    for (size_t i = 1; i < data.shapeCount; ++i) {
+        indexOffsets[i] = indexOffsets[i - 1] + data.indexCountPerShape[i - 1];
+    }
+    std::vector<ShapeMeshlets> meshletsPerShape(data.shapeCount);
+    parallelFor(data.shapeCount, 1, [&](size_t begin, size_t end)
+    {
+        for (auto shape = begin; shape < end; ++shape) {
+            meshletsPerShape[shape] = buildShapeMeshlets(data, data.indexBuffer.data() + indexOffsets[shape], data.indexCountPerShape[shape] / 3, maxVertices, maxTriangles);
+        }
+    });
+
+    SceneMeshlets result;
+    for (auto & shapeMeshlets : meshletsPerShape)
+    {
+        const auto vertexOffset = uint32_t(result.vertices.size());
+        const auto triangleOffset = uint32_t(result.triangles.size() / 3);
+        result.meshletOffsetPerShape.push_back(uint32_t(result.meshlets.size()));
+        result.meshletCountPerShape.push_back(uint32_t(shapeMeshlets.meshlets.size()));
+        for (auto meshlet : shapeMeshlets.meshlets)
+        {
+            meshlet.vertexOffset += vertexOffset;
+            meshlet.triangleOffset += triangleOffset;
+            result.meshlets.push_back(meshlet);
+        }
+        result.vertices.insert(end(result.vertices), begin(shapeMeshlets.vertices), end(shapeMeshlets.vertices));
+        result.triangles.insert(end(result.triangles), begin(shapeMeshlets.triangles), end(shapeMeshlets.triangles));
+        shapeMeshlets = ShapeMeshlets();
+    }
+    return result;
+}
+
+}
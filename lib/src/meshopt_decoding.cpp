@@ -0,0 +1,480 @@
+#include <glmlv/meshopt_decoding.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+
+namespace glmlv
+{
+
+namespace
+{
+
+const unsigned char VertexHeader = 0xA0;
+const unsigned char TrianglesHeader = 0xE0;
+const unsigned char IndicesHeader = 0xD0;
+
+const size_t ByteGroupSize = 16;
+const size_t ByteGroupDecodeLimit = 24; // Maximum size of an encoded byte group, the tail makes reading it always safe
+const size_t VertexBlockSizeBytes = 8192;
+const size_t VertexBlockMaxSize = 256;
+const size_t VertexTailMaxSize = 32;
+
+void onDecodingError(const std::string & message)
+{
+    throw std::runtime_error("Invalid meshopt data: " + message);
+}
+
+size_t getVertexBlockSize(size_t byteStride)
+{
+    auto result = VertexBlockSizeBytes / byteStride;
+    result &= ~(ByteGroupSize - 1);
+    return std::min(result, VertexBlockMaxSize);
+}
+
+unsigned char unzigzag8(unsigned char value)
+{
+    return (unsigned char)(-(value & 1) ^ (value >> 1));
+}
+
+// 16 values of 0, 2, 4 or 8 bits. 2 and 4 bits values equal to their maximum are followed by a full byte.
+const unsigned char * decodeBytesGroup(const unsigned char * data, unsigned char * buffer, int bitsLog2)
+{
+    if (bitsLog2 == 0)
+    {
+        std::memset(buffer, 0, ByteGroupSize);
+        return data;
+    }
+    if (bitsLog2 == 3)
+    {
+        std::memcpy(buffer, data, ByteGroupSize);
+        return data + ByteGroupSize;
+    }
+
+    const int bits = bitsLog2 == 1 ? 2 : 4;
+    const unsigned sentinel = (1u << bits) - 1;
+    const size_t packedSize = ByteGroupSize * bits / 8;
+    auto extra = data + packedSize;
+    for (size_t i = 0; i < packedSize; ++i)
+    {
+        unsigned byte = data[i];
+        for (int j = 0; j < 8 / bits; ++j)
+        {
+            const auto value = (byte >> (8 - bits)) & sentinel;
+            byte <<= bits;
+            *buffer++ = value == sentinel ? *extra++ : (unsigned char) value;
+        }
+    }
+    return extra;
+}
+
+const unsigned char * decodeBytes(const unsigned char * data, const unsigned char * dataEnd, unsigned char * buffer, size_t bufferSize)
+{
+    // 2 bits per group in the header
+    const auto headerSize = (bufferSize / ByteGroupSize + 3) / 4;
+    if (size_t(dataEnd - data) < headerSize) {
+        onDecodingError("truncated vertex block");
+    }
+    const auto header = data;
+    data += headerSize;
+    for (size_t i = 0; i < bufferSize; i += ByteGroupSize)
+    {
+        if (size_t(dataEnd - data) < ByteGroupDecodeLimit) {
+            onDecodingError("truncated vertex block");
+        }
+        const auto group = i / ByteGroupSize;
+        const auto bitsLog2 = (header[group / 4] >> ((group % 4) * 2)) & 3;
+        data = decodeBytesGroup(data, buffer + i, bitsLog2);
+    }
+    return data;
+}
+
+// Each byte of the elements is stored as a separate stream of deltas with the previous element
+const unsigned char * decodeVertexBlock(const unsigned char * data, const unsigned char * dataEnd, unsigned char * destination,
+    size_t count, size_t byteStride, unsigned char * lastVertex)
+{
+    unsigned char buffer[VertexBlockMaxSize];
+    const auto alignedCount = (count + ByteGroupSize - 1) & ~(ByteGroupSize - 1);
+    for (size_t k = 0; k < byteStride; ++k)
+    {
+        data = decodeBytes(data, dataEnd, buffer, alignedCount);
+        auto previous = lastVertex[k];
+        for (size_t i = 0; i < count; ++i)
+        {
+            previous = (unsigned char)(previous + unzigzag8(buffer[i]));
+            destination[i * byteStride + k] = previous;
+        }
+    }
+    std::memcpy(lastVertex, destination + byteStride * (count - 1), byteStride);
+    return data;
+}
+
+void decodeVertexBuffer(unsigned char * destination, size_t count, size_t byteStride, const unsigned char * source, size_t sourceSize)
+{
+    if (byteStride == 0 || byteStride > 256 || byteStride % 4) {
+        onDecodingError("attributes byteStride must be a multiple of 4 lower than 256");
+    }
+    if (sourceSize < 1 || (source[0] & 0xF0) != VertexHeader || (source[0] & 0x0F) > 0) {
+        onDecodingError("unsupported vertex codec header");
+    }
+
+    // The tail holds the first reference element, padded to 32 bytes
+    const auto tailSize = std::max(byteStride, VertexTailMaxSize);
+    auto data = source + 1;
+    const auto dataEnd = source + sourceSize;
+    if (size_t(dataEnd - data) < tailSize) {
+        onDecodingError("truncated vertex data");
+    }
+    unsigned char lastVertex[256];
+    std::memcpy(lastVertex, dataEnd - byteStride, byteStride);
+
+    const auto blockSize = getVertexBlockSize(byteStride);
+    for (size_t offset = 0; offset < count; offset += blockSize)
+    {
+        const auto blockCount = std::min(blockSize, count - offset);
+        data = decodeVertexBlock(data, dataEnd, destination + offset * byteStride, blockCount, byteStride, lastVertex);
+    }
+    if (size_t(dataEnd - data) != tailSize) {
+        onDecodingError("unexpected vertex data size");
+    }
+}
+
+// Variable length integer, 7 bits per byte, little endian
+uint32_t decodeVByte(const unsigned char *& data)
+{
+    const unsigned char lead = *data++;
+    if (lead < 128) {
+        return lead;
+    }
+    uint32_t result = lead & 127;
+    uint32_t shift = 7;
+    for (int i = 0; i < 4; ++i)
+    {
+        const unsigned char group = *data++;
+        result |= uint32_t(group & 127) << shift;
+        shift += 7;
+        if (group < 128) {
+            break;
+        }
+    }
+    return result;
+}
+
+uint32_t decodeIndex(const unsigned char *& data, uint32_t last)
+{
+    const auto value = decodeVByte(data);
+    return last + ((value >> 1) ^ uint32_t(-int32_t(value & 1)));
+}
+
+void writeIndex(unsigned char * destination, size_t i, size_t indexSize, uint32_t index)
+{
+    if (indexSize == 2) {
+        const auto value = uint16_t(index);
+        std::memcpy(destination + i * 2, &value, 2);
+    }
+    else {
+        std::memcpy(destination + i * 4, &index, 4);
+    }
+}
+
+// FIFOs of recently seen edges and vertices, indexed modulo 16
+struct IndexCaches
+{
+    uint32_t edges[16][2];
+    uint32_t vertices[16];
+    size_t edgeOffset = 0;
+    size_t vertexOffset = 0;
+
+    IndexCaches()
+    {
+        std::memset(edges, -1, sizeof(edges));
+        std::memset(vertices, -1, sizeof(vertices));
+    }
+
+    void pushEdge(uint32_t a, uint32_t b)
+    {
+        edges[edgeOffset][0] = a;
+        edges[edgeOffset][1] = b;
+        edgeOffset = (edgeOffset + 1) & 15;
+    }
+
+    void pushVertex(uint32_t v, bool condition = true)
+    {
+        vertices[vertexOffset] = v;
+        vertexOffset = (vertexOffset + (condition ? 1 : 0)) & 15;
+    }
+};
+
+void decodeTriangles(unsigned char * destination, size_t indexCount, size_t indexSize, const unsigned char * source, size_t sourceSize)
+{
+    if (indexCount % 3) {
+        onDecodingError("triangles count must be a multiple of 3");
+    }
+    // Header, one code per triangle and a 16 bytes table of auxiliary codes
+    if (sourceSize < 1 + indexCount / 3 + 16) {
+        onDecodingError("truncated triangles data");
+    }
+    const auto version = source[0] & 0x0F;
+    if ((source[0] & 0xF0) != TrianglesHeader || version > 1) {
+        onDecodingError("unsupported index codec header");
+    }
+
+    IndexCaches caches;
+    uint32_t next = 0;
+    uint32_t last = 0;
+    const int maxCachedVertex = version >= 1 ? 13 : 15;
+
+    auto code = source + 1;
+    auto data = code + indexCount / 3;
+    const auto dataSafeEnd = source + sourceSize - 16;
+    const auto codeAuxTable = dataSafeEnd;
+
+    for (size_t i = 0; i < indexCount; i += 3)
+    {
+        // A triangle reads at most 16 bytes of data, the auxiliary table makes it safe
+        if (data > dataSafeEnd) {
+            onDecodingError("truncated triangles data");
+        }
+        const auto codeTri = *code++;
+        uint32_t a, b, c;
+        if (codeTri < 0xF0)
+        {
+            // Edge from the cache and a new, cached or explicit third vertex
+            const auto edge = caches.edges[(caches.edgeOffset - 1 - (codeTri >> 4)) & 15];
+            a = edge[0];
+            b = edge[1];
+            const int fec = codeTri & 15;
+            if (fec < maxCachedVertex)
+            {
+                c = fec == 0 ? next++ : caches.vertices[(caches.vertexOffset - 1 - fec) & 15];
+                caches.pushVertex(c, fec == 0);
+            }
+            else
+            {
+                // 13 and 14 are deltas of -1 and 1 with the last explicit index
+                last = c = fec != 15 ? last + (fec - (fec ^ 3)) : decodeIndex(data, last);
+                caches.pushVertex(c);
+            }
+            caches.pushEdge(c, b);
+            caches.pushEdge(a, c);
+        }
+        else
+        {
+            int fea, feb, fec;
+            if (codeTri < 0xFE)
+            {
+                const auto codeAux = codeAuxTable[codeTri & 15];
+                fea = 0;
+                feb = codeAux >> 4;
+                fec = codeAux & 15;
+            }
+            else
+            {
+                const auto codeAux = *data++;
+                if (codeAux == 0) {
+                    next = 0;
+                }
+                fea = codeTri == 0xFE ? 0 : 15;
+                feb = codeAux >> 4;
+                fec = codeAux & 15;
+            }
+            // New vertices take the next index before explicit ones are decoded, in the order of the encoder
+            a = fea == 0 ? next++ : 0;
+            b = feb == 0 ? next++ : caches.vertices[(caches.vertexOffset - feb) & 15];
+            c = fec == 0 ? next++ : caches.vertices[(caches.vertexOffset - fec) & 15];
+            if (fea == 15) {
+                last = a = decodeIndex(data, last);
+            }
+            if (feb == 15) {
+                last = b = decodeIndex(data, last);
+            }
+            if (fec == 15) {
+                last = c = decodeIndex(data, last);
+            }
+            caches.pushVertex(a);
+            caches.pushVertex(b, feb == 0 || feb == 15);
+            caches.pushVertex(c, fec == 0 || fec == 15);
+            caches.pushEdge(b, a);
+            caches.pushEdge(c, b);
+            caches.pushEdge(a, c);
+        }
+        writeIndex(destination, i + 0, indexSize, a);
+        writeIndex(destination, i + 1, indexSize, b);
+        writeIndex(destination, i + 2, indexSize, c);
+    }
+    if (data != dataSafeEnd) {
+        onDecodingError("unexpected triangles data size");
+    }
+}
+
+void decodeIndexSequence(unsigned char * destination, size_t indexCount, size_t indexSize, const unsigned char * source, size_t sourceSize)
+{
+    // Header, at least one byte per index and a 4 bytes tail
+    if (sourceSize < 1 + indexCount + 4) {
+        onDecodingError("truncated indices data");
+    }
+    if ((source[0] & 0xF0) != IndicesHeader || (source[0] & 0x0F) > 1) {
+        onDecodingError("unsupported index sequence header");
+    }
+
+    auto data = source + 1;
+    const auto dataSafeEnd = source + sourceSize - 4;
+    uint32_t last[2] = { 0, 0 };
+    for (size_t i = 0; i < indexCount; ++i)
+    {
+        if (data >= dataSafeEnd) {
+            onDecodingError("truncated indices data");
+        }
+        // Lowest bit selects one of two baselines, the rest is a zigzag delta with it
+        auto value = decodeVByte(data);
+        const auto baseline = value & 1;
+        value >>= 1;
+        last[baseline] += (value >> 1) ^ uint32_t(-int32_t(value & 1));
+        writeIndex(destination, i, indexSize, last[baseline]);
+    }
+    if (data != dataSafeEnd) {
+        onDecodingError("unexpected indices data size");
+    }
+}
+
+template<typename T>
+void decodeOctahedralFilter(T * data, size_t count)
+{
+    const float maxValue = float((1 << (sizeof(T) * 8 - 1)) - 1);
+    for (size_t i = 0; i < count; ++i)
+    {
+        // The third component holds the encoding of 1, giving z = 1 - |x| - |y|
+        auto x = float(data[i * 4 + 0]);
+        auto y = float(data[i * 4 + 1]);
+        const auto z = float(data[i * 4 + 2]) - std::fabs(x) - std::fabs(y);
+
+        // Unfold the lower hemisphere
+        const auto t = std::min(z, 0.f);
+        x += x >= 0.f ? t : -t;
+        y += y >= 0.f ? t : -t;
+
+        const auto scale = maxValue / std::sqrt(x * x + y * y + z * z);
+        data[i * 4 + 0] = T(std::lround(x * scale));
+        data[i * 4 + 1] = T(std::lround(y * scale));
+        data[i * 4 + 2] = T(std::lround(z * scale));
+    }
+}
+
+void decodeQuaternionFilter(int16_t * data, size_t count)
+{
+    const auto scale = 1.f / std::sqrt(2.f);
+    for (size_t i = 0; i < count; ++i)
+    {
+        // The 4th component holds the index of the largest component in its 2 lowest bits, and the scale of the others
+        const auto scaleFactor = scale / float(data[i * 4 + 3] | 3);
+        const auto x = float(data[i * 4 + 0]) * scaleFactor;
+        const auto y = float(data[i * 4 + 1]) * scaleFactor;
+        const auto z = float(data[i * 4 + 2]) * scaleFactor;
+        const auto w = std::sqrt(std::max(0.f, 1.f - x * x - y * y - z * z));
+
+        const auto largest = data[i * 4 + 3] & 3;
+        data[i * 4 + ((largest + 1) & 3)] = int16_t(std::lround(x * 32767.f));
+        data[i * 4 + ((largest + 2) & 3)] = int16_t(std::lround(y * 32767.f));
+        data[i * 4 + ((largest + 3) & 3)] = int16_t(std::lround(z * 32767.f));
+        data[i * 4 + ((largest + 0) & 3)] = int16_t(std::lround(w * 32767.f));
+    }
+}
+
+void decodeExponentialFilter(uint32_t * data, size_t count)
+{
+    for (size_t i = 0; i < count; ++i)
+    {
+        const auto mantissa = int32_t(data[i] << 8) >> 8;
+        const auto exponent = int32_t(data[i]) >> 24;
+        const auto value = std::ldexp(float(mantissa), exponent);
+        std::memcpy(&data[i], &value, sizeof(value));
+    }
+}
+
+}
+
+MeshoptMode parseMeshoptMode(const std::string & mode)
+{
+    if (mode == "ATTRIBUTES") {
+        return MeshoptMode::Attributes;
+    }
+    if (mode == "TRIANGLES") {
+        return MeshoptMode::Triangles;
+    }
+    if (mode == "INDICES") {
+        return MeshoptMode::Indices;
+    }
+    throw std::runtime_error("Unknown meshopt mode " + mode);
+}
+
+MeshoptFilter parseMeshoptFilter(const std::string & filter)
+{
+    if (filter.empty() || filter == "NONE") {
+        return MeshoptFilter::None;
+    }
+    if (filter == "OCTAHEDRAL") {
+        return MeshoptFilter::Octahedral;
+    }
+    if (filter == "QUATERNION") {
+        return MeshoptFilter::Quaternion;
+    }
+    if (filter == "EXPONENTIAL") {
+        return MeshoptFilter::Exponential;
+    }
+    throw std::runtime_error("Unknown meshopt filter " + filter);
+}
+
+void decodeMeshoptBuffer(unsigned char * destination, size_t count, size_t byteStride, const unsigned char * source, size_t sourceSize,
+    MeshoptMode mode, MeshoptFilter filter)
+{
+    if (mode == MeshoptMode::Attributes) {
+        decodeVertexBuffer(destination, count, byteStride, source, sourceSize);
+    }
+    else
+    {
+        if (byteStride != 2 && byteStride != 4) {
+            onDecodingError("indices byteStride must be 2 or 4");
+        }
+        if (filter != MeshoptFilter::None) {
+            onDecodingError("filters only apply to attributes");
+        }
+        if (mode == MeshoptMode::Triangles) {
+            decodeTriangles(destination, count, byteStride, source, sourceSize);
+        }
+        else {
+            decodeIndexSequence(destination, count, byteStride, source, sourceSize);
+        }
+        return;
+    }
+
+    // Filters work in place on the decoded elements
+    switch (filter)
+    {
+    case MeshoptFilter::None:
+        break;
+    case MeshoptFilter::Octahedral:
+        if (byteStride == 4) {
+            decodeOctahedralFilter(reinterpret_cast<int8_t *>(destination), count);
+        }
+        else if (byteStride == 8) {
+            decodeOctahedralFilter(reinterpret_cast<int16_t *>(destination), count);
+        }
+        else {
+            onDecodingError("octahedral filter requires a byteStride of 4 or 8");
+        }
+        break;
+    case MeshoptFilter::Quaternion:
+        if (byteStride != 8) {
+            onDecodingError("quaternion filter requires a byteStride of 8");
+        }
+        decodeQuaternionFilter(reinterpret_cast<int16_t *>(destination), count);
+        break;
+    case MeshoptFilter::Exponential:
+        decodeExponentialFilter(reinterpret_cast<uint32_t *>(destination), count * byteStride / 4);
+        break;
+    }
+}
+
+}
@@ -0,0 +1,322 @@
+#include <glmlv/Image2DRGBA.hpp>
+#include <glmlv/parallel.hpp>
+
+#include <cmath>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define GLMLV_MIPMAPPING_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace glmlv
+{
+
+namespace
+{
+
+// Rows are distributed to threads by chunks of this size, small levels are processed by the calling thread only
+const size_t MinRowsPerTask = 32;
+
+struct SRGBTables
+{
+    float toLinear[256];
+    unsigned char fromLinear[4096]; // Indexed by linear value quantized on 12 bits
+
+    SRGBTables()
+    {
+        for (auto i = 0u; i < 256; ++i)
+        {
+            const float c = i / 255.f;
+            toLinear[i] = c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+        }
+        for (auto i = 0u; i < 4096; ++i)
+        {
+            const float l = i / 4095.f;
+            const float c = l <= 0.0031308f ? l * 12.92f : 1.055f * std::pow(l, 1.f / 2.4f) - 0.055f;
+            fromLinear[i] = (unsigned char)(std::min(std::max(c, 0.f), 1.f) * 255.f + 0.5f);
+        }
+    }
+};
+
+const SRGBTables & getSRGBTables()
+{
+    static const SRGBTables tables;
+    return tables;
+}
+
+inline unsigned char encodeLinear(float value)
+{
+    return (unsigned char)(std::min(std::max(value, 0.f), 1.f) * 255.f + 0.5f);
+}
+
+inline unsigned char encodeSRGB(const SRGBTables & tables, float value)
+{
+    return tables.fromLinear[int(std::min(std::max(value, 0.f), 1.f) * 4095.f + 0.5f)];
+}
+
+void downsampleBoxLinear(const unsigned char * src, size_t srcWidth, size_t srcHeight, unsigned char * dst, size_t dstWidth, size_t dstHeight)
+{
+    parallelFor(dstHeight, MinRowsPerTask, [&](size_t yBegin, size_t yEnd)
+    {
+        for (auto y = yBegin; y < yEnd; ++y)
+        {
+            const unsigned char * row0 = src + std::min(2 * y, srcHeight - 1) * srcWidth * 4;
+            const unsigned char * row1 = src + std::min(2 * y + 1, srcHeight - 1) * srcWidth * 4;
+            unsigned char * dstRow = dst + y * dstWidth * 4;
+
+            size_t x = 0;
+#ifdef GLMLV_MIPMAPPING_SSE2
+            // Two destination pixels per iteration, from 4 source pixels on each of the two rows
+            const __m128i zero = _mm_setzero_si128();
+            const __m128i rounding = _mm_set1_epi16(2);
+            for (; 2 * x + 3 < srcWidth && x + 1 < dstWidth; x += 2)
+            {
+                const __m128i a = _mm_loadu_si128((const __m128i *)(row0 + 8 * x));
+                const __m128i b = _mm_loadu_si128((const __m128i *)(row1 + 8 * x));
+                const __m128i lo = _mm_add_epi16(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero)); // Columns 2x and 2x + 1
+                const __m128i hi = _mm_add_epi16(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero)); // Columns 2x + 2 and 2x + 3
+                const __m128i sum = _mm_add_epi16(_mm_unpacklo_epi64(lo, hi), _mm_unpackhi_epi64(lo, hi));
+                const __m128i average = _mm_srli_epi16(_mm_add_epi16(sum, rounding), 2);
+                _mm_storel_epi64((__m128i *)(dstRow + 4 * x), _mm_packus_epi16(average, zero));
+            }
+#endif
+            for (; x < dstWidth; ++x)
+            {
+                const auto x0 = std::min(2 * x, srcWidth - 1) * 4;
+                const auto x1 = std::min(2 * x + 1, srcWidth - 1) * 4;
+                for (auto c = 0u; c < 4; ++c) {
+                    dstRow[4 * x + c] = (unsigned char)((row0[x0 + c] + row0[x1 + c] + row1[x0 + c] + row1[x1 + c] + 2) >> 2);
+                }
+            }
+        }
+    });
+}
+
+void downsampleBoxSRGB(const unsigned char * src, size_t srcWidth, size_t srcHeight, unsigned char * dst, size_t dstWidth, size_t dstHeight)
+{
+    const auto & tables = getSRGBTables();
+
+    parallelFor(dstHeight, MinRowsPerTask, [&](size_t yBegin, size_t yEnd)
+    {
+        for (auto y = yBegin; y < yEnd; ++y)
+        {
+            const unsigned char * row0 = src + std::min(2 * y, srcHeight - 1) * srcWidth * 4;
+            const unsigned char * row1 = src + std::min(2 * y + 1, srcHeight - 1) * srcWidth * 4;
+            unsigned char * dstRow = dst + y * dstWidth * 4;
+
+            for (size_t x = 0; x < dstWidth; ++x)
+            {
+                const auto x0 = std::min(2 * x, srcWidth - 1) * 4;
+                const auto x1 = std::min(2 * x + 1, srcWidth - 1) * 4;
+
+                float average[4];
+#ifdef GLMLV_MIPMAPPING_SSE2
+                const auto load = [&](const unsigned char * p)
+                {
+                    return _mm_set_ps(p[3] * (1.f / 255.f), tables.toLinear[p[2]], tables.toLinear[p[1]], tables.toLinear[p[0]]);
+                };
+                const __m128 sum = _mm_add_ps(_mm_add_ps(load(row0 + x0), load(row0 + x1)), _mm_add_ps(load(row1 + x0), load(row1 + x1)));
+                _mm_storeu_ps(average, _mm_mul_ps(sum, _mm_set1_ps(0.25f)));
+#else
+                for (auto c = 0u; c < 3; ++c) {
+                    average[c] = 0.25f * (tables.toLinear[row0[x0 + c]] + tables.toLinear[row0[x1 + c]] + tables.toLinear[row1[x0 + c]] + tables.toLinear[row1[x1 + c]]);
+                }
+                average[3] = (row0[x0 + 3] + row0[x1 + 3] + row1[x0 + 3] + row1[x1 + 3]) * (0.25f / 255.f);
+#endif
+                dstRow[4 * x + 0] = encodeSRGB(tables, average[0]);
+                dstRow[4 * x + 1] = encodeSRGB(tables, average[1]);
+                dstRow[4 * x + 2] = encodeSRGB(tables, average[2]);
+                dstRow[4 * x + 3] = encodeLinear(average[3]);
+            }
+        }
+    });
+}
+
+float besselI0(float x)
+{
+    float sum = 1.f;
+    float term = 1.f;
+    for (auto k = 1; term > 1e-7f * sum; ++k)
+    {
+        const float t = x / (2.f * k);
+        term *= t * t;
+        sum += term;
+    }
+    return sum;
+}
+
+// Weights of the 6 source texels contributing to a destination texel when halving the resolution,
+// for source texels 2x - 2 to 2x + 3. The kernel is a sinc windowed by a Kaiser window of alpha 4.
+struct KaiserKernel
+{
+    static const int TapCount = 6;
+    float weights[TapCount];
+
+    KaiserKernel()
+    {
+        const float pi = 3.14159265358979f;
+        const float alpha = 4.f;
+        const float halfWidth = 1.5f; // In destination texels
+
+        float sum = 0.f;
+        for (auto i = 0; i < TapCount; ++i)
+        {
+            const float t = (i - 2.5f) * 0.5f; // Distance between source and destination texel centers, in destination texels
+            const float sinc = std::sin(pi * t) / (pi * t);
+            const float w = t / halfWidth;
+            const float window = besselI0(alpha * std::sqrt(std::max(0.f, 1.f - w * w))) / besselI0(alpha);
+            weights[i] = sinc * window;
+            sum += weights[i];
+        }
+        for (auto & weight : weights) {
+            weight /= sum;
+        }
+    }
+};
+
+const KaiserKernel & getKaiserKernel()
+{
+    static const KaiserKernel kernel;
+    return kernel;
+}
+
+// Linear RGBA float image used as the source of the next level, so that levels are not filtered from quantized data
+void decodeLevel(const unsigned char * src, size_t pixelCount, ColorSpace colorSpace, float * dst)
+{
+    const auto & tables = getSRGBTables();
+    parallelFor(pixelCount, 64 * 1024, [&](size_t begin, size_t end)
+    {
+        for (auto i = begin; i < end; ++i)
+        {
+            for (auto c = 0u; c < 3; ++c) {
+                dst[4 * i + c] = colorSpace == ColorSpace::sRGB ? tables.toLinear[src[4 * i + c]] : src[4 * i + c] * (1.f / 255.f);
+            }
+            dst[4 * i + 3] = src[4 * i + 3] * (1.f / 255.f);
+        }
+    });
+}
+
+void downsampleKaiser(const std::vector<float> & src, size_t srcWidth, size_t srcHeight, std::vector<float> & dst, size_t dstWidth, size_t dstHeight)
+{
+    const auto & kernel = getKaiserKernel();
+
+    // Horizontal pass: srcHeight rows of dstWidth texels
+    std::vector<float> tmp(srcHeight * dstWidth * 4);
+    parallelFor(srcHeight, MinRowsPerTask, [&](size_t yBegin, size_t yEnd)
+    {
+        for (auto y = yBegin; y < yEnd; ++y)
+        {
+            const float * srcRow = src.data() + y * srcWidth * 4;
+            float * tmpRow = tmp.data() + y * dstWidth * 4;
+            for (size_t x = 0; x < dstWidth; ++x)
+            {
+                float sum[4] = { 0.f, 0.f, 0.f, 0.f };
+                if (srcWidth == 1) {
+                    std::memcpy(sum, srcRow, sizeof(sum));
+                }
+                else
+                {
+                    for (auto i = 0; i < KaiserKernel::TapCount; ++i)
+                    {
+                        const auto sx = std::min(std::max(int64_t(2 * x) - 2 + i, int64_t(0)), int64_t(srcWidth - 1));
+                        for (auto c = 0u; c < 4; ++c) {
+                            sum[c] += kernel.weights[i] * srcRow[4 * sx + c];
+                        }
+                    }
+                }
+                std::memcpy(tmpRow + 4 * x, sum, sizeof(sum));
+            }
+        }
+    });
+
+    // Vertical pass
+    dst.resize(dstWidth * dstHeight * 4);
+    parallelFor(dstHeight, MinRowsPerTask, [&](size_t yBegin, size_t yEnd)
+    {
+        for (auto y = yBegin; y < yEnd; ++y)
+        {
+            float * dstRow = dst.data() + y * dstWidth * 4;
+            if (srcHeight == 1) {
+                std::memcpy(dstRow, tmp.data(), dstWidth * 4 * sizeof(float));
+                continue;
+            }
+            std::fill(dstRow, dstRow + dstWidth * 4, 0.f);
+            for (auto i = 0; i < KaiserKernel::TapCount; ++i)
+            {
+                const auto sy = std::min(std::max(int64_t(2 * y) - 2 + i, int64_t(0)), int64_t(srcHeight - 1));
+                const float * tmpRow = tmp.data() + sy * dstWidth * 4;
+                for (size_t j = 0; j < dstWidth * 4; ++j) {
+                    dstRow[j] += kernel.weights[i] * tmpRow[j];
+                }
+            }
+        }
+    });
+}
+
+void encodeLevel(const std::vector<float> & src, ColorSpace colorSpace, unsigned char * dst)
+{
+    const auto & tables = getSRGBTables();
+    parallelFor(src.size() / 4, 64 * 1024, [&](size_t begin, size_t end)
+    {
+        for (auto i = begin; i < end; ++i)
+        {
+            for (auto c = 0u; c < 3; ++c) {
+                dst[4 * i + c] = colorSpace == ColorSpace::sRGB ? encodeSRGB(tables, src[4 * i + c]) : encodeLinear(src[4 * i + c]);
+            }
+            dst[4 * i + 3] = encodeLinear(src[4 * i + 3]);
+        }
+    });
+}
+
+}
+
+Image2DRGBAMipChain::Image2DRGBAMipChain(size_t width, size_t height):
+    m_nWidth(width), m_nHeight(height)
+{
+    for (size_t level = 0; ; ++level)
+    {
+        m_LevelOffsets.emplace_back(m_nByteSize);
+        m_nByteSize += byteSize(level);
+        if (this->width(level) == 1 && this->height(level) == 1) {
+            break;
+        }
+    }
+    m_pData.reset(new unsigned char[m_nByteSize]);
+}
+
+Image2DRGBAMipChain generateMipChain(const Image2DRGBA & image, ColorSpace colorSpace, MipFilter filter)
+{
+    Image2DRGBAMipChain mipChain(image.width(), image.height());
+    std::memcpy(mipChain.data(0), image.data(), mipChain.byteSize(0));
+
+    std::vector<float> current, next;
+    if (filter == MipFilter::Kaiser)
+    {
+        current.resize(image.size() * 4);
+        decodeLevel(image.data(), image.size(), colorSpace, current.data());
+    }
+
+    for (size_t level = 1; level < mipChain.levelCount(); ++level)
+    {
+        const auto srcWidth = mipChain.width(level - 1), srcHeight = mipChain.height(level - 1);
+        const auto dstWidth = mipChain.width(level), dstHeight = mipChain.height(level);
+
+        if (filter == MipFilter::Kaiser)
+        {
+            downsampleKaiser(current, srcWidth, srcHeight, next, dstWidth, dstHeight);
+            encodeLevel(next, colorSpace, mipChain.data(level));
+            std::swap(current, next);
+        }
+        else if (colorSpace == ColorSpace::sRGB) {
+            downsampleBoxSRGB(mipChain.data(level - 1), srcWidth, srcHeight, mipChain.data(level), dstWidth, dstHeight);
+        }
+        else {
+            downsampleBoxLinear(mipChain.data(level - 1), srcWidth, srcHeight, mipChain.data(level), dstWidth, dstHeight);
+        }
+    }
+
+    return mipChain;
+}
+
+}
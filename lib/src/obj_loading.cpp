@@ -0,0 +1,439 @@
+#include <glmlv/obj_loading.hpp>
+#include <glmlv/MappedFile.hpp>
+#include <glmlv/parallel.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <stdexcept>
+
+namespace glmlv
+{
+
+namespace
+{
+
+const size_t MinChunkByteSize = 1 << 20;
+
+// Relative (negative) indices of a face vertex, resolved once the number of attributes before each chunk is known
+const uint8_t RelativeVertex = 1;
+const uint8_t RelativeTexCoord = 2;
+const uint8_t RelativeNormal = 4;
+
+bool isSpace(char c)
+{
+    return c == ' ' || c == '\t';
+}
+
+bool isEndOfLine(char c)
+{
+    return c == '\n' || c == '\r';
+}
+
+const char * skipSpaces(const char * p, const char * end)
+{
+    while (p < end && isSpace(*p)) {
+        ++p;
+    }
+    return p;
+}
+
+// Decimal float with optional sign, fraction and exponent. Parsing stops at the first unexpected character, missing values are 0.
+const char * parseFloat(const char * p, const char * end, float & value)
+{
+    static const double powersOf10[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+
+    p = skipSpaces(p, end);
+    const auto negative = p < end && *p == '-';
+    if (p < end && (*p == '-' || *p == '+')) {
+        ++p;
+    }
+    uint64_t mantissa = 0;
+    int exponent = 0;
+    int digitCount = 0;
+    for (; p < end && *p >= '0' && *p <= '9'; ++p)
+    {
+        if (digitCount++ < 19) {
+            mantissa = mantissa * 10 + uint64_t(*p - '0');
+        }
+        else {
+            ++exponent; // Digits beyond the precision of the mantissa only scale it
+        }
+    }
+    if (p < end && *p == '.')
+    {
+        for (++p; p < end && *p >= '0' && *p <= '9'; ++p)
+        {
+            if (digitCount++ < 19)
+            {
+                mantissa = mantissa * 10 + uint64_t(*p - '0');
+                --exponent;
+            }
+        }
+    }
+    if (p < end && (*p == 'e' || *p == 'E'))
+    {
+        ++p;
+        const auto negativeExponent = p < end && *p == '-';
+        if (p < end && (*p == '-' || *p == '+')) {
+            ++p;
+        }
+        int explicitExponent = 0;
+        for (; p < end && *p >= '0' && *p <= '9'; ++p) {
+            explicitExponent = std::min(explicitExponent * 10 + (*p - '0'), 1000);
+        }
+        exponent += negativeExponent ? -explicitExponent : explicitExponent;
+    }
+
+    auto result = double(mantissa);
+    if (exponent >= -22 && exponent <= 22) {
+        result = exponent < 0 ? result / powersOf10[-exponent] : result * powersOf10[exponent];
+    }
+    else {
+        result *= std::pow(10.0, double(exponent));
+    }
+    value = float(negative ? -result : result);
+    return p;
+}
+
+const char * parseInt(const char * p, const char * end, int & value)
+{
+    const auto negative = p < end && *p == '-';
+    if (p < end && (*p == '-' || *p == '+')) {
+        ++p;
+    }
+    value = 0;
+    for (; p < end && *p >= '0' && *p <= '9'; ++p) {
+        value = value * 10 + (*p - '0');
+    }
+    value = negative ? -value : value;
+    return p;
+}
+
+// Rest of the line without its trailing spaces
+std::string parseLine(const char * p, const char * end)
+{
+    p = skipSpaces(p, end);
+    auto last = p;
+    while (last < end && !isEndOfLine(*last)) {
+        ++last;
+    }
+    while (last > p && isSpace(last[-1])) {
+        --last;
+    }
+    return std::string(p, last);
+}
+
+std::string parseWord(const char * p, const char * end)
+{
+    p = skipSpaces(p, end);
+    auto last = p;
+    while (last < end && !isSpace(*last) && !isEndOfLine(*last)) {
+        ++last;
+    }
+    return std::string(p, last);
+}
+
+// Lines changing the shape or the material of the following faces
+struct ObjEvent
+{
+    enum Type
+    {
+        Group,
+        Object,
+        UseMaterial,
+        MaterialLibrary
+    };
+
+    Type type;
+    size_t triangle; // Number of triangles of the chunk before the event
+    std::string name;
+};
+
+// Attributes, triangles and events of a range of lines
+struct ObjChunk
+{
+    std::vector<float> positions;
+    std::vector<float> texCoords;
+    std::vector<float> normals;
+    std::vector<tinyobj::index_t> indices; // Relative indices are stored relative to the first attribute of the chunk
+    std::vector<uint8_t> relativeFlags; // Per index, empty if the chunk has no relative index
+    std::vector<ObjEvent> events;
+};
+
+// Same index conventions as tinyobj: one based or negative relative indices, 0 and missing indices are kept as 0 and -1
+int parseIndex(const char *& p, const char * end, size_t count, uint8_t relativeFlag, uint8_t & flags)
+{
+    int index = 0;
+    p = parseInt(p, end, index);
+    if (index > 0) {
+        return index - 1;
+    }
+    if (index < 0)
+    {
+        flags |= relativeFlag;
+        return int(count) + index;
+    }
+    return 0;
+}
+
+void parseFace(const char * p, const char * end, ObjChunk & chunk)
+{
+    tinyobj::index_t face[3];
+    uint8_t faceFlags[3];
+    size_t vertexCount = 0;
+    while (true)
+    {
+        p = skipSpaces(p, end);
+        if (p >= end || isEndOfLine(*p)) {
+            break;
+        }
+
+        tinyobj::index_t index = { -1, -1, -1 };
+        uint8_t flags = 0;
+        index.vertex_index = parseIndex(p, end, chunk.positions.size() / 3, RelativeVertex, flags);
+        if (p < end && *p == '/')
+        {
+            ++p;
+            if (p < end && *p != '/') {
+                index.texcoord_index = parseIndex(p, end, chunk.texCoords.size() / 2, RelativeTexCoord, flags);
+            }
+            if (p < end && *p == '/')
+            {
+                ++p;
+                index.normal_index = parseIndex(p, end, chunk.normals.size() / 3, RelativeNormal, flags);
+            }
+        }
+        while (p < end && !isSpace(*p) && !isEndOfLine(*p)) {
+            ++p;
+        }
+
+        // Polygons are converted to triangle fans
+        if (vertexCount < 3)
+        {
+            face[vertexCount] = index;
+            faceFlags[vertexCount] = flags;
+        }
+        else
+        {
+            face[1] = face[2];
+            faceFlags[1] = faceFlags[2];
+            face[2] = index;
+            faceFlags[2] = flags;
+        }
+        if (++vertexCount >= 3)
+        {
+            const auto relative = faceFlags[0] || faceFlags[1] || faceFlags[2];
+            if (relative && chunk.relativeFlags.empty()) {
+                chunk.relativeFlags.resize(chunk.indices.size(), 0);
+            }
+            chunk.indices.insert(std::end(chunk.indices), face, face + 3);
+            if (relative || !chunk.relativeFlags.empty()) {
+                chunk.relativeFlags.insert(std::end(chunk.relativeFlags), faceFlags, faceFlags + 3);
+            }
+        }
+    }
+}
+
+void parseChunk(const char * p, const char * end, ObjChunk & chunk)
+{
+    while (p < end)
+    {
+        p = skipSpaces(p, end);
+        const auto lineEnd = std::find(p, end, '\n');
+        const auto remaining = size_t(lineEnd - p);
+        const auto token = [&](const char * keyword, size_t size)
+        {
+            return remaining > size && std::equal(keyword, keyword + size, p) && isSpace(p[size]);
+        };
+
+        if (token("v", 1))
+        {
+            float position[3] = { 0.f, 0.f, 0.f };
+            auto q = p + 1;
+            for (auto & value : position) {
+                q = parseFloat(q, lineEnd, value);
+            }
+            chunk.positions.insert(std::end(chunk.positions), position, position + 3);
+        }
+        else if (token("vt", 2))
+        {
+            float texCoord[2] = { 0.f, 0.f };
+            auto q = p + 2;
+            for (auto & value : texCoord) {
+                q = parseFloat(q, lineEnd, value);
+            }
+            chunk.texCoords.insert(std::end(chunk.texCoords), texCoord, texCoord + 2);
+        }
+        else if (token("vn", 2))
+        {
+            float normal[3] = { 0.f, 0.f, 0.f };
+            auto q = p + 2;
+            for (auto & value : normal) {
+                q = parseFloat(q, lineEnd, value);
+            }
+            chunk.normals.insert(std::end(chunk.normals), normal, normal + 3);
+        }
+        else if (token("f", 1)) {
+            parseFace(p + 1, lineEnd, chunk);
+        }
+        else if (token("g", 1)) {
+            chunk.events.push_back({ ObjEvent::Group, chunk.indices.size() / 3, parseWord(p + 1, lineEnd) });
+        }
+        else if (token("o", 1)) {
+            chunk.events.push_back({ ObjEvent::Object, chunk.indices.size() / 3, parseWord(p + 1, lineEnd) });
+        }
+        else if (token("usemtl", 6)) {
+            chunk.events.push_back({ ObjEvent::UseMaterial, chunk.indices.size() / 3, parseWord(p + 6, lineEnd) });
+        }
+        else if (token("mtllib", 6)) {
+            chunk.events.push_back({ ObjEvent::MaterialLibrary, chunk.indices.size() / 3, parseLine(p + 6, lineEnd) });
+        }
+        p = lineEnd < end ? lineEnd + 1 : end;
+    }
+}
+
+// Like tinyobj::MaterialFileReader: the first file of the library that can be opened is loaded
+void loadMaterialLibrary(const std::string & names, const fs::path & mtlBaseDir, std::map<std::string, int> & materialMap, std::vector<tinyobj::material_t> & materials)
+{
+    for (size_t begin = 0; begin < names.size();)
+    {
+        const auto nameEnd = std::min(names.find(' ', begin), names.size());
+        const auto name = names.substr(begin, nameEnd - begin);
+        begin = nameEnd + 1;
+        if (name.empty()) {
+            continue;
+        }
+        std::ifstream stream((mtlBaseDir / name).string());
+        if (stream)
+        {
+            std::string warning;
+            tinyobj::LoadMtl(&materialMap, &materials, &stream, &warning);
+            if (!warning.empty()) {
+                std::clog << warning << std::endl;
+            }
+            return;
+        }
+    }
+    std::clog << "Warning: material library " << names << " not found in " << mtlBaseDir << std::endl;
+}
+
+}
+
+void loadObjFile(const fs::path & objPath, const fs::path & mtlBaseDir, tinyobj::attrib_t & attribs,
+    std::vector<tinyobj::shape_t> & shapes, std::vector<tinyobj::material_t> & materials)
+{
+    const MappedFile file(objPath);
+    const auto text = reinterpret_cast<const char *>(file.data());
+    const auto size = file.size();
+
+    // Chunk boundaries are moved after the end of the line they fall in
+    const auto chunkCount = std::max<size_t>(1, std::min(size / MinChunkByteSize, 8 * getWorkerCount()));
+    std::vector<size_t> boundaries(chunkCount + 1, size);
+    boundaries[0] = 0;
+    for (size_t i = 1; i < chunkCount; ++i)
+    {
+        const auto newLine = std::find(text + std::max(size * i / chunkCount, boundaries[i - 1]), text + size, '\n');
+        boundaries[i] = newLine < text + size ? size_t(newLine - text) + 1 : size;
+    }
+    std::vector<ObjChunk> chunks(chunkCount);
+    parallelFor(chunkCount, 1, [&](size_t begin, size_t end)
+    {
+        for (auto i = begin; i < end; ++i) {
+            parseChunk(text + boundaries[i], text + boundaries[i + 1], chunks[i]);
+        }
+    });
+
+    // Attributes of all chunks, relative indices are resolved with the number of attributes before their chunk
+    std::vector<size_t> positionOffsets(chunkCount + 1, 0), texCoordOffsets(chunkCount + 1, 0), normalOffsets(chunkCount + 1, 0);
+    for (size_t i = 0; i < chunkCount; ++i)
+    {
+        positionOffsets[i + 1] = positionOffsets[i] + chunks[i].positions.size();
+        texCoordOffsets[i + 1] = texCoordOffsets[i] + chunks[i].texCoords.size();
+        normalOffsets[i + 1] = normalOffsets[i] + chunks[i].normals.size();
+    }
+    attribs.vertices.resize(positionOffsets.back());
+    attribs.texcoords.resize(texCoordOffsets.back());
+    attribs.normals.resize(normalOffsets.back());
+    parallelFor(chunkCount, 1, [&](size_t begin, size_t end)
+    {
+        for (auto i = begin; i < end; ++i)
+        {
+            auto & chunk = chunks[i];
+            std::copy(std::begin(chunk.positions), std::end(chunk.positions), std::begin(attribs.vertices) + positionOffsets[i]);
+            std::copy(std::begin(chunk.texCoords), std::end(chunk.texCoords), std::begin(attribs.texcoords) + texCoordOffsets[i]);
+            std::copy(std::begin(chunk.normals), std::end(chunk.normals), std::begin(attribs.normals) + normalOffsets[i]);
+            for (size_t j = 0; j < chunk.relativeFlags.size(); ++j)
+            {
+                const auto flags = chunk.relativeFlags[j];
+                auto & index = chunk.indices[j];
+                if (flags & RelativeVertex) {
+                    index.vertex_index += int(positionOffsets[i] / 3);
+                }
+                if (flags & RelativeTexCoord) {
+                    index.texcoord_index += int(texCoordOffsets[i] / 2);
+                }
+                if (flags & RelativeNormal) {
+                    index.normal_index += int(normalOffsets[i] / 3);
+                }
+            }
+            std::vector<float>().swap(chunk.positions);
+            std::vector<float>().swap(chunk.texCoords);
+            std::vector<float>().swap(chunk.normals);
+        }
+    });
+
+    // Shapes are split on g and o lines, the material of the faces changes on usemtl lines
+    std::map<std::string, int> materialMap;
+    tinyobj::shape_t shape;
+    std::string name;
+    int material = -1;
+    const auto appendTriangles = [&](const ObjChunk & chunk, size_t begin, size_t end)
+    {
+        shape.mesh.indices.insert(std::end(shape.mesh.indices), std::begin(chunk.indices) + 3 * begin, std::begin(chunk.indices) + 3 * end);
+        shape.mesh.num_face_vertices.resize(shape.mesh.num_face_vertices.size() + end - begin, 3);
+        shape.mesh.material_ids.resize(shape.mesh.material_ids.size() + end - begin, material);
+        if (end > begin) {
+            shape.name = name;
+        }
+    };
+    const auto pushShape = [&]()
+    {
+        if (!shape.mesh.indices.empty()) {
+            shapes.emplace_back(std::move(shape));
+        }
+        shape = tinyobj::shape_t();
+    };
+    for (const auto & chunk : chunks)
+    {
+        size_t triangle = 0;
+        for (const auto & event : chunk.events)
+        {
+            appendTriangles(chunk, triangle, event.triangle);
+            triangle = event.triangle;
+            switch (event.type)
+            {
+            case ObjEvent::Group:
+            case ObjEvent::Object:
+                pushShape();
+                name = event.name;
+                break;
+            case ObjEvent::UseMaterial:
+            {
+                const auto it = materialMap.find(event.name);
+                material = it != end(materialMap) ? (*it).second : -1;
+                break;
+            }
+            case ObjEvent::MaterialLibrary:
+                loadMaterialLibrary(event.name, mtlBaseDir, materialMap, materials);
+                break;
+            }
+        }
+        appendTriangles(chunk, triangle, chunk.indices.size() / 3);
+    }
+    pushShape();
+}
+
+}
@@ -1,4 +1,9 @@
 #include <glmlv/scene_loading.hpp>
+#include <glmlv/TextureContainer.hpp>
+#include <glmlv/gltf_loading.hpp>
+#include <glmlv/obj_loading.hpp>
+#include <glmlv/tangent_space.hpp>
+#include <glmlv/parallel.hpp>
 
 #include <iostream>
 #include <unordered_map>
@@ -6,6 +11,10 @@
 #include <string>
 #include <algorithm>
 #include <stack>
+#include <cstring>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <glm/gtc/type_ptr.hpp>
 
 #ifdef GLMLV_USE_ASSIMP
 #include <assimp/Importer.hpp>
@@ -20,6 +29,96 @@
 namespace glmlv
 {
 
+// Copy the first level of an uncompressed container, whose texels must match F
+template<ImageFormat F>
+static Image2D<F> copyContainerLevel(const TextureSpan & level)
+{
+    Image2D<F> image(level.width, level.height);
+    std::copy(level.data, level.data + image.byteSize(), reinterpret_cast<unsigned char*>(image.data()));
+    return image;
+}
+
+// Load an image in data.textures with the channels of the file, flipped to OpenGL row order.
+// KTX2/DDS containers with compressed levels are kept compressed: they are added to data.compressedTextures, referencing the mapped file,
+// and an empty image is added to data.textures at the same index. Returns false if the texture cannot be used.
+static bool loadSceneTexture(const fs::path & path, SceneData & data)
+{
+    if (!isTextureContainerPath(path))
+    {
+        data.textures.emplace_back(readAnyImage(path));
+        data.textures.back().flipY();
+        if (!data.compressedTextures.empty()) {
+            data.compressedTextures.resize(data.textures.size());
+        }
+        return true;
+    }
+
+    const auto container = readTextureContainer(path);
+    if (container.isCompressed())
+    {
+        auto image = container.compressedImage();
+        if (container.rowOrder() == RowOrder::TopDown)
+        {
+            auto flippedImage = flipY(image); // Copies the levels, only bottom up containers are loaded without copy
+            if (flippedImage.levelCount()) {
+                image = std::move(flippedImage);
+            }
+            else {
+                std::clog << "Warning: " << path << " is stored top down in a format that cannot be flipped, it will be displayed upside down" << std::endl;
+            }
+        }
+        data.compressedTextures.resize(data.textures.size());
+        data.textures.emplace_back();
+        data.compressedTextures.emplace_back(std::move(image));
+        return true;
+    }
+
+    // Uncompressed containers keep their components, BGRA is swizzled to RGBA. Other levels than the first one are dropped.
+    const auto pixelFormat = container.pixelFormat();
+    const auto pixelType = container.pixelType();
+    const auto level = container.level(0);
+    AnyImage2D image;
+    if (pixelType == GL_UNSIGNED_BYTE && pixelFormat == GL_RED) {
+        image = copyContainerLevel<ImageFormat::R8>(level);
+    }
+    else if (pixelType == GL_UNSIGNED_BYTE && pixelFormat == GL_RG) {
+        image = copyContainerLevel<ImageFormat::RG8>(level);
+    }
+    else if (pixelType == GL_UNSIGNED_BYTE && (pixelFormat == GL_RGBA || pixelFormat == GL_BGRA))
+    {
+        auto rgba = copyContainerLevel<ImageFormat::RGBA8>(level);
+        if (pixelFormat == GL_BGRA) {
+            for (size_t i = 0; i < rgba.size(); ++i) {
+                std::swap(rgba.data()[i * 4], rgba.data()[i * 4 + 2]);
+            }
+        }
+        image = std::move(rgba);
+    }
+    else if (pixelType == GL_HALF_FLOAT && pixelFormat == GL_RED) {
+        image = copyContainerLevel<ImageFormat::R16F>(level);
+    }
+    else if (pixelType == GL_HALF_FLOAT && pixelFormat == GL_RGBA) {
+        image = copyContainerLevel<ImageFormat::RGBA16F>(level);
+    }
+    else if (pixelType == GL_FLOAT && pixelFormat == GL_RGBA) {
+        image = copyContainerLevel<ImageFormat::RGBA32F>(level);
+    }
+    else
+    {
+        std::clog << "Warning: unsupported pixel format in " << path << std::endl;
+        return false;
+    }
+
+    if (container.rowOrder() == RowOrder::TopDown) {
+        image.flipY();
+    }
+    data.textures.emplace_back(std::move(image));
+    if (!data.compressedTextures.empty()) {
+        data.compressedTextures.resize(data.textures.size());
+    }
+    return true;
+}
+
 #ifdef GLMLV_USE_ASSIMP
 glm::mat4 aiMatrixToGlmMatrix(const aiMatrix4x4 & mat)
 {
@@ -139,9 +238,10 @@ void loadAssimpScene(const fs::path & objPath, const fs::path & mtlBaseDir, Scen
 			if (fs::exists(completePath))
 			{
 				std::clog << "Loading image " << completePath << std::endl;
-				textureIds[keyVal.first] = int32_t(data.textures.size());
-				data.textures.emplace_back(readImage(completePath));
-				data.textures.back().flipY();
+				const auto textureId = int32_t(data.textures.size());
+				if (loadSceneTexture(completePath, data)) {
+					textureIds[keyVal.first] = textureId;
+				}
 			}
 			else
 			{
@@ -259,34 +359,46 @@ struct TinyObjLoaderEqualTo
 
 // Load an obj model with tinyobjloader
 // Obj models might use different set of indices per vertex. The default rendering mechanism of OpenGL does not support this feature to this functions duplicate attributes with different indices.
-void loadTinyObjScene(const fs::path & objPath, const fs::path & mtlBaseDir, SceneData & data, bool loadTextures)
+void loadTinyObjScene(const fs::path & objPath, const fs::path & mtlBaseDir, SceneData & data, bool loadTextures, ObjParser parser)
 {
     // Load obj
     std::vector<tinyobj::shape_t> shapes;
     std::vector<tinyobj::material_t> materials;
     tinyobj::attrib_t attribs;
 
-    std::string err;
-    bool ret = tinyobj::LoadObj(&attribs, &shapes, &materials, &err, objPath.string().c_str(), (mtlBaseDir.string() + "/").c_str());
-
-    if (!err.empty()) { // `err` may contain warning message.
-        std::cerr << err << std::endl;
+    if (parser == ObjParser::Parallel) {
+        loadObjFile(objPath, mtlBaseDir, attribs, shapes, materials);
     }
+    else
+    {
+        std::string err;
+        const auto mtlBaseDirString = mtlBaseDir.empty() ? std::string() : mtlBaseDir.string() + "/"; // Relative obj paths have an empty parent path
+        bool ret = tinyobj::LoadObj(&attribs, &shapes, &materials, &err, objPath.string().c_str(), mtlBaseDirString.c_str());
 
-    if (!ret) {
-        throw std::runtime_error(err);
-    }
+        if (!err.empty()) { // `err` may contain warning message.
+            std::cerr << err << std::endl;
+        }
 
-    data.shapeCount += shapes.size();
+        if (!ret) {
+            throw std::runtime_error(err);
+        }
+    }
 
     std::unordered_map<tinyobj::index_t, uint32_t, TinyObjLoaderIndexHash, TinyObjLoaderEqualTo> indexMap;
 
     std::unordered_set<std::string> texturePaths;
+    bool missingNormals = false;
+
+    // Faces of each shape are split by material with a counting sort, the buffers are shared by all shapes
+    std::vector<size_t> faceCountPerMaterial(materials.size() + 1); // Faces without material first
+    std::vector<size_t> nextIndexPerMaterial(materials.size() + 1);
+    std::vector<uint32_t> sortedIndices;
 
     const auto materialIdOffset = data.materials.size();
     for (const auto & shape : shapes)
     {
         const auto & mesh = shape.mesh;
+        const auto shapeIndexOffset = data.indexBuffer.size();
         for (const auto & idx : mesh.indices)
         {
             const auto it = indexMap.find(idx);
@@ -296,11 +408,15 @@ void loadTinyObjScene(const fs::path & objPath, const fs::path & mtlBaseDir, Sce
                 float vx = attribs.vertices[3 * idx.vertex_index + 0];
                 float vy = attribs.vertices[3 * idx.vertex_index + 1];
                 float vz = attribs.vertices[3 * idx.vertex_index + 2];
-                float nx = attribs.normals[3 * idx.normal_index + 0];
-                float ny = attribs.normals[3 * idx.normal_index + 1];
-                float nz = attribs.normals[3 * idx.normal_index + 2];
-                float tx = attribs.texcoords[2 * idx.texcoord_index + 0];
-                float ty = attribs.texcoords[2 * idx.texcoord_index + 1];
+                // Missing normals are null until computeMissingNormals, missing texture coordinates stay null
+                const auto hasNormal = idx.normal_index >= 0 && size_t(3 * idx.normal_index + 2) < attribs.normals.size();
+                const auto hasTexCoords = idx.texcoord_index >= 0 && size_t(2 * idx.texcoord_index + 1) < attribs.texcoords.size();
+                missingNormals = missingNormals || !hasNormal;
+                float nx = hasNormal ? attribs.normals[3 * idx.normal_index + 0] : 0.f;
+                float ny = hasNormal ? attribs.normals[3 * idx.normal_index + 1] : 0.f;
+                float nz = hasNormal ? attribs.normals[3 * idx.normal_index + 2] : 0.f;
+                float tx = hasTexCoords ? attribs.texcoords[2 * idx.texcoord_index + 0] : 0.f;
+                float ty = hasTexCoords ? attribs.texcoords[2 * idx.texcoord_index + 1] : 0.f;
 
                 uint32_t newIndex = data.vertexBuffer.size();
                 data.vertexBuffer.emplace_back(glm::vec3(vx, vy, vz), glm::vec3(nx, ny, nz), glm::vec2(tx, ty));
@@ -313,22 +429,63 @@ void loadTinyObjScene(const fs::path & objPath, const fs::path & mtlBaseDir, Sce
             else
                 data.indexBuffer.emplace_back((*it).second);
         }
-        data.indexCountPerShape.emplace_back(mesh.indices.size());
 
-        const int32_t localMaterialID = mesh.material_ids.empty() ? -1 : mesh.material_ids[0];
-        const int32_t materialID = localMaterialID >= 0 ? materialIdOffset + localMaterialID : -1;
+        // Faces are triangles, unknown materials are replaced by no material
+        const auto faceCount = mesh.indices.size() / 3;
+        const auto getFaceMaterial = [&](size_t face)
+        {
+            const auto localMaterialID = face < mesh.material_ids.size() ? mesh.material_ids[face] : -1;
+            return localMaterialID >= 0 && size_t(localMaterialID) < materials.size() ? size_t(localMaterialID + 1) : size_t(0);
+        };
+        std::fill(begin(faceCountPerMaterial), end(faceCountPerMaterial), 0);
+        for (size_t face = 0; face < faceCount; ++face) {
+            ++faceCountPerMaterial[getFaceMaterial(face)];
+        }
 
-        data.materialIDPerShape.emplace_back(materialID);
-        data.localToWorldMatrixPerShape.emplace_back(glm::mat4(1.f));
+        const auto shapeIndices = data.indexBuffer.data() + shapeIndexOffset;
+        const auto isSingleMaterial = std::find(begin(faceCountPerMaterial), end(faceCountPerMaterial), faceCount) != end(faceCountPerMaterial);
+        if (!isSingleMaterial)
+        {
+            // Faces keep their order within each material
+            sortedIndices.resize(3 * faceCount);
+            nextIndexPerMaterial[0] = 0;
+            for (size_t material = 1; material < faceCountPerMaterial.size(); ++material) {
+                nextIndexPerMaterial[material] = nextIndexPerMaterial[material - 1] + 3 * faceCountPerMaterial[material - 1];
+            }
+            for (size_t face = 0; face < faceCount; ++face)
+            {
+                auto & next = nextIndexPerMaterial[getFaceMaterial(face)];
+                std::copy(shapeIndices + 3 * face, shapeIndices + 3 * face + 3, begin(sortedIndices) + next);
+                next += 3;
+            }
+            std::copy(begin(sortedIndices), end(sortedIndices), shapeIndices);
+        }
+        data.indexBuffer.resize(shapeIndexOffset + 3 * faceCount); // Incomplete faces are dropped
 
-        // Only load textures that are used
-        if (localMaterialID >= 0)
+        // One shape per material used by the faces
+        for (size_t material = 0; material < faceCountPerMaterial.size(); ++material)
         {
-            const auto & material = materials[localMaterialID];
-            texturePaths.emplace(material.ambient_texname);
-            texturePaths.emplace(material.diffuse_texname);
-            texturePaths.emplace(material.specular_texname);
-            texturePaths.emplace(material.specular_highlight_texname);
+            if (!faceCountPerMaterial[material]) {
+                continue;
+            }
+            const int32_t localMaterialID = int32_t(material) - 1;
+            const int32_t materialID = localMaterialID >= 0 ? materialIdOffset + localMaterialID : -1;
+
+            ++data.shapeCount;
+            data.indexCountPerShape.emplace_back(uint32_t(3 * faceCountPerMaterial[material]));
+            data.materialIDPerShape.emplace_back(materialID);
+            data.localToWorldMatrixPerShape.emplace_back(glm::mat4(1.f));
+
+            // Only load textures that are used
+            if (localMaterialID >= 0)
+            {
+                const auto & objMaterial = materials[localMaterialID];
+                texturePaths.emplace(objMaterial.ambient_texname);
+                texturePaths.emplace(objMaterial.diffuse_texname);
+                texturePaths.emplace(objMaterial.specular_texname);
+                texturePaths.emplace(objMaterial.specular_highlight_texname);
+                texturePaths.emplace(objMaterial.normal_texname);
+            }
         }
     }
 
@@ -347,11 +504,11 @@ void loadTinyObjScene(const fs::path & objPath, const fs::path & mtlBaseDir, Sce
                 if (fs::exists(completePath))
                 {
                     std::clog << "Loading image " << completePath << std::endl;
-                    data.textures.emplace_back(readImage(completePath));
-                    data.textures.back().flipY();
-
-                    const auto localTexId = textureIdMap.size();
-                    textureIdMap[texturePath] = textureIdOffset + localTexId;
+                    if (loadSceneTexture(completePath, data))
+                    {
+                        const auto localTexId = textureIdMap.size();
+                        textureIdMap[texturePath] = textureIdOffset + localTexId;
+                    }
                 }
                 else
                 {
@@ -387,6 +544,358 @@ void loadTinyObjScene(const fs::path & objPath, const fs::path & mtlBaseDir, Sce
             const auto it = textureIdMap.find(material.specular_highlight_texname);
             newMaterial.shininessTextureId = it != end(textureIdMap) ? (*it).second : -1;
         }
+        if (!material.normal_texname.empty()) {
+            const auto it = textureIdMap.find(material.normal_texname);
+            newMaterial.normalTextureId = it != end(textureIdMap) ? (*it).second : -1;
+        }
+    }
+
+    if (missingNormals) {
+        computeMissingNormals(data);
+    }
+    if (std::any_of(begin(data.materials), end(data.materials), [](const SceneData::PhongMaterial & material) { return material.normalTextureId >= 0; })) {
+        computeTangents(data);
+    }
+}
+
+// Index of the element of each triangle of a primitive, strips and fans are converted to lists
+static std::vector<uint32_t> getTriangleListIndices(int mode, std::vector<uint32_t> indices)
+{
+    if (mode == TINYGLTF_MODE_TRIANGLES) {
+        indices.resize(indices.size() - indices.size() % 3);
+        return indices;
+    }
+    std::vector<uint32_t> triangles;
+    for (size_t i = 2; i < indices.size(); ++i)
+    {
+        if (mode == TINYGLTF_MODE_TRIANGLE_FAN) {
+            triangles.insert(end(triangles), { indices[0], indices[i - 1], indices[i] });
+        }
+        else if (i % 2) { // Keep the winding of odd triangles of strips
+            triangles.insert(end(triangles), { indices[i - 1], indices[i - 2], indices[i] });
+        }
+        else {
+            triangles.insert(end(triangles), { indices[i - 2], indices[i - 1], indices[i] });
+        }
+    }
+    return triangles;
+}
+
+// Indices of an accessor of any width
+static std::vector<uint32_t> readGltfIndices(const GltfDocument & document, int accessor)
+{
+    const auto & gltfAccessor = document.model.accessors[accessor];
+    const auto range = getAccessorByteRange(document.model, accessor);
+    std::vector<uint32_t> indices(gltfAccessor.count, 0);
+    if (range.end <= range.begin) {
+        return indices;
+    }
+    if (range.buffer >= document.bufferCount() || range.end > document.bufferByteSize(range.buffer)) {
+        throw std::runtime_error("Accessor " + std::to_string(accessor) + " is out of its buffer");
+    }
+    const auto & bufferView = document.model.bufferViews[gltfAccessor.bufferView];
+    const auto indexSize = size_t(tinygltf::GetComponentSizeInBytes(uint32_t(gltfAccessor.componentType)));
+    const auto stride = bufferView.byteStride ? bufferView.byteStride : indexSize;
+    const auto data = document.bufferData(range.buffer) + range.begin;
+    for (size_t i = 0; i < gltfAccessor.count; ++i)
+    {
+        if (indexSize == 1) {
+            indices[i] = data[i * stride];
+        }
+        else if (indexSize == 2) {
+            uint16_t index;
+            std::memcpy(&index, data + i * stride, sizeof(index));
+            indices[i] = index;
+        }
+        else {
+            std::memcpy(&indices[i], data + i * stride, sizeof(uint32_t));
+        }
+    }
+    return indices;
+}
+
+// glTF local matrix: T * R * S, or the matrix of the node
+static glm::mat4 getGltfLocalMatrix(const tinygltf::Node & node)
+{
+    if (node.matrix.size() == 16) {
+        return glm::make_mat4(node.matrix.data());
+    }
+    glm::mat4 matrix(1);
+    if (node.translation.size() == 3) {
+        matrix = glm::translate(matrix, glm::vec3(node.translation[0], node.translation[1], node.translation[2]));
+    }
+    if (node.rotation.size() == 4) {
+        matrix = matrix * glm::mat4_cast(glm::quat(float(node.rotation[3]), float(node.rotation[0]), float(node.rotation[1]), float(node.rotation[2])));
+    }
+    if (node.scale.size() == 3) {
+        matrix = glm::scale(matrix, glm::vec3(node.scale[0], node.scale[1], node.scale[2]));
+    }
+    return matrix;
+}
+
+// Load a glTF model: each triangle primitive of each node instance of the default scene becomes a shape.
+// Vertices of a primitive are added once, node instances sharing a mesh only duplicate its indices.
+void loadGltfScene(const fs::path & path, SceneData & data, bool loadTextures)
+{
+    auto document = loadGltf(path, GltfBufferMode::Map, GltfImageMode::Defer);
+    const auto & model = document.model;
+
+    // Vertices are read on first use of a primitive: (mesh, primitive) -> first index and indices relative to it
+    struct PrimitiveGeometry
+    {
+        bool loaded = false;
+        std::vector<uint32_t> indices;
+        glm::vec3 bboxMin = glm::vec3(std::numeric_limits<float>::max());
+        glm::vec3 bboxMax = glm::vec3(std::numeric_limits<float>::lowest());
+    };
+    std::vector<std::vector<PrimitiveGeometry>> geometries(model.meshes.size());
+    bool missingNormals = false;
+    for (size_t i = 0; i < model.meshes.size(); ++i) {
+        geometries[i].resize(model.meshes[i].primitives.size());
+    }
+    const auto loadGeometry = [&](const tinygltf::Primitive & primitive, PrimitiveGeometry & geometry)
+    {
+        geometry.loaded = true;
+        const auto positionIt = primitive.attributes.find("POSITION");
+        if (positionIt == end(primitive.attributes) || (primitive.mode != TINYGLTF_MODE_TRIANGLES && primitive.mode != TINYGLTF_MODE_TRIANGLE_STRIP && primitive.mode != TINYGLTF_MODE_TRIANGLE_FAN)) {
+            return;
+        }
+        const auto readAttribute = [&](const char * name)
+        {
+            const auto it = primitive.attributes.find(name);
+            return it != end(primitive.attributes) ? readAccessorAsFloats(document, it->second) : std::vector<float>();
+        };
+        const auto positions = readAttribute("POSITION");
+        const auto normals = readAttribute("NORMAL");
+        const auto texCoords = readAttribute("TEXCOORD_0");
+        const auto vertexCount = positions.size() / 3;
+        const auto firstVertex = uint32_t(data.vertexBuffer.size());
+        missingNormals = missingNormals || normals.size() < 3 * vertexCount;
+        for (size_t v = 0; v < vertexCount; ++v)
+        {
+            const glm::vec3 position(positions[3 * v], positions[3 * v + 1], positions[3 * v + 2]);
+            const auto normal = 3 * v + 2 < normals.size() ? glm::vec3(normals[3 * v], normals[3 * v + 1], normals[3 * v + 2]) : glm::vec3(0);
+            // glTF texture coordinates start at the top of the image, scene textures are flipped to OpenGL row order
+            const auto texCoord = 2 * v + 1 < texCoords.size() ? glm::vec2(texCoords[2 * v], 1.f - texCoords[2 * v + 1]) : glm::vec2(0);
+            data.vertexBuffer.emplace_back(position, normal, texCoord);
+            geometry.bboxMin = glm::min(geometry.bboxMin, position);
+            geometry.bboxMax = glm::max(geometry.bboxMax, position);
+        }
+
+        std::vector<uint32_t> indices;
+        if (primitive.indices >= 0) {
+            indices = readGltfIndices(document, primitive.indices);
+        }
+        else
+        {
+            indices.resize(vertexCount);
+            for (size_t v = 0; v < vertexCount; ++v) {
+                indices[v] = uint32_t(v);
+            }
+        }
+        geometry.indices = getTriangleListIndices(primitive.mode, std::move(indices));
+        for (auto & index : geometry.indices) {
+            index = index < vertexCount ? firstVertex + index : firstVertex;
+        }
+    };
+
+    // Depth first traversal of the scene, the world matrix of each node instance is the one of its shapes
+    const auto materialIdOffset = int32_t(data.materials.size());
+    std::vector<int> usedImages;
+    std::vector<std::pair<int, glm::mat4>> stack;
+    const auto sceneIndex = model.defaultScene >= 0 ? model.defaultScene : 0;
+    if (sceneIndex < int(model.scenes.size()))
+    {
+        for (const auto node : model.scenes[sceneIndex].nodes) {
+            stack.emplace_back(node, glm::mat4(1));
+        }
+    }
+    while (!stack.empty())
+    {
+        const auto nodeIndex = stack.back().first;
+        const auto & node = model.nodes[nodeIndex];
+        const auto worldMatrix = stack.back().second * getGltfLocalMatrix(node);
+        stack.pop_back();
+        for (const auto child : node.children) {
+            stack.emplace_back(child, worldMatrix);
+        }
+        if (node.mesh < 0) {
+            continue;
+        }
+
+        const auto & mesh = model.meshes[node.mesh];
+        for (size_t i = 0; i < mesh.primitives.size(); ++i)
+        {
+            auto & geometry = geometries[node.mesh][i];
+            if (!geometry.loaded) {
+                loadGeometry(mesh.primitives[i], geometry);
+            }
+            if (geometry.indices.empty()) {
+                continue;
+            }
+            data.indexBuffer.insert(end(data.indexBuffer), begin(geometry.indices), end(geometry.indices));
+            data.indexCountPerShape.emplace_back(uint32_t(geometry.indices.size()));
+            data.localToWorldMatrixPerShape.emplace_back(worldMatrix);
+            const auto material = mesh.primitives[i].material;
+            data.materialIDPerShape.emplace_back(material >= 0 ? materialIdOffset + material : -1);
+            ++data.shapeCount;
+
+            // Bounding box of the transformed bounding box of the primitive
+            for (size_t corner = 0; corner < 8; ++corner)
+            {
+                const glm::vec3 localCorner(corner & 1 ? geometry.bboxMax.x : geometry.bboxMin.x, corner & 2 ? geometry.bboxMax.y : geometry.bboxMin.y, corner & 4 ? geometry.bboxMax.z : geometry.bboxMin.z);
+                const auto worldCorner = glm::vec3(worldMatrix * glm::vec4(localCorner, 1));
+                data.bboxMin = glm::min(data.bboxMin, worldCorner);
+                data.bboxMax = glm::max(data.bboxMax, worldCorner);
+            }
+        }
+    }
+
+    // Base color and normal textures, an image referenced by several textures or materials is loaded once
+    const auto getMaterialImage = [&](const tinygltf::Material & material, const std::string & name)
+    {
+        auto texture = -1;
+        const auto valueIt = material.values.find(name);
+        const auto additionalValueIt = material.additionalValues.find(name); // normalTexture is outside of pbrMetallicRoughness
+        if (valueIt != end(material.values)) {
+            texture = valueIt->second.TextureIndex();
+        }
+        else if (additionalValueIt != end(material.additionalValues)) {
+            texture = additionalValueIt->second.TextureIndex();
+        }
+        return texture >= 0 && texture < int(model.textures.size()) && model.textures[texture].source < int(model.images.size()) ? model.textures[texture].source : -1;
+    };
+    std::unordered_map<int, int32_t> textureIdPerImage;
+    if (loadTextures)
+    {
+        for (const auto & material : model.materials)
+        {
+            for (const auto image : { getMaterialImage(material, "baseColorTexture"), getMaterialImage(material, "normalTexture") })
+            {
+                if (image >= 0 && std::find(begin(usedImages), end(usedImages), image) == end(usedImages)) {
+                    usedImages.push_back(image);
+                }
+            }
+        }
+        // Images are decoded in parallel, the document supports concurrent decoding of different images
+        std::vector<bool> decoded(usedImages.size(), false);
+        parallelFor(usedImages.size(), 1, [&](size_t begin, size_t end)
+        {
+            for (auto i = begin; i < end; ++i)
+            {
+                try
+                {
+                    document.decodeImage(usedImages[i]);
+                    decoded[i] = true;
+                }
+                catch (const std::exception &) {
+                }
+            }
+        });
+        for (size_t i = 0; i < usedImages.size(); ++i)
+        {
+            const auto & image = model.images[usedImages[i]];
+            if (!decoded[i] || image.component != 4) {
+                std::clog << "Warning: unable to use image " << usedImages[i] << " of " << path << std::endl;
+                continue;
+            }
+            Image2DRGBA rgba(image.width, image.height);
+            std::copy(begin(image.image), end(image.image), reinterpret_cast<unsigned char *>(rgba.data()));
+            AnyImage2D texture(std::move(rgba));
+            texture.flipY();
+            textureIdPerImage[usedImages[i]] = int32_t(data.textures.size());
+            data.textures.emplace_back(std::move(texture));
+            if (!data.compressedTextures.empty()) {
+                data.compressedTextures.resize(data.textures.size());
+            }
+        }
+    }
+
+    // Metallic roughness materials approximated with Phong: base color as diffuse, a dielectric specular whose exponent follows the roughness
+    for (const auto & material : model.materials)
+    {
+        data.materials.emplace_back();
+        auto & newMaterial = data.materials.back();
+        newMaterial.name = material.name;
+        newMaterial.Kd = glm::vec3(1);
+        const auto colorIt = material.values.find("baseColorFactor");
+        if (colorIt != end(material.values))
+        {
+            const auto color = colorIt->second.ColorFactor();
+            newMaterial.Kd = glm::vec3(color[0], color[1], color[2]);
+        }
+        const auto metallicIt = material.values.find("metallicFactor");
+        const auto roughnessIt = material.values.find("roughnessFactor");
+        const auto metallic = metallicIt != end(material.values) ? float(metallicIt->second.Factor()) : 1.f;
+        const auto roughness = roughnessIt != end(material.values) ? float(roughnessIt->second.Factor()) : 1.f;
+        newMaterial.Ks = glm::mix(glm::vec3(0.04f), newMaterial.Kd, metallic);
+        const auto alpha = std::max(roughness * roughness, 0.01f);
+        newMaterial.shininess = std::max(2.f / (alpha * alpha) - 2.f, 1.f);
+
+        const auto textureIt = textureIdPerImage.find(getMaterialImage(material, "baseColorTexture"));
+        newMaterial.KdTextureId = textureIt != end(textureIdPerImage) ? (*textureIt).second : -1;
+        const auto normalTextureIt = textureIdPerImage.find(getMaterialImage(material, "normalTexture"));
+        newMaterial.normalTextureId = normalTextureIt != end(textureIdPerImage) ? (*normalTextureIt).second : -1;
+    }
+
+    if (missingNormals) {
+        computeMissingNormals(data);
+    }
+    if (std::any_of(begin(data.materials), end(data.materials), [](const SceneData::PhongMaterial & material) { return material.normalTextureId >= 0; })) {
+        computeTangents(data);
+    }
+}
+
+void compressSceneTextures(SceneData & data, const fs::path & cacheDirectory, bool useS3TC)
+{
+    // Textures only referenced as shininess maps hold data in their first channel, normal maps in their first two, all others are colors
+    std::vector<bool> isColorTexture(data.textures.size(), false);
+    std::vector<bool> isNormalTexture(data.textures.size(), false);
+    std::vector<bool> isUsed(data.textures.size(), false);
+    for (const auto & material : data.materials)
+    {
+        for (const auto textureId : { material.KaTextureId, material.KdTextureId, material.KsTextureId }) {
+            if (textureId >= 0) {
+                isColorTexture[textureId] = isUsed[textureId] = true;
+            }
+        }
+        if (material.shininessTextureId >= 0) {
+            isUsed[material.shininessTextureId] = true;
+        }
+        if (material.normalTextureId >= 0) {
+            isNormalTexture[material.normalTextureId] = isUsed[material.normalTextureId] = true;
+        }
+    }
+
+    // Textures loaded compressed from KTX2/DDS containers are kept as is
+    data.compressedTextures.resize(data.textures.size());
+    for (size_t i = 0; i < data.textures.size(); ++i)
+    {
+        const auto & texture = data.textures[i];
+        if (!isUsed[i] || !texture.size() || data.compressedTextures[i].levelCount()) {
+            continue;
+        }
+        // The encoders only handle 8 bits components, float textures are left uncompressed
+        if (texture.format() == ImageFormat::R16F || texture.format() == ImageFormat::RGBA16F || texture.format() == ImageFormat::RGBA32F) {
+            continue;
+        }
+        auto rgba = texture.toRGBA8();
+        const auto colorSpace = isColorTexture[i] ? ColorSpace::sRGB : ColorSpace::Linear;
+        if (!isColorTexture[i] && texture.componentCount() == 2)
+        {
+            // Two channels data, toRGBA8 expands them as gray with alpha: move them back to red and green
+            for (size_t j = 0; j < rgba.size(); ++j)
+            {
+                auto * texel = rgba.data() + j * 4;
+                texel[1] = texel[3];
+                texel[2] = 0;
+                texel[3] = 255;
+            }
+        }
+        // Color textures use RGB formats, with alpha if the image has some, there is no sRGB one or two channels format
+        const auto channelCount = isColorTexture[i] ? (texture.componentCount() % 2 ? size_t(3) : size_t(4)) : isNormalTexture[i] ? size_t(2) : size_t(1);
+        const auto format = chooseCompressedFormat(rgba, colorSpace, channelCount, useS3TC);
+        data.compressedTextures[i] = loadOrCompressImage(rgba, colorSpace, format, cacheDirectory);
     }
 }
 
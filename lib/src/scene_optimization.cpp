@@ -0,0 +1,860 @@
+#include <glmlv/scene_optimization.hpp>
+#include <glmlv/parallel.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <limits>
+#include <map>
+#include <tuple>
+#include <unordered_map>
+
+namespace glmlv
+{
+
+namespace
+{
+
+const size_t VertexCacheSize = 32;
+const size_t OverdrawCacheSize = 16; // Clusters are split where this FIFO cache is cold
+const size_t OverdrawViewportSize = 256;
+const size_t MinOverdrawScoringViewportSize = 16; // Cluster orders of small shapes are scored at lower resolutions
+
+std::vector<size_t> computeIndexOffsets(const SceneData & data)
+{
+    std::vector<size_t> indexOffsets(data.shapeCount, 0);
+    for (size_t i = 1; i < data.shapeCount; ++i) {
+        indexOffsets[i] = indexOffsets[i - 1] + data.indexCountPerShape[i - 1];
+    }
+    return indexOffsets;
+}
+
+// Remove the vertices (and tangents) not referenced by data.indexBuffer, keeping the order of the others
+void removeUnusedVertices(SceneData & data)
+{
+    const auto hasTangents = data.tangentBuffer.size() == data.vertexBuffer.size();
+    const auto unused = std::numeric_limits<uint32_t>::max();
+    std::vector<uint32_t> newVertexIndices(data.vertexBuffer.size(), unused);
+    for (const auto index : data.indexBuffer) {
+        newVertexIndices[index] = 0;
+    }
+    uint32_t vertexCount = 0;
+    for (size_t v = 0; v < data.vertexBuffer.size(); ++v)
+    {
+        if (newVertexIndices[v] != unused)
+        {
+            newVertexIndices[v] = vertexCount;
+            data.vertexBuffer[vertexCount] = data.vertexBuffer[v];
+            if (hasTangents) {
+                data.tangentBuffer[vertexCount] = data.tangentBuffer[v];
+            }
+            ++vertexCount;
+        }
+    }
+    data.vertexBuffer.resize(vertexCount);
+    data.vertexBuffer.shrink_to_fit();
+    if (hasTangents)
+    {
+        data.tangentBuffer.resize(vertexCount);
+        data.tangentBuffer.shrink_to_fit();
+    }
+    for (auto & index : data.indexBuffer) {
+        index = newVertexIndices[index];
+    }
+}
+
+// Shapes loaded after detectInstances have no instance count
+uint32_t getInstanceCount(const SceneData & data, size_t shape)
+{
+    return shape < data.instanceCountPerShape.size() ? data.instanceCountPerShape[shape] : 1;
+}
+
+bool isInstanced(const SceneData & data, size_t shape)
+{
+    return getInstanceCount(data, shape) > 1;
+}
+
+// Geometry of a shape expressed in a frame that does not depend on its translation, rotation and uniform scale
+struct CanonicalShape
+{
+    bool valid = false;
+    glm::mat4 canonicalToLocal = glm::mat4(1);
+    std::vector<uint32_t> localIndices; // Indices in the vertices below, in first use order
+    std::vector<glm::vec3> positions;
+    std::vector<glm::vec3> normals;
+    std::vector<glm::vec2> texCoords;
+    size_t hash = 0;
+};
+
+const float InstancePositionTolerance = 1e-3f; // Relative to the size of the shape
+const float InstanceNormalTolerance = 1e-2f;
+const float InstanceTexCoordsTolerance = 1e-5f;
+
+void hashCombine(size_t & hash, size_t value)
+{
+    hash ^= value + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+}
+
+// The frame is centered on the centroid of the vertices, scaled by their RMS distance to it and oriented by the first two vertices
+// far enough from it and from each other, in first use order: copies with the same index order get the same frame
+CanonicalShape computeCanonicalShape(const SceneData & data, const uint32_t * indices, size_t indexCount, int32_t material)
+{
+    CanonicalShape shape;
+    std::unordered_map<uint32_t, uint32_t> localIds;
+    std::vector<uint32_t> vertices;
+    shape.localIndices.reserve(indexCount);
+    for (size_t i = 0; i < indexCount; ++i)
+    {
+        const auto inserted = localIds.emplace(indices[i], uint32_t(vertices.size()));
+        if (inserted.second) {
+            vertices.push_back(indices[i]);
+        }
+        shape.localIndices.push_back(inserted.first->second);
+    }
+    if (vertices.size() < 3) {
+        return shape;
+    }
+
+    glm::vec3 center(0);
+    for (const auto v : vertices) {
+        center += data.vertexBuffer[v].position;
+    }
+    center /= float(vertices.size());
+    auto squaredScale = 0.f;
+    for (const auto v : vertices) {
+        squaredScale += glm::dot(data.vertexBuffer[v].position - center, data.vertexBuffer[v].position - center);
+    }
+    const auto scale = std::sqrt(squaredScale / float(vertices.size()));
+    if (!(scale > 0.f)) {
+        return shape;
+    }
+
+    glm::vec3 xAxis(0), yAxis(0);
+    for (const auto v : vertices)
+    {
+        const auto direction = (data.vertexBuffer[v].position - center) / scale;
+        if (xAxis == glm::vec3(0))
+        {
+            if (glm::length(direction) > 0.1f) {
+                xAxis = glm::normalize(direction);
+            }
+        }
+        else if (glm::length(glm::cross(xAxis, direction)) > 0.1f)
+        {
+            yAxis = glm::normalize(direction - glm::dot(direction, xAxis) * xAxis);
+            break;
+        }
+    }
+    if (yAxis == glm::vec3(0)) {
+        return shape;
+    }
+    const glm::mat3 rotation(xAxis, yAxis, glm::cross(xAxis, yAxis));
+    const auto localToCanonical = glm::transpose(rotation);
+    shape.canonicalToLocal = glm::mat4(glm::vec4(scale * xAxis, 0), glm::vec4(scale * yAxis, 0), glm::vec4(scale * rotation[2], 0), glm::vec4(center, 1));
+
+    // The hash quantizes coarsely, copies are then compared with tolerances
+    shape.hash = std::hash<int32_t>()(material);
+    hashCombine(shape.hash, vertices.size());
+    for (const auto index : shape.localIndices) {
+        hashCombine(shape.hash, index);
+    }
+    const auto quantize = [&](float value, float step) { hashCombine(shape.hash, std::hash<int64_t>()(int64_t(std::floor(value / step + 0.5f)))); };
+    for (const auto v : vertices)
+    {
+        const auto & vertex = data.vertexBuffer[v];
+        shape.positions.push_back(localToCanonical * (vertex.position - center) / scale);
+        shape.normals.push_back(localToCanonical * vertex.normal);
+        shape.texCoords.push_back(vertex.texCoords);
+        for (size_t c = 0; c < 3; ++c)
+        {
+            quantize(shape.positions.back()[c], 1.f / 64.f);
+            quantize(shape.normals.back()[c], 1.f / 16.f);
+        }
+        quantize(vertex.texCoords.x, 1.f / 4096.f);
+        quantize(vertex.texCoords.y, 1.f / 4096.f);
+    }
+    shape.valid = true;
+    return shape;
+}
+
+bool isSameCanonicalShape(const CanonicalShape & lhs, const CanonicalShape & rhs)
+{
+    if (lhs.localIndices != rhs.localIndices || lhs.positions.size() != rhs.positions.size()) {
+        return false;
+    }
+    for (size_t v = 0; v < lhs.positions.size(); ++v)
+    {
+        if (glm::length(lhs.positions[v] - rhs.positions[v]) > InstancePositionTolerance || glm::length(lhs.normals[v] - rhs.normals[v]) > InstanceNormalTolerance
+            || glm::length(lhs.texCoords[v] - rhs.texCoords[v]) > InstanceTexCoordsTolerance) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Score of a vertex in Forsyth's algorithm: recently used vertices and vertices with few remaining triangles first
+float vertexScore(int cachePosition, uint32_t remainingTriangles)
+{
+    if (!remainingTriangles) {
+        return -1.f;
+    }
+    auto score = 0.f;
+    if (cachePosition >= 0)
+    {
+        if (cachePosition < 3) {
+            score = 0.75f; // The vertices of the last triangle are penalized, whatever the order they are used in
+        }
+        else {
+            score = std::pow(1.f - float(cachePosition - 3) / float(VertexCacheSize - 3), 1.5f);
+        }
+    }
+    return score + 2.f / std::sqrt(float(remainingTriangles));
+}
+
+// Reorder the triangles of indexCount indices in place
+void optimizeShapeVertexCache(uint32_t * indices, size_t indexCount)
+{
+    const auto triangleCount = indexCount / 3;
+    if (triangleCount < 2) {
+        return;
+    }
+
+    // Local vertex ids, and the triangles of each vertex in compressed rows
+    std::unordered_map<uint32_t, uint32_t> localIds;
+    std::vector<uint32_t> localIndices(triangleCount * 3);
+    for (size_t i = 0; i < triangleCount * 3; ++i) {
+        localIndices[i] = localIds.emplace(indices[i], uint32_t(localIds.size())).first->second;
+    }
+    const auto vertexCount = localIds.size();
+    std::vector<uint32_t> triangleOffsets(vertexCount + 1, 0);
+    for (const auto index : localIndices) {
+        ++triangleOffsets[index + 1];
+    }
+    for (size_t v = 0; v < vertexCount; ++v) {
+        triangleOffsets[v + 1] += triangleOffsets[v];
+    }
+    std::vector<uint32_t> remainingTriangles(vertexCount);
+    for (size_t v = 0; v < vertexCount; ++v) {
+        remainingTriangles[v] = triangleOffsets[v + 1] - triangleOffsets[v];
+    }
+    std::vector<uint32_t> trianglesPerVertex(triangleCount * 3);
+    {
+        auto nextTriangle = triangleOffsets;
+        for (size_t i = 0; i < triangleCount * 3; ++i) {
+            trianglesPerVertex[nextTriangle[localIndices[i]]++] = uint32_t(i / 3);
+        }
+    }
+
+    std::vector<float> vertexScores(vertexCount);
+    for (size_t v = 0; v < vertexCount; ++v) {
+        vertexScores[v] = vertexScore(-1, remainingTriangles[v]);
+    }
+    std::vector<float> triangleScores(triangleCount);
+    for (size_t t = 0; t < triangleCount; ++t) {
+        triangleScores[t] = vertexScores[localIndices[3 * t]] + vertexScores[localIndices[3 * t + 1]] + vertexScores[localIndices[3 * t + 2]];
+    }
+    std::vector<bool> emitted(triangleCount, false);
+
+    std::vector<uint32_t> cache, newCache, evicted;
+    cache.reserve(VertexCacheSize + 3);
+    newCache.reserve(VertexCacheSize + 3);
+    std::vector<uint32_t> output;
+    output.reserve(triangleCount * 3);
+    size_t nextUnemitted = 0; // Scan position when no triangle of the cache is left
+    auto bestTriangle = size_t(std::max_element(begin(triangleScores), end(triangleScores)) - begin(triangleScores));
+    for (size_t emittedCount = 0; emittedCount < triangleCount; ++emittedCount)
+    {
+        emitted[bestTriangle] = true;
+        for (size_t c = 0; c < 3; ++c) {
+            output.push_back(indices[3 * bestTriangle + c]);
+        }
+
+        // Remove the triangle from its vertices, then put them at the front of the cache
+        newCache.clear();
+        for (size_t c = 0; c < 3; ++c)
+        {
+            const auto v = localIndices[3 * bestTriangle + c];
+            const auto first = begin(trianglesPerVertex) + triangleOffsets[v];
+            const auto last = first + remainingTriangles[v];
+            std::iter_swap(std::find(first, last, uint32_t(bestTriangle)), last - 1);
+            --remainingTriangles[v];
+            newCache.push_back(v);
+        }
+        for (const auto v : cache)
+        {
+            if (v != newCache[0] && v != newCache[1] && v != newCache[2]) {
+                newCache.push_back(v);
+            }
+        }
+        evicted.clear();
+        if (newCache.size() > VertexCacheSize)
+        {
+            evicted.assign(begin(newCache) + VertexCacheSize, end(newCache));
+            newCache.resize(VertexCacheSize);
+        }
+        std::swap(cache, newCache);
+
+        // Update the scores of the cache and evicted vertices and of their triangles, then pick the best triangle of the cache
+        const auto updateVertex = [&](uint32_t v, int cachePosition)
+        {
+            const auto newScore = vertexScore(cachePosition, remainingTriangles[v]);
+            const auto delta = newScore - vertexScores[v];
+            vertexScores[v] = newScore;
+            for (auto i = triangleOffsets[v]; i < triangleOffsets[v] + remainingTriangles[v]; ++i) {
+                triangleScores[trianglesPerVertex[i]] += delta;
+            }
+        };
+        for (const auto v : evicted) {
+            updateVertex(v, -1);
+        }
+        for (size_t i = 0; i < cache.size(); ++i) {
+            updateVertex(cache[i], int(i));
+        }
+        auto bestScore = -1.f;
+        bestTriangle = triangleCount;
+        for (const auto v : cache)
+        {
+            for (auto i = triangleOffsets[v]; i < triangleOffsets[v] + remainingTriangles[v]; ++i)
+            {
+                const auto t = trianglesPerVertex[i];
+                if (triangleScores[t] > bestScore)
+                {
+                    bestScore = triangleScores[t];
+                    bestTriangle = t;
+                }
+            }
+        }
+
+        // No triangle left around the cache: continue with the first triangle not emitted yet
+        if (bestTriangle == triangleCount)
+        {
+            while (nextUnemitted < triangleCount && emitted[nextUnemitted]) {
+                ++nextUnemitted;
+            }
+            bestTriangle = nextUnemitted;
+        }
+    }
+    std::copy(begin(output), end(output), indices);
+}
+
+// Vertices of a triangle missing in a FIFO cache, that is updated
+uint32_t countCacheMisses(const uint32_t * triangle, std::vector<uint32_t> & cache)
+{
+    uint32_t misses = 0;
+    for (size_t c = 0; c < 3; ++c)
+    {
+        if (std::find(std::begin(cache), std::end(cache), triangle[c]) == std::end(cache))
+        {
+            ++misses;
+            cache.insert(std::begin(cache), triangle[c]);
+            if (cache.size() > OverdrawCacheSize) {
+                cache.pop_back();
+            }
+        }
+    }
+    return misses;
+}
+
+// Pixels covered and fragments passing the depth test in draw order when rasterizing the shape orthographically along +-X, +-Y and +-Z.
+// Back faces are culled, counter clockwise triangles being front facing as with the OpenGL defaults.
+void rasterizeShapeOverdraw(const SceneData & data, const uint32_t * indices, size_t triangleCount, size_t viewportSize, size_t & coveredPixels, size_t & shadedFragments)
+{
+    glm::vec3 bboxMin(std::numeric_limits<float>::max()), bboxMax(std::numeric_limits<float>::lowest());
+    for (size_t i = 0; i < 3 * triangleCount; ++i)
+    {
+        bboxMin = glm::min(bboxMin, data.vertexBuffer[indices[i]].position);
+        bboxMax = glm::max(bboxMax, data.vertexBuffer[indices[i]].position);
+    }
+    const auto extent = std::max(std::max(bboxMax.x - bboxMin.x, bboxMax.y - bboxMin.y), bboxMax.z - bboxMin.z);
+    if (!triangleCount || extent <= 0.f) {
+        return;
+    }
+    const auto scale = float(viewportSize - 1) / extent;
+
+    std::vector<float> depth(viewportSize * viewportSize);
+    for (size_t axis = 0; axis < 3; ++axis)
+    {
+        for (const auto direction : { 1.f, -1.f })
+        {
+            std::fill(begin(depth), end(depth), std::numeric_limits<float>::max());
+            for (size_t t = 0; t < triangleCount; ++t)
+            {
+                glm::vec3 v[3];
+                for (size_t c = 0; c < 3; ++c)
+                {
+                    const auto p = (data.vertexBuffer[indices[3 * t + c]].position - bboxMin) * scale;
+                    v[c] = glm::vec3(p[(axis + 1) % 3], p[(axis + 2) % 3], direction * p[axis]);
+                }
+                // The camera looks toward +z: front faces are clockwise in this frame for direction 1, counter clockwise for -1
+                const auto area = (v[1].x - v[0].x) * (v[2].y - v[0].y) - (v[2].x - v[0].x) * (v[1].y - v[0].y);
+                if (area * direction >= 0.f) {
+                    continue;
+                }
+                const auto xMin = size_t(std::max(0.f, std::floor(std::min(std::min(v[0].x, v[1].x), v[2].x))));
+                const auto yMin = size_t(std::max(0.f, std::floor(std::min(std::min(v[0].y, v[1].y), v[2].y))));
+                const auto xMax = std::min(viewportSize - 1, size_t(std::ceil(std::max(std::max(v[0].x, v[1].x), v[2].x))));
+                const auto yMax = std::min(viewportSize - 1, size_t(std::ceil(std::max(std::max(v[0].y, v[1].y), v[2].y))));
+                for (auto y = yMin; y <= yMax; ++y)
+                {
+                    for (auto x = xMin; x <= xMax; ++x)
+                    {
+                        const glm::vec2 p(float(x) + 0.5f, float(y) + 0.5f);
+                        const auto w0 = ((v[2].x - v[1].x) * (p.y - v[1].y) - (p.x - v[1].x) * (v[2].y - v[1].y)) / area;
+                        const auto w1 = ((v[0].x - v[2].x) * (p.y - v[2].y) - (p.x - v[2].x) * (v[0].y - v[2].y)) / area;
+                        const auto w2 = 1.f - w0 - w1;
+                        if (w0 < 0.f || w1 < 0.f || w2 < 0.f) {
+                            continue;
+                        }
+                        const auto z = w0 * v[0].z + w1 * v[1].z + w2 * v[2].z;
+                        auto & pixelDepth = depth[y * viewportSize + x];
+                        if (pixelDepth == std::numeric_limits<float>::max()) {
+                            ++coveredPixels;
+                        }
+                        if (z < pixelDepth)
+                        {
+                            pixelDepth = z;
+                            ++shadedFragments;
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+// Sander et al., Fast triangle reordering for vertex locality and reduced overdraw: the triangles are cut in clusters where the
+// cache is cold, clusters are cut again as long as their miss ratio stays below threshold times the one of the whole cluster.
+// Candidate cluster orders are then scored against the 6 axis views of rasterizeShapeOverdraw, the order shading the fewest
+// fragments is kept: Sander's view independent one (clusters facing away from the center of the shape first, since they are
+// likely to occlude the others), front to back orders for each view, and the input order so that a shape never gets worse.
+void optimizeShapeOverdraw(const SceneData & data, uint32_t * indices, size_t indexCount, float threshold)
+{
+    const auto triangleCount = indexCount / 3;
+    if (triangleCount < 2) {
+        return;
+    }
+
+    std::vector<uint32_t> cache;
+    std::vector<uint32_t> misses(triangleCount);
+    for (size_t t = 0; t < triangleCount; ++t) {
+        misses[t] = countCacheMisses(indices + 3 * t, cache);
+    }
+    std::vector<size_t> hardBoundaries;
+    for (size_t t = 0; t < triangleCount; ++t)
+    {
+        if (t == 0 || misses[t] == 3) {
+            hardBoundaries.push_back(t);
+        }
+    }
+    hardBoundaries.push_back(triangleCount);
+
+    std::vector<size_t> clusterBegins;
+    for (size_t h = 0; h + 1 < hardBoundaries.size(); ++h)
+    {
+        const auto begin = hardBoundaries[h];
+        const auto end = hardBoundaries[h + 1];
+        cache.clear();
+        size_t clusterMisses = 0;
+        for (auto t = begin; t < end; ++t) {
+            clusterMisses += countCacheMisses(indices + 3 * t, cache);
+        }
+        const auto maxRatio = threshold * float(clusterMisses) / float(end - begin);
+
+        // The cache is restarted at each cut, so that the ratio measured is the one of the new cluster
+        clusterBegins.push_back(begin);
+        cache.clear();
+        auto clusterBegin = begin;
+        size_t prefixMisses = 0;
+        for (auto t = begin; t + 1 < end; ++t)
+        {
+            prefixMisses += countCacheMisses(indices + 3 * t, cache);
+            if (t + 1 - clusterBegin >= 8 && float(prefixMisses) / float(t + 1 - clusterBegin) <= maxRatio)
+            {
+                clusterBegin = t + 1;
+                clusterBegins.push_back(clusterBegin);
+                prefixMisses = 0;
+                cache.clear();
+            }
+        }
+    }
+    clusterBegins.push_back(triangleCount);
+
+    // Area weighted centroid and normal of each cluster
+    glm::vec3 shapeCentroid(0);
+    auto shapeArea = 0.f;
+    const auto clusterCount = clusterBegins.size() - 1;
+    std::vector<glm::vec3> clusterCentroids(clusterCount, glm::vec3(0));
+    std::vector<glm::vec3> clusterNormals(clusterCount, glm::vec3(0));
+    for (size_t c = 0; c < clusterCount; ++c)
+    {
+        auto clusterArea = 0.f;
+        for (auto t = clusterBegins[c]; t < clusterBegins[c + 1]; ++t)
+        {
+            const auto & p0 = data.vertexBuffer[indices[3 * t]].position;
+            const auto & p1 = data.vertexBuffer[indices[3 * t + 1]].position;
+            const auto & p2 = data.vertexBuffer[indices[3 * t + 2]].position;
+            const auto normal = glm::cross(p1 - p0, p2 - p0);
+            const auto area = glm::length(normal);
+            clusterCentroids[c] += (p0 + p1 + p2) * (area / 3.f);
+            clusterNormals[c] += normal;
+            clusterArea += area;
+        }
+        shapeCentroid += clusterCentroids[c];
+        shapeArea += clusterArea;
+        clusterCentroids[c] = clusterArea > 0.f ? clusterCentroids[c] / clusterArea : data.vertexBuffer[indices[3 * clusterBegins[c]]].position;
+    }
+    shapeCentroid = shapeArea > 0.f ? shapeCentroid / shapeArea : glm::vec3(0);
+
+    if (clusterCount < 2) {
+        return;
+    }
+    // About 4 pixels per triangle in each view
+    const auto viewportSize = std::min(OverdrawViewportSize, MinOverdrawScoringViewportSize + size_t(2 * std::sqrt(float(triangleCount))));
+    size_t coveredPixels = 0; // Independent of the order
+    size_t bestFragments = 0;
+    rasterizeShapeOverdraw(data, indices, triangleCount, viewportSize, coveredPixels, bestFragments);
+    std::vector<uint32_t> bestOutput;
+
+    std::vector<std::pair<float, size_t>> clusterOrder(clusterCount);
+    std::vector<uint32_t> output;
+    output.reserve(3 * triangleCount);
+    const auto tryOrder = [&](const std::function<float(size_t)> & key)
+    {
+        for (size_t c = 0; c < clusterCount; ++c) {
+            clusterOrder[c] = std::make_pair(key(c), c);
+        }
+        std::stable_sort(begin(clusterOrder), end(clusterOrder), [](const std::pair<float, size_t> & a, const std::pair<float, size_t> & b) { return a.first < b.first; });
+
+        output.clear();
+        for (const auto & cluster : clusterOrder)
+        {
+            const auto c = cluster.second;
+            output.insert(end(output), indices + 3 * clusterBegins[c], indices + 3 * clusterBegins[c + 1]);
+        }
+        size_t fragments = 0;
+        rasterizeShapeOverdraw(data, output.data(), triangleCount, viewportSize, coveredPixels, fragments);
+        if (fragments < bestFragments)
+        {
+            bestFragments = fragments;
+            bestOutput.swap(output);
+        }
+    };
+
+    tryOrder([&](size_t c)
+    {
+        const auto normalLength = glm::length(clusterNormals[c]);
+        return normalLength > 0.f ? -glm::dot(clusterCentroids[c] - shapeCentroid, clusterNormals[c] / normalLength) : 0.f;
+    });
+    for (size_t axis = 0; axis < 3; ++axis)
+    {
+        for (const auto direction : { 1.f, -1.f }) {
+            tryOrder([&](size_t c) { return direction * clusterCentroids[c][axis]; });
+        }
+    }
+
+    if (!bestOutput.empty()) {
+        std::copy(begin(bestOutput), end(bestOutput), indices);
+    }
+}
+
+}
+
+void optimizeVertexCache(SceneData & data)
+{
+    const auto indexOffsets = computeIndexOffsets(data);
+    parallelFor(data.shapeCount, 1, [&](size_t begin, size_t end)
+    {
+        for (auto shape = begin; shape < end; ++shape) {
+            optimizeShapeVertexCache(data.indexBuffer.data() + indexOffsets[shape], data.indexCountPerShape[shape]);
+        }
+    });
+}
+
+float computeAverageCacheMissRatio(const SceneData & data, size_t cacheSize)
+{
+    std::vector<uint32_t> cache;
+    size_t missCount = 0;
+    size_t triangleCount = 0;
+    size_t offset = 0;
+    for (size_t shape = 0; shape < data.shapeCount; ++shape)
+    {
+        cache.clear();
+        const auto count = data.indexCountPerShape[shape] - data.indexCountPerShape[shape] % 3;
+        for (size_t i = 0; i < count; ++i)
+        {
+            const auto index = data.indexBuffer[offset + i];
+            if (std::find(begin(cache), end(cache), index) == end(cache))
+            {
+                ++missCount;
+                cache.insert(begin(cache), index);
+                if (cache.size() > cacheSize) {
+                    cache.pop_back();
+                }
+            }
+        }
+        triangleCount += count / 3;
+        offset += data.indexCountPerShape[shape];
+    }
+    return triangleCount ? float(missCount) / float(triangleCount) : 0.f;
+}
+
+void optimizeOverdraw(SceneData & data, float threshold)
+{
+    const auto indexOffsets = computeIndexOffsets(data);
+    parallelFor(data.shapeCount, 1, [&](size_t begin, size_t end)
+    {
+        for (auto shape = begin; shape < end; ++shape) {
+            optimizeShapeOverdraw(data, data.indexBuffer.data() + indexOffsets[shape], data.indexCountPerShape[shape], threshold);
+        }
+    });
+}
+
+float computeOverdrawRatio(const SceneData & data)
+{
+    const auto indexOffsets = computeIndexOffsets(data);
+    std::vector<size_t> coveredPixels(data.shapeCount, 0), shadedFragments(data.shapeCount, 0);
+    parallelFor(data.shapeCount, 1, [&](size_t begin, size_t end)
+    {
+        for (auto shape = begin; shape < end; ++shape) {
+            rasterizeShapeOverdraw(data, data.indexBuffer.data() + indexOffsets[shape], data.indexCountPerShape[shape] / 3, OverdrawViewportSize,
+                coveredPixels[shape], shadedFragments[shape]);
+        }
+    });
+    size_t covered = 0, shaded = 0;
+    for (size_t shape = 0; shape < data.shapeCount; ++shape)
+    {
+        covered += coveredPixels[shape];
+        shaded += shadedFragments[shape];
+    }
+    return covered ? float(shaded) / float(covered) : 1.f;
+}
+
+void mergeShapesByMaterial(SceneData & data, float gridCellSize)
+{
+    const auto indexOffsets = computeIndexOffsets(data);
+
+    // Vertices of shapes with a transformation are copied in world space, once per distinct matrix
+    std::vector<glm::mat4> matrices(1, glm::mat4(1));
+    std::vector<size_t> matrixPerShape(data.shapeCount, 0);
+    for (size_t shape = 0; shape < data.shapeCount; ++shape)
+    {
+        const auto & matrix = data.localToWorldMatrixPerShape[shape];
+        if (matrix != glm::mat4(1) && !isInstanced(data, shape))
+        {
+            const auto it = std::find(begin(matrices) + 1, end(matrices), matrix);
+            matrixPerShape[shape] = size_t(it - begin(matrices));
+            if (it == end(matrices)) {
+                matrices.push_back(matrix);
+            }
+        }
+    }
+    const auto hasTangents = data.tangentBuffer.size() == data.vertexBuffer.size();
+    std::vector<std::unordered_map<uint32_t, uint32_t>> worldVertices(matrices.size());
+    for (size_t shape = 0; shape < data.shapeCount; ++shape)
+    {
+        const auto matrixIndex = matrixPerShape[shape];
+        if (!matrixIndex) {
+            continue;
+        }
+        const auto & matrix = matrices[matrixIndex];
+        const auto normalMatrix = glm::transpose(glm::inverse(glm::mat3(matrix)));
+        const auto mirrored = glm::determinant(glm::mat3(matrix)) < 0.f;
+        auto indices = data.indexBuffer.data() + indexOffsets[shape];
+        for (size_t i = 0; i < data.indexCountPerShape[shape]; ++i)
+        {
+            const auto inserted = worldVertices[matrixIndex].emplace(indices[i], uint32_t(data.vertexBuffer.size()));
+            if (inserted.second)
+            {
+                auto vertex = data.vertexBuffer[indices[i]];
+                vertex.position = glm::vec3(matrix * glm::vec4(vertex.position, 1));
+                vertex.normal = vertex.normal != glm::vec3(0) ? glm::normalize(normalMatrix * vertex.normal) : vertex.normal;
+                if (hasTangents)
+                {
+                    const auto tangent = data.tangentBuffer[indices[i]];
+                    const auto worldTangent = glm::mat3(matrix) * glm::vec3(tangent);
+                    data.tangentBuffer.emplace_back(glm::length(worldTangent) > 0.f ? glm::normalize(worldTangent) : worldTangent, mirrored ? -tangent.w : tangent.w);
+                }
+                data.vertexBuffer.push_back(vertex);
+            }
+            indices[i] = inserted.first->second;
+        }
+        if (mirrored)
+        {
+            for (size_t i = 0; i + 2 < data.indexCountPerShape[shape]; i += 3) {
+                std::swap(indices[i + 1], indices[i + 2]); // Keep front faces front facing
+            }
+        }
+    }
+
+    // Batch of each triangle: its material, its shape if instanced, and the grid cell of its centroid. Batches are numbered in key order.
+    using BatchKey = std::tuple<int32_t, int64_t, int, int, int>;
+    const auto getBatchKey = [&](size_t shape, size_t firstIndex)
+    {
+        if (isInstanced(data, shape)) {
+            return BatchKey(data.materialIDPerShape[shape], int64_t(shape), 0, 0, 0);
+        }
+        glm::ivec3 cell(0);
+        if (gridCellSize > 0.f)
+        {
+            const auto centroid = (data.vertexBuffer[data.indexBuffer[firstIndex]].position + data.vertexBuffer[data.indexBuffer[firstIndex + 1]].position
+                + data.vertexBuffer[data.indexBuffer[firstIndex + 2]].position) / 3.f;
+            cell = glm::ivec3(glm::floor((centroid - data.bboxMin) / gridCellSize));
+        }
+        return BatchKey(data.materialIDPerShape[shape], -1, cell.x, cell.y, cell.z);
+    };
+    std::map<BatchKey, uint32_t> batchIds;
+    for (size_t shape = 0; shape < data.shapeCount; ++shape)
+    {
+        for (size_t i = 0; i + 2 < data.indexCountPerShape[shape]; i += 3) {
+            batchIds.emplace(getBatchKey(shape, indexOffsets[shape] + i), 0);
+        }
+    }
+    std::vector<int32_t> materialPerBatch;
+    for (auto & batch : batchIds)
+    {
+        batch.second = uint32_t(materialPerBatch.size());
+        materialPerBatch.push_back(std::get<0>(batch.first));
+    }
+
+    // Counting sort of the triangles by batch, keeping their order within each batch
+    std::vector<uint32_t> batchPerTriangle;
+    batchPerTriangle.reserve(data.indexBuffer.size() / 3);
+    std::vector<uint32_t> indexCountPerBatch(materialPerBatch.size(), 0);
+    for (size_t shape = 0; shape < data.shapeCount; ++shape)
+    {
+        for (size_t i = 0; i + 2 < data.indexCountPerShape[shape]; i += 3)
+        {
+            batchPerTriangle.push_back(batchIds[getBatchKey(shape, indexOffsets[shape] + i)]);
+            indexCountPerBatch[batchPerTriangle.back()] += 3;
+        }
+    }
+    std::vector<size_t> nextIndexPerBatch(materialPerBatch.size(), 0);
+    for (size_t batch = 1; batch < materialPerBatch.size(); ++batch) {
+        nextIndexPerBatch[batch] = nextIndexPerBatch[batch - 1] + indexCountPerBatch[batch - 1];
+    }
+    std::vector<uint32_t> indexBuffer(batchPerTriangle.size() * 3);
+    size_t triangle = 0;
+    for (size_t shape = 0; shape < data.shapeCount; ++shape)
+    {
+        for (size_t i = 0; i + 2 < data.indexCountPerShape[shape]; i += 3)
+        {
+            auto & next = nextIndexPerBatch[batchPerTriangle[triangle++]];
+            std::copy(data.indexBuffer.begin() + indexOffsets[shape] + i, data.indexBuffer.begin() + indexOffsets[shape] + i + 3, indexBuffer.begin() + next);
+            next += 3;
+        }
+    }
+
+    // Instanced shapes keep their matrix and instances
+    std::vector<glm::mat4> localToWorldMatrixPerBatch(materialPerBatch.size(), glm::mat4(1));
+    std::vector<uint32_t> instanceCountPerBatch;
+    std::vector<glm::mat4> instanceMatrices;
+    if (!data.instanceCountPerShape.empty())
+    {
+        std::vector<size_t> instanceOffsets(data.shapeCount, 0);
+        for (size_t shape = 1; shape < data.shapeCount; ++shape) {
+            instanceOffsets[shape] = instanceOffsets[shape - 1] + getInstanceCount(data, shape - 1) - 1;
+        }
+        instanceCountPerBatch.assign(materialPerBatch.size(), 1);
+        for (const auto & batch : batchIds)
+        {
+            const auto shape = std::get<1>(batch.first);
+            if (shape >= 0)
+            {
+                localToWorldMatrixPerBatch[batch.second] = data.localToWorldMatrixPerShape[shape];
+                instanceCountPerBatch[batch.second] = data.instanceCountPerShape[shape];
+                instanceMatrices.insert(end(instanceMatrices), begin(data.instanceMatrices) + instanceOffsets[shape],
+                    begin(data.instanceMatrices) + instanceOffsets[shape] + data.instanceCountPerShape[shape] - 1);
+            }
+        }
+    }
+
+    data.indexBuffer = std::move(indexBuffer);
+    data.shapeCount = materialPerBatch.size();
+    data.indexCountPerShape = std::move(indexCountPerBatch);
+    data.materialIDPerShape = std::move(materialPerBatch);
+    data.localToWorldMatrixPerShape = std::move(localToWorldMatrixPerBatch);
+    data.instanceCountPerShape = std::move(instanceCountPerBatch);
+    data.instanceMatrices = std::move(instanceMatrices);
+
+    // Local vertices only used by transformed shapes are dropped
+    removeUnusedVertices(data);
+}
+
+void detectInstances(SceneData & data)
+{
+    const auto indexOffsets = computeIndexOffsets(data);
+    std::vector<CanonicalShape> canonicalShapes(data.shapeCount);
+    parallelFor(data.shapeCount, 1, [&](size_t begin, size_t end)
+    {
+        for (size_t shape = begin; shape < end; ++shape)
+        {
+            if (!isInstanced(data, shape)) {
+                canonicalShapes[shape] = computeCanonicalShape(data, data.indexBuffer.data() + indexOffsets[shape], data.indexCountPerShape[shape], data.materialIDPerShape[shape]);
+            }
+        }
+    });
+
+    // Each shape is compared to the kept shapes with the same hash
+    std::unordered_map<size_t, std::vector<size_t>> keptShapesPerHash;
+    std::vector<std::vector<glm::mat4>> extraInstancesPerShape(data.shapeCount);
+    std::vector<bool> isDuplicate(data.shapeCount, false);
+    size_t instanceOffset = 0;
+    for (size_t shape = 0; shape < data.shapeCount; ++shape)
+    {
+        const auto instanceCount = getInstanceCount(data, shape);
+        extraInstancesPerShape[shape].assign(begin(data.instanceMatrices) + instanceOffset, begin(data.instanceMatrices) + instanceOffset + instanceCount - 1);
+        instanceOffset += instanceCount - 1;
+
+        const auto & canonicalShape = canonicalShapes[shape];
+        if (!canonicalShape.valid) {
+            continue;
+        }
+        auto & keptShapes = keptShapesPerHash[canonicalShape.hash];
+        const auto keptShape = std::find_if(begin(keptShapes), end(keptShapes), [&](size_t kept)
+        {
+            return data.materialIDPerShape[kept] == data.materialIDPerShape[shape] && isSameCanonicalShape(canonicalShapes[kept], canonicalShape);
+        });
+        if (keptShape == end(keptShapes))
+        {
+            keptShapes.push_back(shape);
+            continue;
+        }
+
+        // The vertices of the duplicate are the ones of the kept shape, moved from its frame to the frame of the duplicate
+        const auto keptToDuplicate = canonicalShape.canonicalToLocal * glm::inverse(canonicalShapes[*keptShape].canonicalToLocal);
+        extraInstancesPerShape[*keptShape].push_back(data.localToWorldMatrixPerShape[shape] * keptToDuplicate);
+        isDuplicate[shape] = true;
+    }
+    if (std::find(begin(isDuplicate), end(isDuplicate), true) == end(isDuplicate)) {
+        return;
+    }
+
+    std::vector<uint32_t> indexBuffer;
+    std::vector<uint32_t> indexCountPerShape;
+    std::vector<glm::mat4> localToWorldMatrixPerShape;
+    std::vector<int32_t> materialIDPerShape;
+    std::vector<uint32_t> instanceCountPerShape;
+    std::vector<glm::mat4> instanceMatrices;
+    for (size_t shape = 0; shape < data.shapeCount; ++shape)
+    {
+        if (isDuplicate[shape]) {
+            continue;
+        }
+        indexBuffer.insert(end(indexBuffer), begin(data.indexBuffer) + indexOffsets[shape], begin(data.indexBuffer) + indexOffsets[shape] + data.indexCountPerShape[shape]);
+        indexCountPerShape.push_back(data.indexCountPerShape[shape]);
+        localToWorldMatrixPerShape.push_back(data.localToWorldMatrixPerShape[shape]);
+        materialIDPerShape.push_back(data.materialIDPerShape[shape]);
+        instanceCountPerShape.push_back(uint32_t(extraInstancesPerShape[shape].size() + 1));
+        instanceMatrices.insert(end(instanceMatrices), begin(extraInstancesPerShape[shape]), end(extraInstancesPerShape[shape]));
+    }
+    data.indexBuffer = std::move(indexBuffer);
+    data.shapeCount = indexCountPerShape.size();
+    data.indexCountPerShape = std::move(indexCountPerShape);
+    data.localToWorldMatrixPerShape = std::move(localToWorldMatrixPerShape);
+    data.materialIDPerShape = std::move(materialIDPerShape);
+    data.instanceCountPerShape = std::move(instanceCountPerShape);
+    data.instanceMatrices = std::move(instanceMatrices);
+    removeUnusedVertices(data);
+}
+
+}
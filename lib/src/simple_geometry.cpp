@@ -1,9 +1,22 @@
 #include <glmlv/simple_geometry.hpp>
 #include <glm/gtc/constants.hpp>
 
+#include <limits>
+
 namespace glmlv
 {
 
+SimpleGeometry::SimpleGeometry(std::vector<Vertex3f3f2f> vertices, const std::vector<uint32_t> & indices):
+    vertexBuffer(std::move(vertices))
+{
+    if (vertexBuffer.size() <= std::numeric_limits<uint16_t>::max() + size_t(1)) {
+        shortIndexBuffer.assign(begin(indices), end(indices));
+    }
+    else {
+        intIndexBuffer = indices;
+    }
+}
+
 SimpleGeometry makeTriangle()
 {
     std::vector<Vertex3f3f2f> vertexBuffer =
@@ -18,7 +31,7 @@ SimpleGeometry makeTriangle()
         0, 1, 2
     };
 
-    return{ vertexBuffer, indexBuffer };
+    return SimpleGeometry(std::move(vertexBuffer), indexBuffer);
 }
 
 SimpleGeometry makeCube()
@@ -73,7 +86,7 @@ SimpleGeometry makeCube()
         20, 22, 23
     };
 
-    return{ vertexBuffer, indexBuffer };
+    return SimpleGeometry(std::move(vertexBuffer), indexBuffer);
 }
 
 SimpleGeometry makeSphere(uint32_t subdivLongitude)
@@ -119,7 +132,7 @@ SimpleGeometry makeSphere(uint32_t subdivLongitude)
         }
     }
 
-    return{ vertexBuffer, indexBuffer };
+    return SimpleGeometry(std::move(vertexBuffer), indexBuffer);
 }
 
 }
\ No newline at end of file
@@ -0,0 +1,244 @@
+#include <glmlv/tangent_space.hpp>
+#include <glmlv/parallel.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <unordered_map>
+#include <glm/gtx/hash.hpp>
+
+namespace glmlv
+{
+
+namespace
+{
+
+const uint32_t NoVertex = std::numeric_limits<uint32_t>::max();
+
+std::vector<size_t> computeIndexOffsets(const SceneData & data)
+{
+    std::vector<size_t> indexOffsets(data.shapeCount, 0);
+    for (size_t i = 1; i < data.shapeCount; ++i) {
+        indexOffsets[i] = indexOffsets[i - 1] + data.indexCountPerShape[i - 1];
+    }
+    return indexOffsets;
+}
+
+// Angle of a triangle at its corner c
+float cornerAngle(const glm::vec3 * positions, size_t c)
+{
+    const auto a = positions[(c + 1) % 3] - positions[c];
+    const auto b = positions[(c + 2) % 3] - positions[c];
+    const auto lengths = glm::length(a) * glm::length(b);
+    return lengths > 0.f ? std::acos(glm::clamp(glm::dot(a, b) / lengths, -1.f, 1.f)) : 0.f;
+}
+
+// Any unit vector orthogonal to n
+glm::vec3 orthogonalVector(const glm::vec3 & n)
+{
+    const auto axis = std::abs(n.x) < 0.9f ? glm::vec3(1, 0, 0) : glm::vec3(0, 1, 0);
+    return glm::normalize(glm::cross(n, axis));
+}
+
+glm::vec3 orthogonalizeTangent(const glm::vec3 & tangent, const glm::vec3 & normal)
+{
+    const auto t = tangent - normal * glm::dot(normal, tangent);
+    const auto length = glm::length(t);
+    if (length > 1e-8f) {
+        return t / length;
+    }
+    return glm::dot(normal, normal) > 0.f ? orthogonalVector(glm::normalize(normal)) : glm::vec3(1, 0, 0);
+}
+
+struct Contribution
+{
+    uint32_t target;
+    glm::vec3 value;
+};
+
+}
+
+void computeMissingNormals(SceneData & data)
+{
+    if (std::none_of(begin(data.vertexBuffer), end(data.vertexBuffer), [](const Vertex3f3f2f & vertex) { return vertex.normal == glm::vec3(0); })) {
+        return;
+    }
+
+    // Vertices without normal are welded by position within their shape only, distinct objects touching each other are not smoothed
+    // together. Each shape lists the welded normal of its vertices, summed afterwards for the vertices shared by several shapes.
+    const auto indexOffsets = computeIndexOffsets(data);
+    std::vector<std::vector<Contribution>> contributionsPerShape(data.shapeCount);
+    parallelFor(data.shapeCount, 1, [&](size_t begin, size_t end)
+    {
+        std::unordered_map<glm::vec3, uint32_t> positionIdMap;
+        std::unordered_map<uint32_t, uint32_t> positionIdPerVertex;
+        std::vector<uint32_t> positionIds;
+        std::vector<glm::vec3> normals;
+        for (auto shape = begin; shape < end; ++shape)
+        {
+            const auto indices = data.indexBuffer.data() + indexOffsets[shape];
+            const auto indexCount = data.indexCountPerShape[shape] - data.indexCountPerShape[shape] % 3;
+            positionIdMap.clear();
+            positionIdPerVertex.clear();
+            positionIds.assign(indexCount, NoVertex);
+            for (size_t i = 0; i < indexCount; ++i)
+            {
+                const auto & vertex = data.vertexBuffer[indices[i]];
+                if (vertex.normal == glm::vec3(0))
+                {
+                    const auto positionId = positionIdMap.emplace(vertex.position, uint32_t(positionIdMap.size())).first->second;
+                    positionIds[i] = positionIdPerVertex.emplace(indices[i], positionId).first->second;
+                }
+            }
+            if (positionIdMap.empty()) {
+                continue;
+            }
+
+            normals.assign(positionIdMap.size(), glm::vec3(0));
+            for (size_t t = 0; t < indexCount; t += 3)
+            {
+                const auto ids = positionIds.data() + t;
+                if (ids[0] == NoVertex && ids[1] == NoVertex && ids[2] == NoVertex) {
+                    continue;
+                }
+                const glm::vec3 positions[] = { data.vertexBuffer[indices[t]].position, data.vertexBuffer[indices[t + 1]].position, data.vertexBuffer[indices[t + 2]].position };
+                const auto normal = glm::cross(positions[1] - positions[0], positions[2] - positions[0]);
+                const auto length = glm::length(normal);
+                if (length <= 0.f) {
+                    continue;
+                }
+                for (size_t c = 0; c < 3; ++c)
+                {
+                    if (ids[c] != NoVertex) {
+                        normals[ids[c]] += normal * (cornerAngle(positions, c) / length);
+                    }
+                }
+            }
+
+            auto & contributions = contributionsPerShape[shape];
+            contributions.reserve(positionIdPerVertex.size());
+            for (const auto & vertex : positionIdPerVertex) {
+                contributions.push_back({ vertex.first, normals[vertex.second] });
+            }
+        }
+    });
+
+    std::vector<glm::vec3> normals(data.vertexBuffer.size(), glm::vec3(0));
+    for (const auto & contributions : contributionsPerShape)
+    {
+        for (const auto & contribution : contributions) {
+            normals[contribution.target] += contribution.value;
+        }
+    }
+    parallelFor(data.vertexBuffer.size(), 4096, [&](size_t begin, size_t end)
+    {
+        for (auto v = begin; v < end; ++v)
+        {
+            if (data.vertexBuffer[v].normal == glm::vec3(0))
+            {
+                const auto length = glm::length(normals[v]);
+                data.vertexBuffer[v].normal = length > 0.f ? normals[v] / length : glm::vec3(0); // Unused vertices and vertices of degenerate triangles
+            }
+        }
+    });
+}
+
+void computeTangents(SceneData & data)
+{
+    // Tangent of each triangle, weighted by the angle of each corner. Contributions of triangles with a negative bitangent sign
+    // target vertex + vertexCount.
+    const auto vertexCount = uint32_t(data.vertexBuffer.size());
+    const auto indexOffsets = computeIndexOffsets(data);
+    std::vector<std::vector<Contribution>> contributionsPerShape(data.shapeCount);
+    std::vector<std::vector<bool>> negativeTrianglesPerShape(data.shapeCount);
+    parallelFor(data.shapeCount, 1, [&](size_t begin, size_t end)
+    {
+        for (auto shape = begin; shape < end; ++shape)
+        {
+            auto & contributions = contributionsPerShape[shape];
+            auto & negativeTriangles = negativeTrianglesPerShape[shape];
+            const auto indices = data.indexBuffer.data() + indexOffsets[shape];
+            const auto triangleCount = data.indexCountPerShape[shape] / 3;
+            negativeTriangles.resize(triangleCount, false);
+            for (size_t t = 0; t < triangleCount; ++t)
+            {
+                const Vertex3f3f2f * vertices[] = { &data.vertexBuffer[indices[3 * t]], &data.vertexBuffer[indices[3 * t + 1]], &data.vertexBuffer[indices[3 * t + 2]] };
+                const glm::vec3 positions[] = { vertices[0]->position, vertices[1]->position, vertices[2]->position };
+                const auto e1 = positions[1] - positions[0];
+                const auto e2 = positions[2] - positions[0];
+                const auto uv1 = vertices[1]->texCoords - vertices[0]->texCoords;
+                const auto uv2 = vertices[2]->texCoords - vertices[0]->texCoords;
+                const auto determinant = uv1.x * uv2.y - uv2.x * uv1.y;
+                if (std::abs(determinant) < 1e-20f) {
+                    continue;
+                }
+                const auto tangent = (e1 * uv2.y - e2 * uv1.y) / determinant;
+                const auto bitangent = (e2 * uv1.x - e1 * uv2.x) / determinant;
+                const auto tangentLength = glm::length(tangent);
+                if (tangentLength <= 0.f) {
+                    continue;
+                }
+                const auto negative = glm::dot(glm::cross(glm::cross(e1, e2), tangent), bitangent) < 0.f;
+                negativeTriangles[t] = negative;
+                for (size_t c = 0; c < 3; ++c) {
+                    contributions.push_back({ indices[3 * t + c] + (negative ? vertexCount : 0), tangent * (cornerAngle(positions, c) / tangentLength) });
+                }
+            }
+        }
+    });
+
+    std::vector<glm::vec3> tangents(2 * size_t(vertexCount), glm::vec3(0));
+    std::vector<bool> used(2 * size_t(vertexCount), false);
+    for (const auto & contributions : contributionsPerShape)
+    {
+        for (const auto & contribution : contributions)
+        {
+            tangents[contribution.target] += contribution.value;
+            used[contribution.target] = true;
+        }
+    }
+
+    // Vertices used with both signs are split, the copy is used by the triangles with a negative sign
+    std::vector<uint32_t> negativeVertices(vertexCount, NoVertex);
+    for (uint32_t v = 0; v < vertexCount; ++v)
+    {
+        if (used[v] && used[vertexCount + v])
+        {
+            negativeVertices[v] = uint32_t(data.vertexBuffer.size());
+            data.vertexBuffer.push_back(data.vertexBuffer[v]);
+        }
+    }
+    data.tangentBuffer.resize(data.vertexBuffer.size());
+    parallelFor(vertexCount, 4096, [&](size_t begin, size_t end)
+    {
+        for (auto v = begin; v < end; ++v)
+        {
+            const auto & normal = data.vertexBuffer[v].normal;
+            const auto negativeOnly = used[vertexCount + v] && !used[v];
+            data.tangentBuffer[v] = glm::vec4(orthogonalizeTangent(tangents[negativeOnly ? vertexCount + v : v], normal), negativeOnly ? -1.f : 1.f);
+            if (negativeVertices[v] != NoVertex) {
+                data.tangentBuffer[negativeVertices[v]] = glm::vec4(orthogonalizeTangent(tangents[vertexCount + v], normal), -1.f);
+            }
+        }
+    });
+    parallelFor(data.shapeCount, 1, [&](size_t begin, size_t end)
+    {
+        for (auto shape = begin; shape < end; ++shape)
+        {
+            const auto indices = data.indexBuffer.data() + indexOffsets[shape];
+            const auto & negativeTriangles = negativeTrianglesPerShape[shape];
+            for (size_t t = 0; t < negativeTriangles.size(); ++t)
+            {
+                for (size_t c = 0; negativeTriangles[t] && c < 3; ++c)
+                {
+                    const auto index = indices[3 * t + c];
+                    if (negativeVertices[index] != NoVertex) {
+                        indices[3 * t + c] = negativeVertices[index];
+                    }
+                }
+            }
+        }
+    });
+}
+
+}
@@ -0,0 +1,785 @@
+#include <glmlv/CompressedImage2D.hpp>
+#include <glmlv/parallel.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <sstream>
+#include <iomanip>
+#include <stdexcept>
+#include <thread>
+
+namespace glmlv
+{
+
+namespace
+{
+
+// Bump when the output of the encoders changes, to invalidate existing cache entries
+const uint32_t EncoderVersion = 1;
+
+const uint32_t CacheFileMagic = 0x43544c47; // "GLTC"
+
+// Block rows are distributed to threads by chunks of this size
+const size_t MinBlockRowsPerTask = 8;
+
+// 4x4 texels, row major
+struct Block
+{
+    unsigned char texels[16][4];
+};
+
+void fetchBlock(const unsigned char * level, size_t width, size_t height, size_t blockX, size_t blockY, Block & block)
+{
+    // Texels outside of the level (levels smaller than 4x4 or not multiple of 4) replicate the border
+    for (size_t y = 0; y < 4; ++y)
+    {
+        const auto srcY = std::min(blockY * 4 + y, height - 1);
+        for (size_t x = 0; x < 4; ++x)
+        {
+            const auto srcX = std::min(blockX * 4 + x, width - 1);
+            std::memcpy(block.texels[y * 4 + x], level + (srcY * width + srcX) * 4, 4);
+        }
+    }
+}
+
+inline int clampInt(int value, int min, int max)
+{
+    return std::min(std::max(value, min), max);
+}
+
+inline int square(int value)
+{
+    return value * value;
+}
+
+// BC1 color block (8 bytes): two RGB565 endpoints and 2 bits per texel interpolation indices
+
+inline uint16_t packRGB565(const float color[3])
+{
+    const auto r = clampInt(int(color[0] * 31.f / 255.f + 0.5f), 0, 31);
+    const auto g = clampInt(int(color[1] * 63.f / 255.f + 0.5f), 0, 63);
+    const auto b = clampInt(int(color[2] * 31.f / 255.f + 0.5f), 0, 31);
+    return uint16_t((r << 11) | (g << 5) | b);
+}
+
+inline void unpackRGB565(uint16_t value, int color[3])
+{
+    const int r = value >> 11, g = (value >> 5) & 63, b = value & 31;
+    color[0] = (r << 3) | (r >> 2);
+    color[1] = (g << 2) | (g >> 4);
+    color[2] = (b << 3) | (b >> 2);
+}
+
+void encodeBC1(const Block & block, unsigned char * out)
+{
+    // Endpoints are the extremities of the texels projected on the principal axis of the block colors
+    float mean[3] = { 0.f, 0.f, 0.f };
+    for (const auto & texel : block.texels) {
+        for (size_t c = 0; c < 3; ++c) {
+            mean[c] += texel[c];
+        }
+    }
+    for (auto & c : mean) {
+        c /= 16.f;
+    }
+
+    float covariance[6] = { 0.f }; // xx, xy, xz, yy, yz, zz
+    for (const auto & texel : block.texels)
+    {
+        const float d[3] = { texel[0] - mean[0], texel[1] - mean[1], texel[2] - mean[2] };
+        covariance[0] += d[0] * d[0];
+        covariance[1] += d[0] * d[1];
+        covariance[2] += d[0] * d[2];
+        covariance[3] += d[1] * d[1];
+        covariance[4] += d[1] * d[2];
+        covariance[5] += d[2] * d[2];
+    }
+
+    float axis[3] = { 1.f, 1.f, 1.f };
+    for (size_t iteration = 0; iteration < 8; ++iteration) // Power iteration
+    {
+        const float x = covariance[0] * axis[0] + covariance[1] * axis[1] + covariance[2] * axis[2];
+        const float y = covariance[1] * axis[0] + covariance[3] * axis[1] + covariance[4] * axis[2];
+        const float z = covariance[2] * axis[0] + covariance[4] * axis[1] + covariance[5] * axis[2];
+        const float norm = std::max(std::abs(x), std::max(std::abs(y), std::abs(z)));
+        if (norm <= 0.f) {
+            break;
+        }
+        axis[0] = x / norm;
+        axis[1] = y / norm;
+        axis[2] = z / norm;
+    }
+    const float axisLength2 = axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2];
+
+    float tMin = 0.f, tMax = 0.f;
+    for (const auto & texel : block.texels)
+    {
+        const float t = ((texel[0] - mean[0]) * axis[0] + (texel[1] - mean[1]) * axis[1] + (texel[2] - mean[2]) * axis[2]) / axisLength2;
+        tMin = std::min(tMin, t);
+        tMax = std::max(tMax, t);
+    }
+    // Inset the endpoints to reduce the error on the interpolated colors
+    const float inset = (tMax - tMin) / 16.f;
+    tMin += inset;
+    tMax -= inset;
+
+    float endpoint0[3], endpoint1[3];
+    for (size_t c = 0; c < 3; ++c)
+    {
+        endpoint0[c] = mean[c] + axis[c] * tMax;
+        endpoint1[c] = mean[c] + axis[c] * tMin;
+    }
+
+    auto color0 = packRGB565(endpoint0);
+    auto color1 = packRGB565(endpoint1);
+    if (color0 < color1) {
+        std::swap(color0, color1); // color0 > color1 selects the opaque 4 colors mode
+    }
+
+    uint32_t indices = 0;
+    if (color0 != color1)
+    {
+        int palette[4][3];
+        unpackRGB565(color0, palette[0]);
+        unpackRGB565(color1, palette[1]);
+        for (size_t c = 0; c < 3; ++c)
+        {
+            palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+            palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+        }
+
+        for (size_t i = 0; i < 16; ++i)
+        {
+            const auto * texel = block.texels[i];
+            uint32_t bestIndex = 0;
+            int bestError = std::numeric_limits<int>::max();
+            for (uint32_t p = 0; p < 4; ++p)
+            {
+                const int error = square(texel[0] - palette[p][0]) + square(texel[1] - palette[p][1]) + square(texel[2] - palette[p][2]);
+                if (error < bestError) {
+                    bestError = error;
+                    bestIndex = p;
+                }
+            }
+            indices |= bestIndex << (2 * i);
+        }
+    }
+
+    out[0] = color0 & 0xFF;
+    out[1] = color0 >> 8;
+    out[2] = color1 & 0xFF;
+    out[3] = color1 >> 8;
+    for (size_t i = 0; i < 4; ++i) {
+        out[4 + i] = (indices >> (8 * i)) & 0xFF;
+    }
+}
+
+// BC4 single channel block (8 bytes): two 8 bits endpoints and 3 bits per texel interpolation indices
+
+void encodeBC4(const Block & block, size_t channel, unsigned char * out)
+{
+    int min = 255, max = 0;
+    for (const auto & texel : block.texels)
+    {
+        min = std::min(min, int(texel[channel]));
+        max = std::max(max, int(texel[channel]));
+    }
+
+    // max > min selects the 8 values mode: index 0 is max, 1 is min, 2 to 7 interpolate from max to min
+    out[0] = (unsigned char)max;
+    out[1] = (unsigned char)min;
+
+    uint64_t indices = 0;
+    if (max > min)
+    {
+        for (size_t i = 0; i < 16; ++i)
+        {
+            const auto step = (2 * 7 * (block.texels[i][channel] - min) + (max - min)) / (2 * (max - min)); // Rounded position in [0, 7] from min to max
+            const uint64_t index = step == 7 ? 0 : step == 0 ? 1 : 8 - step;
+            indices |= index << (3 * i);
+        }
+    }
+    for (size_t i = 0; i < 6; ++i) {
+        out[2 + i] = (indices >> (8 * i)) & 0xFF;
+    }
+}
+
+// ETC1 compatible ETC2 RGB block (8 bytes, big endian): two sub-blocks of 2x4 or 4x2 texels,
+// each with a base color and a table of luminance modifiers, and 2 bits per texel modifier indices.
+// Differential mode deltas are kept in range, so that ETC2 decoders never interpret the block as T, H or planar modes.
+
+const int ETC1Modifiers[8][4] = {
+    { 2, 8, -2, -8 },
+    { 5, 17, -5, -17 },
+    { 9, 29, -9, -29 },
+    { 13, 42, -13, -42 },
+    { 18, 60, -18, -60 },
+    { 24, 80, -24, -80 },
+    { 33, 106, -33, -106 },
+    { 47, 183, -47, -183 }
+};
+
+struct ETC1SubBlockFit
+{
+    int error = std::numeric_limits<int>::max();
+    uint32_t table = 0;
+    uint32_t indices[8];
+};
+
+// texelIds are indices of texels in the block, row major
+ETC1SubBlockFit fitETC1SubBlock(const Block & block, const size_t texelIds[8], const int baseColor[3])
+{
+    ETC1SubBlockFit best;
+    for (uint32_t table = 0; table < 8; ++table)
+    {
+        ETC1SubBlockFit fit;
+        fit.error = 0;
+        fit.table = table;
+        for (size_t i = 0; i < 8 && fit.error < best.error; ++i)
+        {
+            const auto * texel = block.texels[texelIds[i]];
+            int bestError = std::numeric_limits<int>::max();
+            for (uint32_t m = 0; m < 4; ++m)
+            {
+                const auto modifier = ETC1Modifiers[table][m];
+                const int error = square(clampInt(baseColor[0] + modifier, 0, 255) - texel[0])
+                    + square(clampInt(baseColor[1] + modifier, 0, 255) - texel[1])
+                    + square(clampInt(baseColor[2] + modifier, 0, 255) - texel[2]);
+                if (error < bestError) {
+                    bestError = error;
+                    fit.indices[i] = m;
+                }
+            }
+            fit.error += bestError;
+        }
+        if (fit.error < best.error) {
+            best = fit;
+        }
+    }
+    return best;
+}
+
+void encodeETC2RGB(const Block & block, unsigned char * out)
+{
+    int bestError = std::numeric_limits<int>::max();
+    uint64_t bestBits = 0;
+
+    for (uint32_t flip = 0; flip < 2; ++flip)
+    {
+        // flip = 0: left and right 2x4 sub-blocks, flip = 1: top and bottom 4x2 sub-blocks
+        size_t texelIds[2][8];
+        for (size_t s = 0; s < 2; ++s)
+        {
+            size_t i = 0;
+            for (size_t y = 0; y < 4; ++y) {
+                for (size_t x = 0; x < 4; ++x) {
+                    if ((flip ? y / 2 : x / 2) == s) {
+                        texelIds[s][i++] = y * 4 + x;
+                    }
+                }
+            }
+        }
+
+        float average[2][3];
+        for (size_t s = 0; s < 2; ++s)
+        {
+            for (size_t c = 0; c < 3; ++c)
+            {
+                int sum = 0;
+                for (auto id : texelIds[s]) {
+                    sum += block.texels[id][c];
+                }
+                average[s][c] = sum / 8.f;
+            }
+        }
+
+        // Differential mode: 5 bits base colors, the second one as a 3 bits signed delta
+        int quantized5[2][3];
+        bool canUseDifferential = true;
+        for (size_t c = 0; c < 3; ++c)
+        {
+            quantized5[0][c] = clampInt(int(average[0][c] * 31.f / 255.f + 0.5f), 0, 31);
+            quantized5[1][c] = clampInt(int(average[1][c] * 31.f / 255.f + 0.5f), 0, 31);
+            const auto delta = quantized5[1][c] - quantized5[0][c];
+            canUseDifferential = canUseDifferential && delta >= -4 && delta <= 3;
+        }
+
+        for (uint32_t differential = 0; differential < 2; ++differential)
+        {
+            if (differential && !canUseDifferential) {
+                continue;
+            }
+
+            int quantized[2][3], baseColors[2][3];
+            for (size_t s = 0; s < 2; ++s)
+            {
+                for (size_t c = 0; c < 3; ++c)
+                {
+                    if (differential)
+                    {
+                        quantized[s][c] = quantized5[s][c];
+                        baseColors[s][c] = (quantized[s][c] << 3) | (quantized[s][c] >> 2);
+                    }
+                    else
+                    {
+                        quantized[s][c] = clampInt(int(average[s][c] * 15.f / 255.f + 0.5f), 0, 15);
+                        baseColors[s][c] = (quantized[s][c] << 4) | quantized[s][c];
+                    }
+                }
+            }
+
+            const auto fit0 = fitETC1SubBlock(block, texelIds[0], baseColors[0]);
+            const auto fit1 = fitETC1SubBlock(block, texelIds[1], baseColors[1]);
+            if (fit0.error + fit1.error >= bestError) {
+                continue;
+            }
+            bestError = fit0.error + fit1.error;
+
+            uint64_t bits = 0;
+            if (differential)
+            {
+                bits |= uint64_t(quantized[0][0]) << 59 | uint64_t((quantized[1][0] - quantized[0][0]) & 7) << 56;
+                bits |= uint64_t(quantized[0][1]) << 51 | uint64_t((quantized[1][1] - quantized[0][1]) & 7) << 48;
+                bits |= uint64_t(quantized[0][2]) << 43 | uint64_t((quantized[1][2] - quantized[0][2]) & 7) << 40;
+            }
+            else
+            {
+                bits |= uint64_t(quantized[0][0]) << 60 | uint64_t(quantized[1][0]) << 56;
+                bits |= uint64_t(quantized[0][1]) << 52 | uint64_t(quantized[1][1]) << 48;
+                bits |= uint64_t(quantized[0][2]) << 44 | uint64_t(quantized[1][2]) << 40;
+            }
+            bits |= uint64_t(fit0.table) << 37 | uint64_t(fit1.table) << 34 | uint64_t(differential) << 33 | uint64_t(flip) << 32;
+
+            // Texel indices are stored column major, most significant bits in the upper half
+            const ETC1SubBlockFit * fits[2] = { &fit0, &fit1 };
+            for (size_t s = 0; s < 2; ++s)
+            {
+                for (size_t i = 0; i < 8; ++i)
+                {
+                    const auto id = texelIds[s][i];
+                    const auto bit = (id % 4) * 4 + id / 4;
+                    const auto index = fits[s]->indices[i];
+                    bits |= uint64_t(index >> 1) << (16 + bit) | uint64_t(index & 1) << bit;
+                }
+            }
+            bestBits = bits;
+        }
+    }
+
+    for (size_t i = 0; i < 8; ++i) {
+        out[i] = (bestBits >> (56 - 8 * i)) & 0xFF;
+    }
+}
+
+// EAC single channel block (8 bytes, big endian): base value, multiplier, modifier table and 3 bits per texel indices.
+// Used for the alpha of ETC2_RGBA_EAC and for R11/RG11: with a non zero multiplier the 11 bits decoding is 8 times the 8 bits one.
+
+const int EACModifiers[16][8] = {
+    { -3, -6, -9, -15, 2, 5, 8, 14 },
+    { -3, -7, -10, -13, 2, 6, 9, 12 },
+    { -2, -5, -8, -13, 1, 4, 7, 12 },
+    { -2, -4, -6, -13, 1, 3, 5, 12 },
+    { -3, -6, -8, -12, 2, 5, 7, 11 },
+    { -3, -7, -9, -11, 2, 6, 8, 10 },
+    { -4, -7, -8, -11, 3, 6, 7, 10 },
+    { -3, -5, -8, -11, 2, 4, 7, 10 },
+    { -2, -6, -8, -10, 1, 5, 7, 9 },
+    { -2, -5, -8, -10, 1, 4, 7, 9 },
+    { -2, -4, -8, -10, 1, 3, 7, 9 },
+    { -2, -5, -7, -10, 1, 4, 6, 9 },
+    { -3, -4, -7, -10, 2, 3, 6, 9 },
+    { -1, -2, -3, -10, 0, 1, 2, 9 },
+    { -4, -6, -8, -9, 3, 5, 7, 8 },
+    { -3, -5, -7, -9, 2, 4, 6, 8 }
+};
+
+void encodeEAC(const Block & block, size_t channel, unsigned char * out)
+{
+    int min = 255, max = 0;
+    for (const auto & texel : block.texels)
+    {
+        min = std::min(min, int(texel[channel]));
+        max = std::max(max, int(texel[channel]));
+    }
+
+    int bestError = std::numeric_limits<int>::max();
+    int bestBase = min, bestMultiplier = 1;
+    uint32_t bestTable = 13; // Contains a zero modifier, exact for constant blocks
+    uint32_t bestIndices[16] = { 0 };
+    if (min == max) {
+        std::fill(std::begin(bestIndices), std::end(bestIndices), 4u);
+    }
+
+    for (uint32_t table = 0; table < 16 && min != max && bestError > 0; ++table)
+    {
+        const auto modifierMin = EACModifiers[table][3], modifierMax = EACModifiers[table][7];
+        const float idealMultiplier = float(max - min) / (modifierMax - modifierMin);
+        for (int multiplier = int(idealMultiplier); multiplier <= int(idealMultiplier) + 1; ++multiplier)
+        {
+            const auto m = clampInt(multiplier, 1, 15);
+            const auto base = clampInt(int(std::floor((min + max - (modifierMin + modifierMax) * m) / 2.f + 0.5f)), 0, 255);
+
+            int error = 0;
+            uint32_t indices[16];
+            for (size_t i = 0; i < 16 && error < bestError; ++i)
+            {
+                int bestTexelError = std::numeric_limits<int>::max();
+                for (uint32_t index = 0; index < 8; ++index)
+                {
+                    const int texelError = square(clampInt(base + EACModifiers[table][index] * m, 0, 255) - block.texels[i][channel]);
+                    if (texelError < bestTexelError) {
+                        bestTexelError = texelError;
+                        indices[i] = index;
+                    }
+                }
+                error += bestTexelError;
+            }
+
+            if (error < bestError)
+            {
+                bestError = error;
+                bestBase = base;
+                bestMultiplier = m;
+                bestTable = table;
+                std::copy(std::begin(indices), std::end(indices), std::begin(bestIndices));
+            }
+        }
+    }
+
+    uint64_t bits = uint64_t(bestBase) << 56 | uint64_t(bestMultiplier) << 52 | uint64_t(bestTable) << 48;
+    for (size_t i = 0; i < 16; ++i)
+    {
+        const auto bit = (i % 4) * 4 + i / 4; // Column major, first texel in the most significant bits
+        bits |= uint64_t(bestIndices[i]) << (45 - 3 * bit);
+    }
+    for (size_t i = 0; i < 8; ++i) {
+        out[i] = (bits >> (56 - 8 * i)) & 0xFF;
+    }
+}
+
+void encodeBlock(CompressedFormat format, const Block & block, unsigned char * out)
+{
+    switch (format)
+    {
+    case CompressedFormat::BC1_RGB:
+    case CompressedFormat::BC1_SRGB:
+        encodeBC1(block, out);
+        return;
+    case CompressedFormat::BC3_RGBA:
+    case CompressedFormat::BC3_SRGB_ALPHA:
+        encodeBC4(block, 3, out);
+        encodeBC1(block, out + 8);
+        return;
+    case CompressedFormat::BC4_R:
+        encodeBC4(block, 0, out);
+        return;
+    case CompressedFormat::BC5_RG:
+        encodeBC4(block, 0, out);
+        encodeBC4(block, 1, out + 8);
+        return;
+    case CompressedFormat::ETC2_RGB:
+    case CompressedFormat::ETC2_SRGB:
+        encodeETC2RGB(block, out);
+        return;
+    case CompressedFormat::ETC2_RGBA_EAC:
+    case CompressedFormat::ETC2_SRGB_ALPHA_EAC:
+        encodeEAC(block, 3, out);
+        encodeETC2RGB(block, out + 8);
+        return;
+    case CompressedFormat::EAC_R11:
+        encodeEAC(block, 0, out);
+        return;
+    case CompressedFormat::EAC_RG11:
+        encodeEAC(block, 0, out);
+        encodeEAC(block, 1, out + 8);
+        return;
+    default:
+        break;
+    }
+    std::cerr << "No encoder for compressed format " << uint32_t(format) << std::endl;
+    throw std::runtime_error("No encoder for compressed format");
+}
+
+// FNV-1a on 64 bits words
+struct Hasher
+{
+    uint64_t value = 14695981039346656037ull;
+
+    void add(uint64_t word)
+    {
+        value = (value ^ word) * 1099511628211ull;
+    }
+
+    void add(const unsigned char * data, size_t size)
+    {
+        size_t i = 0;
+        for (; i + 8 <= size; i += 8)
+        {
+            uint64_t word;
+            std::memcpy(&word, data + i, 8);
+            add(word);
+        }
+        for (; i < size; ++i) {
+            add(uint64_t(data[i]));
+        }
+    }
+};
+
+struct CacheFileHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t format;
+    uint32_t width;
+    uint32_t height;
+    uint32_t levelCount;
+};
+
+}
+
+GLenum getGLInternalFormat(CompressedFormat format)
+{
+    switch (format)
+    {
+    case CompressedFormat::BC1_RGB:
+        return GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+    case CompressedFormat::BC1_SRGB:
+        return GL_COMPRESSED_SRGB_S3TC_DXT1_EXT;
+    case CompressedFormat::BC3_RGBA:
+        return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+    case CompressedFormat::BC3_SRGB_ALPHA:
+        return GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT;
+    case CompressedFormat::BC4_R:
+        return GL_COMPRESSED_RED_RGTC1;
+    case CompressedFormat::BC5_RG:
+        return GL_COMPRESSED_RG_RGTC2;
+    case CompressedFormat::ETC2_RGB:
+        return GL_COMPRESSED_RGB8_ETC2;
+    case CompressedFormat::ETC2_SRGB:
+        return GL_COMPRESSED_SRGB8_ETC2;
+    case CompressedFormat::ETC2_RGBA_EAC:
+        return GL_COMPRESSED_RGBA8_ETC2_EAC;
+    case CompressedFormat::ETC2_SRGB_ALPHA_EAC:
+        return GL_COMPRESSED_SRGB8_ALPHA8_ETC2_EAC;
+    case CompressedFormat::EAC_R11:
+        return GL_COMPRESSED_R11_EAC;
+    case CompressedFormat::EAC_RG11:
+        return GL_COMPRESSED_RG11_EAC;
+    case CompressedFormat::BC7_RGBA:
+        return GL_COMPRESSED_RGBA_BPTC_UNORM;
+    case CompressedFormat::BC7_SRGB_ALPHA:
+        return GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM;
+    }
+    std::cerr << "Unknown compressed format " << uint32_t(format) << std::endl;
+    throw std::runtime_error("Unknown compressed format");
+}
+
+size_t getBlockByteSize(CompressedFormat format)
+{
+    switch (format)
+    {
+    case CompressedFormat::BC1_RGB:
+    case CompressedFormat::BC1_SRGB:
+    case CompressedFormat::BC4_R:
+    case CompressedFormat::ETC2_RGB:
+    case CompressedFormat::ETC2_SRGB:
+    case CompressedFormat::EAC_R11:
+        return 8;
+    case CompressedFormat::BC3_RGBA:
+    case CompressedFormat::BC3_SRGB_ALPHA:
+    case CompressedFormat::BC5_RG:
+    case CompressedFormat::ETC2_RGBA_EAC:
+    case CompressedFormat::ETC2_SRGB_ALPHA_EAC:
+    case CompressedFormat::EAC_RG11:
+    case CompressedFormat::BC7_RGBA:
+    case CompressedFormat::BC7_SRGB_ALPHA:
+        return 16;
+    }
+    std::cerr << "Unknown compressed format " << uint32_t(format) << std::endl;
+    throw std::runtime_error("Unknown compressed format");
+}
+
+CompressedFormat chooseCompressedFormat(const Image2DRGBA & image, ColorSpace colorSpace, size_t channelCount, bool useS3TC)
+{
+    const auto sRGB = colorSpace == ColorSpace::sRGB;
+    if (sRGB && channelCount < 3) {
+        // BC4/BC5 and EAC have no sRGB variant and would sample gray as red: the image holds gray in RGB, and alpha for 2 channels
+        channelCount += 2;
+    }
+    if (channelCount == 1) {
+        return useS3TC ? CompressedFormat::BC4_R : CompressedFormat::EAC_R11;
+    }
+    if (channelCount == 2) {
+        return useS3TC ? CompressedFormat::BC5_RG : CompressedFormat::EAC_RG11;
+    }
+
+    bool opaque = true;
+    for (size_t i = 0; i < image.size() && opaque && channelCount == 4; ++i) {
+        opaque = image.data()[i * 4 + 3] == 255;
+    }
+
+    if (opaque) {
+        return useS3TC ? (sRGB ? CompressedFormat::BC1_SRGB : CompressedFormat::BC1_RGB) : (sRGB ? CompressedFormat::ETC2_SRGB : CompressedFormat::ETC2_RGB);
+    }
+    return useS3TC ? (sRGB ? CompressedFormat::BC3_SRGB_ALPHA : CompressedFormat::BC3_RGBA) : (sRGB ? CompressedFormat::ETC2_SRGB_ALPHA_EAC : CompressedFormat::ETC2_RGBA_EAC);
+}
+
+CompressedImage2D::CompressedImage2D(CompressedFormat format, size_t width, size_t height, size_t levelCount):
+    m_Format(format), m_nWidth(width), m_nHeight(height)
+{
+    for (size_t level = 0; level < levelCount; ++level)
+    {
+        m_LevelOffsets.emplace_back(m_nByteSize);
+        m_nByteSize += byteSize(level);
+    }
+    m_pData.reset(new unsigned char[m_nByteSize], std::default_delete<unsigned char[]>());
+}
+
+CompressedImage2D::CompressedImage2D(CompressedFormat format, size_t width, size_t height, std::shared_ptr<unsigned char> data, std::vector<size_t> levelOffsets):
+    m_Format(format), m_pData(std::move(data)), m_LevelOffsets(std::move(levelOffsets)), m_nWidth(width), m_nHeight(height)
+{
+    for (size_t level = 0; level < levelCount(); ++level) {
+        m_nByteSize += byteSize(level);
+    }
+}
+
+CompressedImage2D compressImage(const Image2DRGBAMipChain & mipChain, CompressedFormat format)
+{
+    CompressedImage2D image(format, mipChain.width(), mipChain.height(), mipChain.levelCount());
+    const auto blockByteSize = getBlockByteSize(format);
+
+    for (size_t level = 0; level < image.levelCount(); ++level)
+    {
+        const auto * src = mipChain.data(level);
+        const auto width = mipChain.width(level), height = mipChain.height(level);
+        const auto blockCountX = image.blockCountX(level);
+        auto * dst = image.data(level);
+
+        parallelFor(image.blockCountY(level), MinBlockRowsPerTask, [&](size_t rowBegin, size_t rowEnd)
+        {
+            Block block;
+            for (auto blockY = rowBegin; blockY < rowEnd; ++blockY)
+            {
+                for (size_t blockX = 0; blockX < blockCountX; ++blockX)
+                {
+                    fetchBlock(src, width, height, blockX, blockY, block);
+                    encodeBlock(format, block, dst + (blockY * blockCountX + blockX) * blockByteSize);
+                }
+            }
+        });
+    }
+
+    return image;
+}
+
+CompressedImage2D readCompressedImage(const fs::path & path)
+{
+    std::ifstream in(path.string(), std::ios::binary);
+    if (!in)
+    {
+        std::cerr << "Unable to open compressed image " << path << std::endl;
+        throw std::runtime_error("Unable to open compressed image");
+    }
+
+    CacheFileHeader header;
+    if (!in.read(reinterpret_cast<char*>(&header), sizeof(header)) || header.magic != CacheFileMagic || header.version != EncoderVersion)
+    {
+        std::cerr << "Invalid or outdated compressed image " << path << std::endl;
+        throw std::runtime_error("Invalid or outdated compressed image");
+    }
+
+    // The header sizes the allocation, do not trust it
+    size_t maxLevelCount = 0;
+    for (auto size = std::max(header.width, header.height); size; size >>= 1) {
+        ++maxLevelCount;
+    }
+    if (header.format < uint32_t(CompressedFormat::BC1_RGB) || header.format > uint32_t(CompressedFormat::BC7_SRGB_ALPHA)
+        || !header.width || !header.height || !header.levelCount || header.levelCount > maxLevelCount)
+    {
+        std::cerr << "Invalid header in compressed image " << path << std::endl;
+        throw std::runtime_error("Invalid header in compressed image");
+    }
+
+    CompressedImage2D image(CompressedFormat(header.format), header.width, header.height, header.levelCount);
+    if (!in.read(reinterpret_cast<char*>(image.data()), image.byteSize()))
+    {
+        std::cerr << "Truncated compressed image " << path << std::endl;
+        throw std::runtime_error("Truncated compressed image");
+    }
+    return image;
+}
+
+void writeCompressedImage(const CompressedImage2D & image, const fs::path & path)
+{
+    // Write to a temporary file first, so that an interrupted write never leaves a truncated cache entry.
+    // Its name is unique to this writer: several threads or processes may store the same entry at once.
+    static const auto processTag = std::random_device()();
+    static std::atomic<uint32_t> writeCount(0);
+    std::stringstream tmpSuffix;
+    tmpSuffix << "." << std::hex << processTag << "." << std::this_thread::get_id() << "." << writeCount++ << ".tmp";
+    auto tmpPath = path;
+    tmpPath += tmpSuffix.str();
+    {
+        std::ofstream out(tmpPath.string(), std::ios::binary);
+        const CacheFileHeader header = { CacheFileMagic, EncoderVersion, uint32_t(image.format()),
+            uint32_t(image.width()), uint32_t(image.height()), uint32_t(image.levelCount()) };
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out.write(reinterpret_cast<const char*>(image.data()), image.byteSize());
+        if (!out)
+        {
+            out.close();
+            std::error_code error;
+            fs::remove(tmpPath, error);
+            std::cerr << "Unable to write compressed image " << tmpPath << std::endl;
+            throw std::runtime_error("Unable to write compressed image");
+        }
+    }
+    fs::rename(tmpPath, path);
+}
+
+CompressedImage2D loadOrCompressImage(const Image2DRGBA & image, ColorSpace colorSpace, CompressedFormat format, const fs::path & cacheDirectory)
+{
+    Hasher hasher;
+    hasher.add(EncoderVersion);
+    hasher.add(uint64_t(format));
+    hasher.add(uint64_t(colorSpace));
+    hasher.add(image.width());
+    hasher.add(image.height());
+    hasher.add(image.data(), image.size() * Image2DRGBA::NumComponents);
+
+    std::stringstream name;
+    name << std::hex << std::setw(16) << std::setfill('0') << hasher.value << ".gltc";
+    const auto cachePath = cacheDirectory / name.str();
+
+    if (fs::exists(cachePath))
+    {
+        try {
+            return readCompressedImage(cachePath);
+        }
+        catch (const std::runtime_error &) {
+            std::clog << "Recompressing invalid cache entry " << cachePath << std::endl;
+        }
+    }
+
+    auto compressed = compressImage(generateMipChain(image, colorSpace, MipFilter::Kaiser), format);
+
+    // A read-only scene directory should not prevent loading, the cache is only an optimization
+    try
+    {
+        fs::create_directories(cacheDirectory);
+        writeCompressedImage(compressed, cachePath);
+    }
+    catch (const std::exception & e) {
+        std::clog << "Warning: unable to store compressed texture in cache: " << e.what() << std::endl;
+    }
+
+    return compressed;
+}
+
+}
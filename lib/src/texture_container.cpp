@@ -0,0 +1,797 @@
+#include <glmlv/TextureContainer.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+namespace glmlv
+{
+
+namespace
+{
+
+struct FormatInfo
+{
+    bool isCompressed;
+    CompressedFormat compressedFormat;
+    GLenum internalFormat;
+    GLenum pixelFormat;
+    GLenum pixelType;
+    size_t texelByteSize; // Block size for compressed formats
+    bool isSRGB;
+    uint32_t vkFormat;
+    uint32_t dxgiFormat; // 0 if the format has no DXGI equivalent
+};
+
+FormatInfo compressed(CompressedFormat format, bool isSRGB, uint32_t vkFormat, uint32_t dxgiFormat)
+{
+    return { true, format, getGLInternalFormat(format), GL_NONE, GL_NONE, getBlockByteSize(format), isSRGB, vkFormat, dxgiFormat };
+}
+
+FormatInfo uncompressed(GLenum internalFormat, GLenum pixelFormat, GLenum pixelType, size_t texelByteSize, bool isSRGB, uint32_t vkFormat, uint32_t dxgiFormat)
+{
+    return { false, CompressedFormat::BC1_RGB, internalFormat, pixelFormat, pixelType, texelByteSize, isSRGB, vkFormat, dxgiFormat };
+}
+
+const std::vector<FormatInfo> & getFormats()
+{
+    static const std::vector<FormatInfo> formats = {
+        compressed(CompressedFormat::BC1_RGB, false, 131, 71),
+        compressed(CompressedFormat::BC1_SRGB, true, 132, 72),
+        compressed(CompressedFormat::BC3_RGBA, false, 137, 77),
+        compressed(CompressedFormat::BC3_SRGB_ALPHA, true, 138, 78),
+        compressed(CompressedFormat::BC4_R, false, 139, 80),
+        compressed(CompressedFormat::BC5_RG, false, 141, 83),
+        compressed(CompressedFormat::BC7_RGBA, false, 145, 98),
+        compressed(CompressedFormat::BC7_SRGB_ALPHA, true, 146, 99),
+        compressed(CompressedFormat::ETC2_RGB, false, 147, 0),
+        compressed(CompressedFormat::ETC2_SRGB, true, 148, 0),
+        compressed(CompressedFormat::ETC2_RGBA_EAC, false, 151, 0),
+        compressed(CompressedFormat::ETC2_SRGB_ALPHA_EAC, true, 152, 0),
+        compressed(CompressedFormat::EAC_R11, false, 153, 0),
+        compressed(CompressedFormat::EAC_RG11, false, 155, 0),
+        uncompressed(GL_R8, GL_RED, GL_UNSIGNED_BYTE, 1, false, 9, 61),
+        uncompressed(GL_RG8, GL_RG, GL_UNSIGNED_BYTE, 2, false, 16, 49),
+        uncompressed(GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE, 4, false, 37, 28),
+        uncompressed(GL_SRGB8_ALPHA8, GL_RGBA, GL_UNSIGNED_BYTE, 4, true, 43, 29),
+        uncompressed(GL_RGBA8, GL_BGRA, GL_UNSIGNED_BYTE, 4, false, 44, 87),
+        uncompressed(GL_SRGB8_ALPHA8, GL_BGRA, GL_UNSIGNED_BYTE, 4, true, 50, 91),
+        uncompressed(GL_R16F, GL_RED, GL_HALF_FLOAT, 2, false, 76, 54),
+        uncompressed(GL_RGBA16F, GL_RGBA, GL_HALF_FLOAT, 8, false, 97, 10),
+        uncompressed(GL_RGBA32F, GL_RGBA, GL_FLOAT, 16, false, 109, 2)
+    };
+    return formats;
+}
+
+template<typename Predicate>
+const FormatInfo * findFormat(Predicate && predicate)
+{
+    const auto & formats = getFormats();
+    const auto it = std::find_if(begin(formats), end(formats), predicate);
+    return it != end(formats) ? &(*it) : nullptr;
+}
+
+const FormatInfo & getFormat(CompressedFormat format)
+{
+    return *findFormat([&](const FormatInfo & info) { return info.isCompressed && info.compressedFormat == format; });
+}
+
+const FormatInfo & getRGBA8Format(ColorSpace colorSpace)
+{
+    const auto vkFormat = colorSpace == ColorSpace::sRGB ? 43u : 37u;
+    return *findFormat([&](const FormatInfo & info) { return info.vkFormat == vkFormat; });
+}
+
+size_t computeMaxLevelCount(size_t width, size_t height)
+{
+    size_t levelCount = 0;
+    for (auto size = std::max(width, height); size; size >>= 1) {
+        ++levelCount;
+    }
+    return levelCount;
+}
+
+// a * b if it does not exceed limit, limit + 1 otherwise: sizes read from a header are compared to the file size without overflowing
+size_t multiplyBounded(size_t a, size_t b, size_t limit)
+{
+    return a && b > limit / a ? limit + 1 : a * b;
+}
+
+// Bytes of a level read from a file, limit + 1 if they exceed limit
+size_t computeLevelByteSize(const FormatInfo & format, size_t width, size_t height, size_t limit)
+{
+    const auto blockCount = format.isCompressed ? multiplyBounded((width + 3) / 4, (height + 3) / 4, limit) : multiplyBounded(width, height, limit);
+    return multiplyBounded(blockCount, format.texelByteSize, limit);
+}
+
+uint32_t readU32(const unsigned char * data)
+{
+    uint32_t value;
+    std::memcpy(&value, data, sizeof(value));
+    return value;
+}
+
+uint64_t readU64(const unsigned char * data)
+{
+    uint64_t value;
+    std::memcpy(&value, data, sizeof(value));
+    return value;
+}
+
+constexpr uint32_t makeFourCC(char a, char b, char c, char d)
+{
+    return uint32_t(a) | (uint32_t(b) << 8) | (uint32_t(c) << 16) | (uint32_t(d) << 24);
+}
+
+void onInvalidContainer(const fs::path & path, const char * reason)
+{
+    std::cerr << "Unable to read texture container " << path << ": " << reason << std::endl;
+    throw std::runtime_error(std::string("Unable to read texture container: ") + reason);
+}
+
+void onUnsupportedFormat(const fs::path & path, const char * reason)
+{
+    std::cerr << "Unable to write texture container " << path << ": " << reason << std::endl;
+    throw std::runtime_error(std::string("Unable to write texture container: ") + reason);
+}
+
+const unsigned char KTX2Identifier[12] = { 0xAB, 0x4B, 0x54, 0x58, 0x20, 0x32, 0x30, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A };
+const size_t KTX2HeaderByteSize = 80; // Identifier, header and index
+const size_t KTX2LevelIndexEntryByteSize = 24;
+
+const size_t DDSHeaderByteSize = 128; // Magic and DDS_HEADER
+const size_t DDSDX10HeaderByteSize = 20;
+
+// DDS_HEADER flags and caps
+const uint32_t DDSD_CAPS = 0x1, DDSD_HEIGHT = 0x2, DDSD_WIDTH = 0x4, DDSD_PITCH = 0x8, DDSD_PIXELFORMAT = 0x1000, DDSD_MIPMAPCOUNT = 0x20000, DDSD_LINEARSIZE = 0x80000;
+const uint32_t DDSCAPS_COMPLEX = 0x8, DDSCAPS_TEXTURE = 0x1000, DDSCAPS_MIPMAP = 0x400000, DDSCAPS2_CUBEMAP = 0x200;
+const uint32_t DDPF_FOURCC = 0x4, DDPF_RGB = 0x40, DDPF_LUMINANCE = 0x20000;
+const uint32_t DDS_RESOURCE_MISC_TEXTURECUBE = 0x4;
+
+// Levels of a single layer image to write in a container
+struct ContainerContent
+{
+    const FormatInfo * format;
+    size_t width;
+    size_t height;
+    std::vector<TextureSpan> levels;
+};
+
+ContainerContent makeContent(const CompressedImage2D & image)
+{
+    ContainerContent content = { &getFormat(image.format()), image.width(), image.height(), {} };
+    for (size_t level = 0; level < image.levelCount(); ++level) {
+        content.levels.push_back({ image.data(level), image.byteSize(level), image.width(level), image.height(level) });
+    }
+    return content;
+}
+
+ContainerContent makeContent(const Image2DRGBAMipChain & mipChain, ColorSpace colorSpace)
+{
+    ContainerContent content = { &getRGBA8Format(colorSpace), mipChain.width(), mipChain.height(), {} };
+    for (size_t level = 0; level < mipChain.levelCount(); ++level) {
+        content.levels.push_back({ mipChain.data(level), mipChain.byteSize(level), mipChain.width(level), mipChain.height(level) });
+    }
+    return content;
+}
+
+// Khronos basic data format descriptor of a format, prefixed by its total size
+std::vector<uint32_t> buildDataFormatDescriptor(const FormatInfo & format)
+{
+    enum Model { RGBSDA = 1, BC1A = 128, BC3 = 130, BC4 = 131, BC5 = 132, BC7 = 134, ETC2 = 161 };
+    const uint32_t Red = 0, Green = 1, Blue = 2, ETC2Color = 2, Alpha = 15;
+    const uint32_t LinearQualifier = 0x10, SignedQualifier = 0x40, FloatQualifier = 0x80;
+
+    struct Sample { uint32_t channel, bitOffset, bitLength; };
+    uint32_t model = RGBSDA;
+    std::array<Sample, 4> samples;
+    size_t sampleCount = 0;
+    const auto setSamples = [&](std::initializer_list<Sample> list) {
+        sampleCount = 0;
+        for (const auto & sample : list) {
+            samples[sampleCount++] = sample;
+        }
+    };
+
+    if (format.isCompressed)
+    {
+        switch (format.compressedFormat)
+        {
+        case CompressedFormat::BC1_RGB:
+        case CompressedFormat::BC1_SRGB:
+            model = BC1A;
+            setSamples({ { 0, 0, 64 } });
+            break;
+        case CompressedFormat::BC3_RGBA:
+        case CompressedFormat::BC3_SRGB_ALPHA:
+            model = BC3;
+            setSamples({ { Alpha, 0, 64 }, { 0, 64, 64 } });
+            break;
+        case CompressedFormat::BC4_R:
+            model = BC4;
+            setSamples({ { 0, 0, 64 } });
+            break;
+        case CompressedFormat::BC5_RG:
+            model = BC5;
+            setSamples({ { Red, 0, 64 }, { Green, 64, 64 } });
+            break;
+        case CompressedFormat::BC7_RGBA:
+        case CompressedFormat::BC7_SRGB_ALPHA:
+            model = BC7;
+            setSamples({ { 0, 0, 128 } });
+            break;
+        case CompressedFormat::ETC2_RGB:
+        case CompressedFormat::ETC2_SRGB:
+            model = ETC2;
+            setSamples({ { ETC2Color, 0, 64 } });
+            break;
+        case CompressedFormat::ETC2_RGBA_EAC:
+        case CompressedFormat::ETC2_SRGB_ALPHA_EAC:
+            model = ETC2;
+            setSamples({ { Alpha, 0, 64 }, { ETC2Color, 64, 64 } });
+            break;
+        case CompressedFormat::EAC_R11:
+            model = ETC2;
+            setSamples({ { Red, 0, 64 } });
+            break;
+        case CompressedFormat::EAC_RG11:
+            model = ETC2;
+            setSamples({ { Red, 0, 64 }, { Green, 64, 64 } });
+            break;
+        }
+    }
+    else
+    {
+        const uint32_t bits = uint32_t(format.pixelType == GL_UNSIGNED_BYTE ? 8 : format.pixelType == GL_HALF_FLOAT ? 16 : 32);
+        std::vector<uint32_t> channels;
+        switch (format.pixelFormat)
+        {
+        case GL_RED:
+            channels = { Red };
+            break;
+        case GL_RG:
+            channels = { Red, Green };
+            break;
+        case GL_BGRA:
+            channels = { Blue, Green, Red, Alpha };
+            break;
+        default:
+            channels = { Red, Green, Blue, Alpha };
+            break;
+        }
+        for (size_t i = 0; i < channels.size(); ++i) {
+            samples[sampleCount++] = { channels[i], uint32_t(i) * bits, bits };
+        }
+    }
+
+    const auto blockSize = uint32_t(24 + 16 * sampleCount);
+    std::vector<uint32_t> words;
+    words.push_back(4 + blockSize); // dfdTotalSize
+    words.push_back(0); // vendorId and descriptorType: Khronos basic descriptor
+    words.push_back(2 | (blockSize << 16)); // versionNumber and descriptorBlockSize
+    words.push_back(model | (1 << 8) | ((format.isSRGB ? 2 : 1) << 16)); // BT709 primaries, linear or sRGB transfer, straight alpha
+    words.push_back(format.isCompressed ? 0x00000303u : 0u); // texelBlockDimension - 1
+    words.push_back(uint32_t(format.texelByteSize)); // bytesPlane0
+    words.push_back(0);
+
+    for (size_t i = 0; i < sampleCount; ++i)
+    {
+        const auto & sample = samples[i];
+        uint32_t channelType = sample.channel;
+        if (format.isSRGB && sample.channel == Alpha) {
+            channelType |= LinearQualifier;
+        }
+        const bool isFloat = !format.isCompressed && format.pixelType != GL_UNSIGNED_BYTE;
+        if (isFloat) {
+            channelType |= FloatQualifier | SignedQualifier;
+        }
+        words.push_back(sample.bitOffset | ((sample.bitLength - 1) << 16) | (channelType << 24));
+        words.push_back(0); // samplePosition
+        words.push_back(isFloat ? 0xBF800000u : 0u); // sampleLower: -1.0f for floats
+        words.push_back(isFloat ? 0x3F800000u : format.isCompressed ? 0xFFFFFFFFu : (1u << sample.bitLength) - 1); // sampleUpper
+    }
+    return words;
+}
+
+size_t alignUp(size_t value, size_t alignment)
+{
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+template<typename T>
+void write(std::ostream & out, T value)
+{
+    out.write(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+void writePadding(std::ostream & out, size_t position, size_t alignedPosition)
+{
+    for (; position < alignedPosition; ++position) {
+        out.put(0);
+    }
+}
+
+void writeKTX2(const ContainerContent & content, const fs::path & path, RowOrder rowOrder)
+{
+    const auto & format = *content.format;
+    const auto levelCount = content.levels.size();
+
+    const auto dfd = buildDataFormatDescriptor(format);
+    std::string keyValues;
+    for (const auto & keyValue : { std::make_pair(std::string("KTXorientation"), std::string(rowOrder == RowOrder::TopDown ? "rd" : "ru")),
+                                   std::make_pair(std::string("KTXwriter"), std::string("glmlv")) })
+    {
+        const auto entry = keyValue.first + '\0' + keyValue.second + '\0';
+        const auto length = uint32_t(entry.size());
+        keyValues.append(reinterpret_cast<const char *>(&length), sizeof(length));
+        keyValues += entry;
+        keyValues.resize(alignUp(keyValues.size(), 4), '\0');
+    }
+
+    const auto dfdOffset = KTX2HeaderByteSize + levelCount * KTX2LevelIndexEntryByteSize;
+    const auto kvdOffset = dfdOffset + dfd.size() * sizeof(uint32_t);
+
+    // Levels are stored from the smallest to the largest, aligned on lcm(texel block size, 4)
+    const auto alignment = format.texelByteSize % 4 == 0 ? format.texelByteSize : format.texelByteSize % 2 == 0 ? 4 : 4 * format.texelByteSize;
+    std::vector<size_t> levelOffsets(levelCount);
+    auto offset = kvdOffset + keyValues.size();
+    for (size_t level = levelCount; level-- > 0;)
+    {
+        offset = alignUp(offset, alignment);
+        levelOffsets[level] = offset;
+        offset += content.levels[level].byteSize;
+    }
+
+    std::ofstream out(path.string(), std::ios::binary);
+    out.write(reinterpret_cast<const char *>(KTX2Identifier), sizeof(KTX2Identifier));
+    write<uint32_t>(out, format.vkFormat);
+    write<uint32_t>(out, format.isCompressed ? 1 : uint32_t(format.pixelType == GL_UNSIGNED_BYTE ? 1 : format.pixelType == GL_HALF_FLOAT ? 2 : 4)); // typeSize
+    write<uint32_t>(out, uint32_t(content.width));
+    write<uint32_t>(out, uint32_t(content.height));
+    write<uint32_t>(out, 0); // pixelDepth
+    write<uint32_t>(out, 0); // layerCount
+    write<uint32_t>(out, 1); // faceCount
+    write<uint32_t>(out, uint32_t(levelCount));
+    write<uint32_t>(out, 0); // supercompressionScheme
+    write<uint32_t>(out, uint32_t(dfdOffset));
+    write<uint32_t>(out, uint32_t(dfd.size() * sizeof(uint32_t)));
+    write<uint32_t>(out, uint32_t(kvdOffset));
+    write<uint32_t>(out, uint32_t(keyValues.size()));
+    write<uint64_t>(out, 0); // sgdByteOffset
+    write<uint64_t>(out, 0); // sgdByteLength
+
+    for (size_t level = 0; level < levelCount; ++level)
+    {
+        write<uint64_t>(out, levelOffsets[level]);
+        write<uint64_t>(out, content.levels[level].byteSize);
+        write<uint64_t>(out, content.levels[level].byteSize); // uncompressedByteLength
+    }
+    for (const auto word : dfd) {
+        write(out, word);
+    }
+    out.write(keyValues.data(), keyValues.size());
+
+    auto position = kvdOffset + keyValues.size();
+    for (size_t level = levelCount; level-- > 0;)
+    {
+        writePadding(out, position, levelOffsets[level]);
+        out.write(reinterpret_cast<const char *>(content.levels[level].data), content.levels[level].byteSize);
+        position = levelOffsets[level] + content.levels[level].byteSize;
+    }
+
+    if (!out) {
+        onUnsupportedFormat(path, "write error");
+    }
+}
+
+void writeDDS(const ContainerContent & content, const fs::path & path)
+{
+    const auto & format = *content.format;
+    if (!format.dxgiFormat) {
+        onUnsupportedFormat(path, "format not representable in DDS");
+    }
+    const auto levelCount = content.levels.size();
+
+    std::ofstream out(path.string(), std::ios::binary);
+    write<uint32_t>(out, makeFourCC('D', 'D', 'S', ' '));
+    write<uint32_t>(out, 124); // dwSize
+    write<uint32_t>(out, DDSD_CAPS | DDSD_HEIGHT | DDSD_WIDTH | DDSD_PIXELFORMAT | DDSD_MIPMAPCOUNT | (format.isCompressed ? DDSD_LINEARSIZE : DDSD_PITCH));
+    write<uint32_t>(out, uint32_t(content.height));
+    write<uint32_t>(out, uint32_t(content.width));
+    write<uint32_t>(out, uint32_t(format.isCompressed ? content.levels[0].byteSize : content.width * format.texelByteSize)); // dwPitchOrLinearSize
+    write<uint32_t>(out, 0); // dwDepth
+    write<uint32_t>(out, uint32_t(levelCount));
+    for (size_t i = 0; i < 11; ++i) {
+        write<uint32_t>(out, 0); // dwReserved1
+    }
+    write<uint32_t>(out, 32); // ddspf.dwSize
+    write<uint32_t>(out, DDPF_FOURCC);
+    write<uint32_t>(out, makeFourCC('D', 'X', '1', '0'));
+    for (size_t i = 0; i < 5; ++i) {
+        write<uint32_t>(out, 0); // Bit count and masks
+    }
+    write<uint32_t>(out, DDSCAPS_TEXTURE | (levelCount > 1 ? DDSCAPS_COMPLEX | DDSCAPS_MIPMAP : 0));
+    for (size_t i = 0; i < 4; ++i) {
+        write<uint32_t>(out, 0); // dwCaps2, dwCaps3, dwCaps4, dwReserved2
+    }
+
+    write<uint32_t>(out, format.dxgiFormat);
+    write<uint32_t>(out, 3); // D3D10_RESOURCE_DIMENSION_TEXTURE2D
+    write<uint32_t>(out, 0); // miscFlag
+    write<uint32_t>(out, 1); // arraySize
+    write<uint32_t>(out, 0); // miscFlags2
+
+    for (const auto & level : content.levels) {
+        out.write(reinterpret_cast<const char *>(level.data), level.byteSize);
+    }
+
+    if (!out) {
+        onUnsupportedFormat(path, "write error");
+    }
+}
+
+}
+
+CompressedImage2D TextureContainer::compressedImage(size_t layer) const
+{
+    if (!m_bIsCompressed)
+    {
+        std::cerr << "compressedImage called on an uncompressed texture container" << std::endl;
+        throw std::runtime_error("Texture container is not compressed");
+    }
+
+    std::vector<size_t> levelOffsets;
+    for (size_t level = 0; level < m_nLevelCount; ++level) {
+        levelOffsets.emplace_back(m_LevelOffsets[level * m_nLayerCount + layer]);
+    }
+    // Share ownership of the mapping, the image never writes through this pointer
+    std::shared_ptr<unsigned char> data(m_pFile, const_cast<unsigned char *>(m_pFile->data()));
+    return CompressedImage2D(m_CompressedFormat, m_nWidth, m_nHeight, std::move(data), std::move(levelOffsets));
+}
+
+TextureContainer readKTX2(const fs::path & path)
+{
+    TextureContainer container;
+    container.m_pFile = std::make_shared<MappedFile>(path);
+    const auto * data = container.m_pFile->data();
+    const auto size = container.m_pFile->size();
+
+    if (size < KTX2HeaderByteSize || std::memcmp(data, KTX2Identifier, sizeof(KTX2Identifier)) != 0) {
+        onInvalidContainer(path, "not a KTX2 file");
+    }
+
+    const auto vkFormat = readU32(data + 12);
+    const auto pixelWidth = readU32(data + 20);
+    const auto pixelHeight = readU32(data + 24);
+    const auto pixelDepth = readU32(data + 28);
+    const auto layerCount = readU32(data + 32);
+    const auto faceCount = readU32(data + 36);
+    const auto levelCount = readU32(data + 40);
+    const auto supercompressionScheme = readU32(data + 44);
+    const auto kvdByteOffset = readU32(data + 56);
+    const auto kvdByteLength = readU32(data + 60);
+
+    if (supercompressionScheme != 0) {
+        onInvalidContainer(path, "supercompressed KTX2 files are not supported");
+    }
+    if (pixelDepth > 1) {
+        onInvalidContainer(path, "3D textures are not supported");
+    }
+    if (!pixelWidth || !pixelHeight || (faceCount != 1 && faceCount != 6)) {
+        onInvalidContainer(path, "invalid dimensions");
+    }
+    const auto * format = findFormat([&](const FormatInfo & info) { return info.vkFormat == vkFormat; });
+    if (!format) {
+        onInvalidContainer(path, "unsupported vkFormat");
+    }
+
+    container.m_bIsCompressed = format->isCompressed;
+    container.m_CompressedFormat = format->compressedFormat;
+    container.m_InternalFormat = format->internalFormat;
+    container.m_PixelFormat = format->pixelFormat;
+    container.m_PixelType = format->pixelType;
+    container.m_nWidth = pixelWidth;
+    container.m_nHeight = pixelHeight;
+    container.m_nLevelCount = std::max(1u, levelCount); // 0 asks the application to generate mips, only the base level is stored
+    container.m_nLayerCount = size_t(std::max(1u, layerCount)) * faceCount;
+
+    if (container.m_nLevelCount > computeMaxLevelCount(pixelWidth, pixelHeight)) {
+        onInvalidContainer(path, "invalid level count");
+    }
+    if (size < KTX2HeaderByteSize + container.m_nLevelCount * KTX2LevelIndexEntryByteSize) {
+        onInvalidContainer(path, "truncated level index");
+    }
+
+    for (size_t level = 0; level < container.m_nLevelCount; ++level)
+    {
+        const auto * entry = data + KTX2HeaderByteSize + level * KTX2LevelIndexEntryByteSize;
+        const auto byteOffset = readU64(entry);
+        const auto byteLength = readU64(entry + 8);
+        if (byteOffset > size || byteLength > size - byteOffset) {
+            onInvalidContainer(path, "truncated level data");
+        }
+        const auto levelByteSize = computeLevelByteSize(*format, container.width(level), container.height(level), byteLength);
+        if (multiplyBounded(levelByteSize, container.m_nLayerCount, byteLength) > byteLength) {
+            onInvalidContainer(path, "truncated level data");
+        }
+
+        container.m_LevelByteSizes.emplace_back(levelByteSize);
+        for (size_t layer = 0; layer < container.m_nLayerCount; ++layer) {
+            container.m_LevelOffsets.emplace_back(size_t(byteOffset) + layer * levelByteSize);
+        }
+    }
+
+    // Key/value pairs: only KTXorientation is used, "rd" (the default) is top down, "ru" bottom up
+    if (size_t(kvdByteOffset) + kvdByteLength <= size)
+    {
+        for (size_t offset = kvdByteOffset; offset + 4 <= size_t(kvdByteOffset) + kvdByteLength;)
+        {
+            const auto length = readU32(data + offset);
+            const std::string entry(reinterpret_cast<const char *>(data + offset + 4), std::min<size_t>(length, kvdByteOffset + kvdByteLength - offset - 4));
+            const std::string key = entry.c_str();
+            if (key == "KTXorientation" && entry.size() > key.size() + 2) {
+                container.m_RowOrder = entry[key.size() + 2] == 'u' ? RowOrder::BottomUp : RowOrder::TopDown;
+            }
+            offset += alignUp(4 + length, 4);
+        }
+    }
+
+    return container;
+}
+
+TextureContainer readDDS(const fs::path & path)
+{
+    TextureContainer container;
+    container.m_pFile = std::make_shared<MappedFile>(path);
+    const auto * data = container.m_pFile->data();
+    const auto size = container.m_pFile->size();
+
+    if (size < DDSHeaderByteSize || readU32(data) != makeFourCC('D', 'D', 'S', ' ') || readU32(data + 4) != 124) {
+        onInvalidContainer(path, "not a DDS file");
+    }
+
+    const auto flags = readU32(data + 8);
+    const auto height = readU32(data + 12);
+    const auto width = readU32(data + 16);
+    const auto mipMapCount = readU32(data + 28);
+    const auto pixelFormatFlags = readU32(data + 80);
+    const auto fourCC = readU32(data + 84);
+    const auto rgbBitCount = readU32(data + 88);
+    const auto redMask = readU32(data + 92);
+    const auto alphaMask = readU32(data + 104);
+    const auto caps2 = readU32(data + 112);
+
+    uint32_t dxgiFormat = 0;
+    size_t layerCount = (caps2 & DDSCAPS2_CUBEMAP) ? 6 : 1;
+    size_t dataOffset = DDSHeaderByteSize;
+
+    if ((pixelFormatFlags & DDPF_FOURCC) && fourCC == makeFourCC('D', 'X', '1', '0'))
+    {
+        if (size < DDSHeaderByteSize + DDSDX10HeaderByteSize) {
+            onInvalidContainer(path, "truncated DX10 header");
+        }
+        dxgiFormat = readU32(data + 128);
+        if (readU32(data + 132) != 3) {
+            onInvalidContainer(path, "only 2D textures are supported");
+        }
+        layerCount = std::max(1u, readU32(data + 140)) * ((readU32(data + 136) & DDS_RESOURCE_MISC_TEXTURECUBE) ? 6 : 1);
+        dataOffset += DDSDX10HeaderByteSize;
+    }
+    else if (pixelFormatFlags & DDPF_FOURCC)
+    {
+        switch (fourCC)
+        {
+        case makeFourCC('D', 'X', 'T', '1'):
+            dxgiFormat = 71;
+            break;
+        case makeFourCC('D', 'X', 'T', '5'):
+            dxgiFormat = 77;
+            break;
+        case makeFourCC('A', 'T', 'I', '1'):
+        case makeFourCC('B', 'C', '4', 'U'):
+            dxgiFormat = 80;
+            break;
+        case makeFourCC('A', 'T', 'I', '2'):
+        case makeFourCC('B', 'C', '5', 'U'):
+            dxgiFormat = 83;
+            break;
+        case 111: // D3DFMT_R16F
+            dxgiFormat = 54;
+            break;
+        case 113: // D3DFMT_A16B16G16R16F
+            dxgiFormat = 10;
+            break;
+        case 116: // D3DFMT_A32B32G32R32F
+            dxgiFormat = 2;
+            break;
+        }
+    }
+    else if ((pixelFormatFlags & DDPF_RGB) && rgbBitCount == 32 && alphaMask == 0xFF000000)
+    {
+        dxgiFormat = redMask == 0x000000FF ? 28 : redMask == 0x00FF0000 ? 87 : 0;
+    }
+    else if ((pixelFormatFlags & DDPF_LUMINANCE) && rgbBitCount == 8)
+    {
+        dxgiFormat = 61;
+    }
+
+    const auto * format = dxgiFormat ? findFormat([&](const FormatInfo & info) { return info.dxgiFormat == dxgiFormat; }) : nullptr;
+    if (!format) {
+        onInvalidContainer(path, "unsupported pixel format");
+    }
+    if (!width || !height) {
+        onInvalidContainer(path, "invalid dimensions");
+    }
+
+    container.m_bIsCompressed = format->isCompressed;
+    container.m_CompressedFormat = format->compressedFormat;
+    container.m_InternalFormat = format->internalFormat;
+    container.m_PixelFormat = format->pixelFormat;
+    container.m_PixelType = format->pixelType;
+    container.m_RowOrder = RowOrder::TopDown;
+    container.m_nWidth = width;
+    container.m_nHeight = height;
+    container.m_nLevelCount = (flags & DDSD_MIPMAPCOUNT) && mipMapCount ? mipMapCount : 1;
+    container.m_nLayerCount = layerCount;
+
+    if (container.m_nLevelCount > computeMaxLevelCount(width, height)) {
+        onInvalidContainer(path, "invalid level count");
+    }
+
+    // Layers are stored one after the other, each with its complete mip chain
+    const auto dataByteSize = size - dataOffset;
+    size_t layerByteSize = 0;
+    for (size_t level = 0; level < container.m_nLevelCount; ++level)
+    {
+        container.m_LevelByteSizes.emplace_back(computeLevelByteSize(*format, container.width(level), container.height(level), dataByteSize));
+        layerByteSize += container.m_LevelByteSizes.back();
+    }
+    if (multiplyBounded(layerByteSize, layerCount, dataByteSize) > dataByteSize) {
+        onInvalidContainer(path, "truncated level data");
+    }
+
+    container.m_LevelOffsets.resize(container.m_nLevelCount * layerCount);
+    for (size_t layer = 0; layer < layerCount; ++layer)
+    {
+        auto offset = dataOffset + layer * layerByteSize;
+        for (size_t level = 0; level < container.m_nLevelCount; ++level)
+        {
+            container.m_LevelOffsets[level * layerCount + layer] = offset;
+            offset += container.m_LevelByteSizes[level];
+        }
+    }
+
+    return container;
+}
+
+bool isTextureContainerPath(const fs::path & path)
+{
+    auto extension = path.extension().string();
+    std::transform(begin(extension), end(extension), begin(extension), [](char c) { return char(std::tolower(c)); });
+    return extension == ".ktx2" || extension == ".dds";
+}
+
+TextureContainer readTextureContainer(const fs::path & path)
+{
+    auto extension = path.extension().string();
+    std::transform(begin(extension), end(extension), begin(extension), [](char c) { return char(std::tolower(c)); });
+    if (extension == ".ktx2") {
+        return readKTX2(path);
+    }
+    if (extension == ".dds") {
+        return readDDS(path);
+    }
+    onInvalidContainer(path, "unknown extension");
+    return TextureContainer();
+}
+
+void writeKTX2(const CompressedImage2D & image, const fs::path & path, RowOrder rowOrder)
+{
+    writeKTX2(makeContent(image), path, rowOrder);
+}
+
+void writeKTX2(const Image2DRGBAMipChain & mipChain, ColorSpace colorSpace, const fs::path & path, RowOrder rowOrder)
+{
+    writeKTX2(makeContent(mipChain, colorSpace), path, rowOrder);
+}
+
+void writeDDS(const CompressedImage2D & image, const fs::path & path)
+{
+    writeDDS(makeContent(image), path);
+}
+
+void writeDDS(const Image2DRGBAMipChain & mipChain, ColorSpace colorSpace, const fs::path & path)
+{
+    writeDDS(makeContent(mipChain, colorSpace), path);
+}
+
+namespace
+{
+
+// Row r of a block of rowCount valid rows moves to row rowCount - 1 - r, padding rows are kept in place
+inline size_t flippedRow(size_t row, size_t rowCount)
+{
+    return row < rowCount ? rowCount - 1 - row : row;
+}
+
+void flipBC1Block(const unsigned char * src, unsigned char * dst, size_t rowCount)
+{
+    std::memcpy(dst, src, 4); // Endpoints
+    for (size_t row = 0; row < 4; ++row) {
+        dst[4 + flippedRow(row, rowCount)] = src[4 + row]; // One byte of 2 bits indices per row
+    }
+}
+
+void flipBC4Block(const unsigned char * src, unsigned char * dst, size_t rowCount)
+{
+    dst[0] = src[0];
+    dst[1] = src[1];
+    uint64_t indices = 0, flippedIndices = 0;
+    for (size_t i = 0; i < 6; ++i) {
+        indices |= uint64_t(src[2 + i]) << (8 * i);
+    }
+    for (size_t row = 0; row < 4; ++row) {
+        flippedIndices |= ((indices >> (12 * row)) & 0xFFF) << (12 * flippedRow(row, rowCount)); // 12 bits of 3 bits indices per row
+    }
+    for (size_t i = 0; i < 6; ++i) {
+        dst[2 + i] = (flippedIndices >> (8 * i)) & 0xFF;
+    }
+}
+
+}
+
+CompressedImage2D flipY(const CompressedImage2D & image)
+{
+    const auto format = image.format();
+    const bool isBC1 = format == CompressedFormat::BC1_RGB || format == CompressedFormat::BC1_SRGB;
+    const bool isBC3 = format == CompressedFormat::BC3_RGBA || format == CompressedFormat::BC3_SRGB_ALPHA;
+    const bool isBC4 = format == CompressedFormat::BC4_R;
+    const bool isBC5 = format == CompressedFormat::BC5_RG;
+    if (!isBC1 && !isBC3 && !isBC4 && !isBC5) {
+        return CompressedImage2D();
+    }
+    for (size_t level = 0; level < image.levelCount(); ++level)
+    {
+        if (image.height(level) > 4 && image.height(level) % 4 != 0) {
+            return CompressedImage2D(); // Rows would have to move across block boundaries
+        }
+    }
+
+    CompressedImage2D flipped(format, image.width(), image.height(), image.levelCount());
+    const auto blockByteSize = getBlockByteSize(format);
+    for (size_t level = 0; level < image.levelCount(); ++level)
+    {
+        const auto rowCount = std::min(image.height(level), size_t(4));
+        const auto blockCountX = image.blockCountX(level), blockCountY = image.blockCountY(level);
+        for (size_t blockY = 0; blockY < blockCountY; ++blockY)
+        {
+            for (size_t blockX = 0; blockX < blockCountX; ++blockX)
+            {
+                const auto * src = image.data(level) + (blockY * blockCountX + blockX) * blockByteSize;
+                auto * dst = flipped.data(level) + ((blockCountY - 1 - blockY) * blockCountX + blockX) * blockByteSize;
+                if (isBC1) {
+                    flipBC1Block(src, dst, rowCount);
+                }
+                else if (isBC3) {
+                    flipBC4Block(src, dst, rowCount);
+                    flipBC1Block(src + 8, dst + 8, rowCount);
+                }
+                else if (isBC4) {
+                    flipBC4Block(src, dst, rowCount);
+                }
+                else {
+                    flipBC4Block(src, dst, rowCount);
+                    flipBC4Block(src + 8, dst + 8, rowCount);
+                }
+            }
+        }
+    }
+    return flipped;
+}
+
+}
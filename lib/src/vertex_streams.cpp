@@ -0,0 +1,37 @@
+#include <glmlv/vertex_streams.hpp>
+
+namespace glmlv
+{
+
+void splitVertexStreams(SceneData & data)
+{
+    if (hasSeparateVertexStreams(data)) {
+        return;
+    }
+    data.positionBuffer.resize(data.vertexBuffer.size());
+    data.normalBuffer.resize(data.vertexBuffer.size());
+    data.texCoordsBuffer.resize(data.vertexBuffer.size());
+    for (size_t i = 0; i < data.vertexBuffer.size(); ++i)
+    {
+        data.positionBuffer[i] = data.vertexBuffer[i].position;
+        data.normalBuffer[i] = data.vertexBuffer[i].normal;
+        data.texCoordsBuffer[i] = data.vertexBuffer[i].texCoords;
+    }
+    std::vector<Vertex3f3f2f>().swap(data.vertexBuffer);
+}
+
+void interleaveVertexStreams(SceneData & data)
+{
+    if (!hasSeparateVertexStreams(data)) {
+        return;
+    }
+    data.vertexBuffer.reserve(data.positionBuffer.size());
+    for (size_t i = 0; i < data.positionBuffer.size(); ++i) {
+        data.vertexBuffer.emplace_back(data.positionBuffer[i], data.normalBuffer[i], data.texCoordsBuffer[i]);
+    }
+    std::vector<glm::vec3>().swap(data.positionBuffer);
+    std::vector<glm::vec3>().swap(data.normalBuffer);
+    std::vector<glm::vec2>().swap(data.texCoordsBuffer);
+}
+
+}